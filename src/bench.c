@@ -0,0 +1,455 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "mem.h"
+#include "mem_erase.h"
+#include "bench_util.h"
+
+/*===========================================================================*/
+/* 单线程基准测试，每个负载分别在 mem_malloc 和系统 malloc 上运行 */
+/*===========================================================================*/
+
+#define BENCH_BASE_OPS      (2 * 1024 * 1024)   /* 每个负载的基准操作次数 */
+#define BENCH_BATCH         1024                /* 批量分配的内存块数量 */
+#define BENCH_WORKING_SET   4096                /* 随机负载的存活内存块数量 */
+#define BENCH_SEED          0x9E3779B97F4A7C15ULL
+
+/*
+ * 缓存着色负载：分配 BENCH_COLOR_PAGES 页的内存块，反复访问每页的第一个
+ * 内存块；96、192、384 字节的分类每页均为 10 个内存块。着色只作用于
+ * NUMA 内存池中的内存页，除 mem 和 glibc 外另以 NUMA 模式运行一次
+ */
+#define BENCH_COLOR_PAGES       256
+#define BENCH_COLOR_PER_PAGE    10
+#define BENCH_COLOR_L1_SETS     64      /* 32K 8 路组相联 L1，64 字节缓存行 */
+
+/* 擦除负载每轮擦除的总字节数 */
+#define BENCH_CLEAR_BYTES       (64 * 1024 * 1024)
+
+/* 释放顺序 */
+#define ORDER_LIFO          0
+#define ORDER_FIFO          1
+#define ORDER_RANDOM        2
+
+/* 负载描述 */
+typedef struct {
+    const char *name;
+    BENCH_FUNC func;
+    size_t min_size;                    /* 最小尺寸 */
+    size_t max_size;                    /* 最大尺寸 */
+    int order;                          /* 释放顺序 */
+} BENCH_WORKLOAD;
+
+/* 操作次数倍率 */
+static double bench_scale = 1.0;
+
+/*===========================================================================*/
+
+/* 固定尺寸批量分配后按 LIFO 释放 */
+static void run_churn(const BENCH_ALLOC *alloc, void *arg, BENCH_RESULT *result);
+
+/* 固定数量的存活内存块，随机替换，尺寸在区间内按对数均匀分布 */
+static void run_random(const BENCH_ALLOC *alloc, void *arg, BENCH_RESULT *result);
+
+/* 内存块由最小尺寸逐步 realloc 增长到最大尺寸 */
+static void run_realloc(const BENCH_ALLOC *alloc, void *arg, BENCH_RESULT *result);
+
+/* 批量分配随机尺寸后按指定顺序释放 */
+static void run_order(const BENCH_ALLOC *alloc, void *arg, BENCH_RESULT *result);
+
+/*
+ * 多页负载，反复访问每页的第一个内存块；附加数据为 L1 数据缓存读缺失
+ * 次数，以及落在同一 L1 缓存组上的热点缓存行的最大数量
+ */
+static void run_color(const BENCH_ALLOC *alloc, void *arg, BENCH_RESULT *result);
+
+/* 打印缓存着色负载的缺失率 */
+static void print_color(const char *alloc, const BENCH_RESULT *result);
+
+/* 固定尺寸分配后 mem_clear 擦除再释放，附加数据为擦除的总字节数 */
+static void run_clear(const BENCH_ALLOC *alloc, void *arg, BENCH_RESULT *result);
+
+/* 打印擦除负载的吞吐量，计时包含分配和释放 */
+static void print_clear(const char *alloc, const BENCH_RESULT *result);
+
+/* 按倍率缩放后的操作次数 */
+static unsigned long long scaled_ops();
+
+/*===========================================================================*/
+
+static BENCH_WORKLOAD workloads[] = {
+    { "churn_8",        run_churn,   8,     8,     ORDER_LIFO },
+    { "churn_16",       run_churn,   16,    16,    ORDER_LIFO },
+    { "churn_32",       run_churn,   32,    32,    ORDER_LIFO },
+    { "churn_64",       run_churn,   64,    64,    ORDER_LIFO },
+    { "churn_96",       run_churn,   96,    96,    ORDER_LIFO },
+    { "churn_128",      run_churn,   128,   128,   ORDER_LIFO },
+    { "churn_160",      run_churn,   160,   160,   ORDER_LIFO },
+    { "churn_192",      run_churn,   192,   192,   ORDER_LIFO },
+    { "churn_256",      run_churn,   256,   256,   ORDER_LIFO },
+    { "churn_320",      run_churn,   320,   320,   ORDER_LIFO },
+    { "churn_384",      run_churn,   384,   384,   ORDER_LIFO },
+    { "churn_448",      run_churn,   448,   448,   ORDER_LIFO },
+    { "churn_512",      run_churn,   512,   512,   ORDER_LIFO },
+    { "random_small",   run_random,  1,     512,   ORDER_RANDOM },
+    { "random_mixed",   run_random,  1,     16384, ORDER_RANDOM },
+    { "realloc_chain",  run_realloc, 8,     16384, ORDER_LIFO },
+    { "large_churn",    run_random,  1024,  65536, ORDER_RANDOM },
+    { "free_lifo",      run_order,   8,     512,   ORDER_LIFO },
+    { "free_fifo",      run_order,   8,     512,   ORDER_FIFO },
+    { "free_random",    run_order,   8,     512,   ORDER_RANDOM },
+    { "color_96",       run_color,   96,    96,    ORDER_LIFO },
+    { "color_192",      run_color,   192,   192,   ORDER_LIFO },
+    { "color_384",      run_color,   384,   384,   ORDER_LIFO },
+    { "clear_4k",       run_clear,   4096,  4096,  ORDER_LIFO },
+    { "clear_64k",      run_clear,   65536, 65536, ORDER_LIFO },
+    { "clear_4m",       run_clear,   4194304, 4194304, ORDER_LIFO },
+};
+
+/*===========================================================================*/
+
+int main(int argc, char *argv[])
+{
+    size_t i;
+    int j;
+    const char *filter = NULL;
+
+    BENCH_RESULT result;
+    const BENCH_ALLOC *allocs[] = { &bench_mem_alloc, &bench_sys_alloc };
+
+    for (j = 1; j < argc; j++) {
+        if (!strcmp(argv[j], "-s") && j + 1 < argc) {
+            bench_scale = atof(argv[++j]);
+        } else if (!strcmp(argv[j], "-h")) {
+            printf("usage: %s [-s scale] [workload substring]\n", argv[0]);
+            return 0;
+        } else {
+            filter = argv[j];
+        }
+    }
+
+    if (bench_scale <= 0) {
+        bench_scale = 1.0;
+    }
+
+    bench_print_head();
+
+    for (i = 0; i < sizeof(workloads) / sizeof(workloads[0]); i++) {
+        if (filter && !strstr(workloads[i].name, filter)) {
+            continue;
+        }
+
+        for (j = 0; j < 2; j++) {
+            if (bench_run(workloads[i].func, allocs[j], workloads + i, &result)) {
+                printf("%-24s %-6s failed\n", workloads[i].name, allocs[j]->name);
+                continue;
+            }
+
+            bench_print(workloads[i].name, allocs[j]->name, &result);
+
+            if (workloads[i].func == run_color) {
+                print_color(allocs[j]->name, &result);
+            } else if (workloads[i].func == run_clear) {
+                print_clear(allocs[j]->name, &result);
+            }
+        }
+
+        /* 缓存着色只作用于内存池中的内存页，见 Makefile - MEM_NUMA_FORCE_POOL */
+        if (workloads[i].func == run_color) {
+            if (bench_run(run_color, &bench_numa_alloc, workloads + i, &result)) {
+                printf("%-24s %-6s n/a (numa mode unavailable)\n",
+                    workloads[i].name, bench_numa_alloc.name);
+                continue;
+            }
+
+            bench_print(workloads[i].name, bench_numa_alloc.name, &result);
+            print_color(bench_numa_alloc.name, &result);
+        }
+    }
+
+    return 0;
+}
+
+/*===========================================================================*/
+
+void run_churn(const BENCH_ALLOC *alloc, void *arg, BENCH_RESULT *result)
+{
+    int i;
+    unsigned long long round;
+    unsigned long long rounds = scaled_ops() / (2 * BENCH_BATCH);
+    unsigned long long start = 0;
+
+    BENCH_WORKLOAD *workload = (BENCH_WORKLOAD *)arg;
+    void *blocks[BENCH_BATCH];
+
+    start = bench_now();
+
+    for (round = 0; round < rounds; round++) {
+        for (i = 0; i < BENCH_BATCH; i++) {
+            blocks[i] = alloc->alloc(workload->min_size);
+            bench_touch(blocks[i], workload->min_size);
+        }
+
+        for (i = BENCH_BATCH - 1; i >= 0; i--) {
+            alloc->release(blocks[i]);
+        }
+    }
+
+    result->ns  = bench_now() - start;
+    result->ops = rounds * 2 * BENCH_BATCH;
+}
+
+void run_random(const BENCH_ALLOC *alloc, void *arg, BENCH_RESULT *result)
+{
+    size_t size = 0;
+    unsigned long long i;
+    unsigned long long slot = 0;
+    unsigned long long ops = 0;
+    unsigned long long count = scaled_ops() / 2;
+    unsigned long long start = 0;
+    unsigned long long state = BENCH_SEED;
+
+    BENCH_WORKLOAD *workload = (BENCH_WORKLOAD *)arg;
+    void **blocks = (void **)calloc(BENCH_WORKING_SET, sizeof(void *));
+
+    if (!blocks) {
+        return;
+    }
+
+    /* 大内存负载的存活数量较少，避免占用过多内存 */
+    if (workload->min_size >= 1024) {
+        count /= 8;
+    }
+
+    start = bench_now();
+
+    for (i = 0; i < count; i++) {
+        slot = bench_rand(&state) % BENCH_WORKING_SET;
+        size = bench_random_size(&state, workload->min_size, workload->max_size);
+
+        if (blocks[slot]) {
+            alloc->release(blocks[slot]);
+            ops++;
+        }
+
+        blocks[slot] = alloc->alloc(size);
+        bench_touch(blocks[slot], size);
+        ops++;
+    }
+
+    for (i = 0; i < BENCH_WORKING_SET; i++) {
+        if (blocks[i]) {
+            alloc->release(blocks[i]);
+            ops++;
+        }
+    }
+
+    result->ns  = bench_now() - start;
+    result->ops = ops;
+
+    free(blocks);
+}
+
+void run_realloc(const BENCH_ALLOC *alloc, void *arg, BENCH_RESULT *result)
+{
+    int i;
+    size_t size = 0;
+    unsigned long long ops = 0;
+    unsigned long long count = scaled_ops();
+    unsigned long long start = 0;
+
+    BENCH_WORKLOAD *workload = (BENCH_WORKLOAD *)arg;
+    void *chains[64];
+    void *ptr = NULL;
+
+    start = bench_now();
+
+    /* 64 条增长链交替增长，每次增长一半 */
+    while (ops < count) {
+        for (i = 0; i < 64; i++) {
+            chains[i] = alloc->alloc(workload->min_size);
+            bench_touch(chains[i], workload->min_size);
+            ops++;
+        }
+
+        for (size = workload->min_size; size < workload->max_size; ) {
+            size += size / 2;
+
+            for (i = 0; i < 64; i++) {
+                ptr = alloc->resize(chains[i], size);
+                if (ptr) {
+                    chains[i] = ptr;
+                    bench_touch(ptr, size);
+                }
+
+                ops++;
+            }
+        }
+
+        for (i = 0; i < 64; i++) {
+            alloc->release(chains[i]);
+            ops++;
+        }
+    }
+
+    result->ns  = bench_now() - start;
+    result->ops = ops;
+}
+
+void run_order(const BENCH_ALLOC *alloc, void *arg, BENCH_RESULT *result)
+{
+    int i;
+    int j;
+    int tmp = 0;
+    unsigned long long round;
+    unsigned long long rounds = scaled_ops() / (2 * BENCH_WORKING_SET);
+    unsigned long long start = 0;
+    unsigned long long ns = 0;
+    unsigned long long state = BENCH_SEED;
+
+    BENCH_WORKLOAD *workload = (BENCH_WORKLOAD *)arg;
+    void *blocks[BENCH_WORKING_SET];
+    size_t sizes[BENCH_WORKING_SET];
+    int order[BENCH_WORKING_SET];
+
+    for (round = 0; round < rounds; round++) {
+        /* 尺寸和释放顺序在计时之外生成 */
+        for (i = 0; i < BENCH_WORKING_SET; i++) {
+            sizes[i] = bench_random_size(&state, workload->min_size, workload->max_size);
+
+            switch (workload->order) {
+            case ORDER_LIFO:
+                order[i] = BENCH_WORKING_SET - 1 - i;
+                break;
+            case ORDER_FIFO:
+                order[i] = i;
+                break;
+            default:
+                order[i] = i;
+                j = (int)(bench_rand(&state) % (unsigned long long)(i + 1));
+                tmp = order[i];
+                order[i] = order[j];
+                order[j] = tmp;
+                break;
+            }
+        }
+
+        start = bench_now();
+
+        for (i = 0; i < BENCH_WORKING_SET; i++) {
+            blocks[i] = alloc->alloc(sizes[i]);
+            bench_touch(blocks[i], sizes[i]);
+        }
+
+        for (i = 0; i < BENCH_WORKING_SET; i++) {
+            alloc->release(blocks[order[i]]);
+        }
+
+        ns += bench_now() - start;
+    }
+
+    result->ns  = ns;
+    result->ops = rounds * 2 * BENCH_WORKING_SET;
+}
+
+void run_color(const BENCH_ALLOC *alloc, void *arg, BENCH_RESULT *result)
+{
+    int i;
+    int fd = -1;
+    unsigned long long round;
+    unsigned long long rounds = scaled_ops() / BENCH_COLOR_PAGES;
+    unsigned long long start = 0;
+
+    BENCH_WORKLOAD *workload = (BENCH_WORKLOAD *)arg;
+    void *blocks[BENCH_COLOR_PAGES * BENCH_COLOR_PER_PAGE];
+    volatile unsigned long long *hot[BENCH_COLOR_PAGES];
+    int sets[BENCH_COLOR_L1_SETS] = { 0 };
+
+    /* 分配在计时之外，按顺序分配时每页的第一个内存块间隔固定 */
+    for (i = 0; i < BENCH_COLOR_PAGES * BENCH_COLOR_PER_PAGE; i++) {
+        blocks[i] = alloc->alloc(workload->min_size);
+        bench_touch(blocks[i], workload->min_size);
+    }
+
+    for (i = 0; i < BENCH_COLOR_PAGES; i++) {
+        hot[i] = (volatile unsigned long long *)blocks[i * BENCH_COLOR_PER_PAGE];
+
+        /* 超过组相联路数的部分在每一轮访问中都会相互驱逐 */
+        if (++sets[((size_t)hot[i] / 64) % BENCH_COLOR_L1_SETS] > result->extra[1]) {
+            result->extra[1] = sets[((size_t)hot[i] / 64) % BENCH_COLOR_L1_SETS];
+        }
+    }
+
+    fd = bench_l1d_open();
+    start = bench_now();
+
+    for (round = 0; round < rounds; round++) {
+        for (i = 0; i < BENCH_COLOR_PAGES; i++) {
+            hot[i][0]++;
+        }
+    }
+
+    result->ns  = bench_now() - start;
+    result->ops = rounds * BENCH_COLOR_PAGES;
+    result->extra[0] = bench_l1d_close(fd);
+
+    for (i = 0; i < BENCH_COLOR_PAGES * BENCH_COLOR_PER_PAGE; i++) {
+        alloc->release(blocks[i]);
+    }
+}
+
+void print_color(const char *alloc, const BENCH_RESULT *result)
+{
+    printf("%-24s %-6s max hot lines per l1 set: %lld", "", alloc, result->extra[1]);
+
+    if (result->extra[0] < 0 || !result->ops) {
+        printf(", l1d read misses per access: n/a\n");
+        return;
+    }
+
+    printf(", l1d read misses per access: %.4f\n",
+        (double)result->extra[0] / (double)result->ops);
+}
+
+void run_clear(const BENCH_ALLOC *alloc, void *arg, BENCH_RESULT *result)
+{
+    unsigned long long round;
+    unsigned long long rounds = 0;
+    unsigned long long start = 0;
+
+    BENCH_WORKLOAD *workload = (BENCH_WORKLOAD *)arg;
+    void *block = NULL;
+
+    rounds = (unsigned long long)(BENCH_CLEAR_BYTES * bench_scale) / workload->min_size;
+    if (!rounds) {
+        rounds = 1;
+    }
+
+    start = bench_now();
+
+    for (round = 0; round < rounds; round++) {
+        block = alloc->alloc(workload->min_size);
+        bench_touch(block, workload->min_size);
+        mem_clear(block, workload->min_size);
+        alloc->release(block);
+    }
+
+    result->ns  = bench_now() - start;
+    result->ops = rounds * 2;
+    result->extra[0] = (long long)(rounds * workload->min_size);
+}
+
+void print_clear(const char *alloc, const BENCH_RESULT *result)
+{
+    printf("%-24s %-6s clear throughput: %.2f GB/s, erase: %s\n", "", alloc,
+        result->ns ? (double)result->extra[0] / (double)result->ns : 0.0,
+        mem_erase_name());
+}
+
+unsigned long long scaled_ops()
+{
+    return (unsigned long long)(BENCH_BASE_OPS * bench_scale);
+}
+
+/*===========================================================================*/
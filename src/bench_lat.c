@@ -0,0 +1,389 @@
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include "mem.h"
+#include "mem_page.h"
+#include "bench_util.h"
+
+/*===========================================================================*/
+/* 单次操作延迟测试，按内存分类和路径统计 mem_malloc/mem_free/mem_realloc 的延迟分布 */
+/*===========================================================================*/
+
+#define LAT_BASE_OPS        (1024 * 1024)       /* 基准操作次数 */
+#define LAT_WORKING_SET     4096                /* 存活内存块数量 */
+#define LAT_REALLOC_RATE    8                   /* 每 8 次操作中有一次 realloc */
+#define LAT_SEED            0x9E3779B97F4A7C15ULL
+
+/* 0 内存和大内存分类的索引 */
+#define LAT_ZERO_INDEX      0
+#define LAT_LARGE_INDEX     (MEM_STATS_CLASS_COUNT - 1)
+
+/* 直方图：每个 2 的幂区间再均分为 16 个子区间，相对误差不超过 1/16 */
+#define HIST_SUB_BITS       4
+#define HIST_SUB_COUNT      (1 << HIST_SUB_BITS)
+#define HIST_BUCKETS        (64 * HIST_SUB_COUNT)
+
+/* 操作类型 */
+#define OP_MALLOC           0
+#define OP_FREE             1
+#define OP_REALLOC          2
+#define OP_COUNT            3
+
+/* 路径 */
+#define PATH_FAST           0                   /* 当前内存页内完成 */
+#define PATH_PAGE           1                   /* 申请或释放了内存页 */
+#define PATH_LARGE          2                   /* 0 内存或大内存 */
+#define PATH_INPLACE        3                   /* realloc 原地返回 */
+#define PATH_COUNT          4
+
+/* 延迟直方图，单位为时钟周期 */
+typedef struct {
+    unsigned long long count;
+    unsigned long long sum;
+    unsigned long long max;
+    unsigned long long bucket[HIST_BUCKETS];
+} LAT_HIST;
+
+static const char *op_names[OP_COUNT] = { "malloc", "free", "realloc" };
+static const char *path_names[PATH_COUNT] = { "fast", "page", "large", "inplace" };
+
+/* 按操作、内存分类、路径划分的直方图 */
+static LAT_HIST lat_hist[OP_COUNT][MEM_STATS_CLASS_COUNT][PATH_COUNT];
+
+/* 每纳秒的时钟周期数 */
+static double lat_cycles_per_ns = 1.0;
+
+/* 计时本身的开销，从每次测量中扣除 */
+static unsigned long long lat_overhead = 0;
+
+/*===========================================================================*/
+
+/* 读取时钟周期计数器，不支持的平台退化为单调时钟 */
+static unsigned long long lat_start();
+static unsigned long long lat_stop();
+
+/* 校准周期与纳秒的比例和计时开销 */
+static void lat_calibrate();
+
+/* 记录一次测量 */
+static void lat_record(int op, int index, int path, unsigned long long cycles);
+
+/* 内存分类的内存页数量 */
+static unsigned long long lat_pages(int index);
+
+/* 输出各直方图的分位数 */
+static void lat_print();
+static unsigned long long hist_percentile(const LAT_HIST *hist, double percent);
+static int hist_bucket(unsigned long long value);
+static unsigned long long hist_value(int bucket);
+
+/*===========================================================================*/
+
+int main(int argc, char *argv[])
+{
+    int i;
+    int op = 0;
+    int path = 0;
+    int index = 0;
+    int index_new = 0;
+
+    size_t len = 0;
+    size_t max_size = 16384;
+    unsigned long long n;
+    unsigned long long ops = LAT_BASE_OPS;
+    unsigned long long slot = 0;
+    unsigned long long pages = 0;
+    unsigned long long pages_new = 0;
+    unsigned long long begin = 0;
+    unsigned long long cycles = 0;
+    unsigned long long state = LAT_SEED;
+
+    void *ptr = NULL;
+    void *blocks[LAT_WORKING_SET];
+    size_t sizes[LAT_WORKING_SET];
+
+    for (i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-s") && i + 1 < argc) {
+            ops = (unsigned long long)(LAT_BASE_OPS * atof(argv[++i]));
+        } else if (!strcmp(argv[i], "-m") && i + 1 < argc) {
+            max_size = (size_t)atol(argv[++i]);
+        } else {
+            printf("usage: %s [-s scale] [-m max size]\n", argv[0]);
+            return 0;
+        }
+    }
+
+    if (max_size < 1) {
+        max_size = 1;
+    }
+
+    lat_calibrate();
+    create_res();
+
+    memset(blocks, 0, sizeof(blocks));
+    memset(sizes, 0, sizeof(sizes));
+
+    /*
+     * 随机替换存活内存块，部分操作改为 realloc；路径由操作前后内存页
+     * 数量的变化判断，读取统计信息不计入延迟
+     */
+    for (n = 0; n < ops; n++) {
+        slot = bench_rand(&state) % LAT_WORKING_SET;
+        len = bench_random_size(&state, 1, max_size);
+
+        if (blocks[slot] && bench_rand(&state) % LAT_REALLOC_RATE == 0) {
+            index = get_page_index(sizes[slot]);
+            index_new = get_page_index(len);
+            pages = lat_pages(index) + lat_pages(index_new);
+
+            begin = lat_start();
+            ptr = mem_realloc(blocks[slot], len);
+            cycles = lat_stop() - begin;
+
+            if (!ptr) {
+                continue;
+            }
+
+            pages_new = lat_pages(index) + lat_pages(index_new);
+
+            if (ptr == blocks[slot]) {
+                path = PATH_INPLACE;
+            } else if (index == LAT_LARGE_INDEX || index_new == LAT_LARGE_INDEX) {
+                path = PATH_LARGE;
+            } else {
+                path = pages_new != pages ? PATH_PAGE : PATH_FAST;
+            }
+
+            lat_record(OP_REALLOC, index_new, path, cycles);
+
+            blocks[slot] = ptr;
+            sizes[slot] = len;
+            bench_touch(ptr, len);
+            continue;
+        }
+
+        if (blocks[slot]) {
+            index = get_page_index(sizes[slot]);
+            pages = lat_pages(index);
+
+            begin = lat_start();
+            mem_free(blocks[slot]);
+            cycles = lat_stop() - begin;
+
+            op = OP_FREE;
+        } else {
+            index = get_page_index(len);
+            pages = lat_pages(index);
+
+            begin = lat_start();
+            blocks[slot] = mem_malloc(len);
+            cycles = lat_stop() - begin;
+
+            sizes[slot] = len;
+            bench_touch(blocks[slot], len);
+
+            op = OP_MALLOC;
+        }
+
+        if (index == LAT_ZERO_INDEX || index == LAT_LARGE_INDEX) {
+            path = PATH_LARGE;
+        } else {
+            path = lat_pages(index) != pages ? PATH_PAGE : PATH_FAST;
+        }
+
+        lat_record(op, index, path, cycles);
+
+        if (op == OP_FREE) {
+            blocks[slot] = NULL;
+        }
+    }
+
+    for (i = 0; i < LAT_WORKING_SET; i++) {
+        mem_free(blocks[i]);
+    }
+
+    clear_res();
+    lat_print();
+
+    return 0;
+}
+
+/*===========================================================================*/
+
+unsigned long long lat_start()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    _mm_lfence();
+    return __rdtsc();
+#else
+    return bench_now();
+#endif
+}
+
+unsigned long long lat_stop()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    unsigned int aux = 0;
+    unsigned long long ret = __rdtscp(&aux);
+
+    _mm_lfence();
+    return ret;
+#else
+    return bench_now();
+#endif
+}
+
+void lat_calibrate()
+{
+    int i;
+    unsigned long long ns = 0;
+    unsigned long long cycles = 0;
+    unsigned long long begin = 0;
+    unsigned long long min = ~0ULL;
+
+    ns = bench_now();
+    cycles = lat_start();
+
+    while (bench_now() - ns < 50000000ULL) {
+    }
+
+    cycles = lat_stop() - cycles;
+    ns = bench_now() - ns;
+
+    lat_cycles_per_ns = (double)cycles / (double)ns;
+
+    /* 取空测量的最小值作为计时开销 */
+    for (i = 0; i < 10000; i++) {
+        begin = lat_start();
+        cycles = lat_stop() - begin;
+
+        if (cycles < min) {
+            min = cycles;
+        }
+    }
+
+    lat_overhead = min;
+}
+
+void lat_record(int op, int index, int path, unsigned long long cycles)
+{
+    LAT_HIST *hist = NULL;
+
+    if (index < 0 || index >= MEM_STATS_CLASS_COUNT) {
+        return;
+    }
+
+    hist = &lat_hist[op][index][path];
+    cycles = cycles > lat_overhead ? cycles - lat_overhead : 0;
+
+    hist->count++;
+    hist->sum += cycles;
+    hist->bucket[hist_bucket(cycles)]++;
+
+    if (cycles > hist->max) {
+        hist->max = cycles;
+    }
+}
+
+unsigned long long lat_pages(int index)
+{
+    struct mem_stats stats;
+
+    mem_stats_get(&stats);
+    return stats.classes[index].page_count;
+}
+
+void lat_print()
+{
+    int op;
+    int index;
+    int path;
+
+    LAT_HIST *hist = NULL;
+
+    printf("cycles/ns = %.3f, timer overhead = %llu cycles\n",
+        lat_cycles_per_ns, lat_overhead);
+    printf("%-8s %5s %-8s %10s %9s %9s %9s %9s %10s\n",
+        "op", "class", "path", "count", "mean_ns", "p50_ns", "p99_ns", "p99.9_ns", "max_ns");
+
+    for (op = 0; op < OP_COUNT; op++) {
+        for (index = 0; index < MEM_STATS_CLASS_COUNT; index++) {
+            for (path = 0; path < PATH_COUNT; path++) {
+                hist = &lat_hist[op][index][path];
+
+                if (!hist->count) {
+                    continue;
+                }
+
+                printf("%-8s %5d %-8s %10llu %9.1f %9.1f %9.1f %9.1f %10.1f\n",
+                    op_names[op], index, path_names[path], hist->count,
+                    (double)hist->sum / (double)hist->count / lat_cycles_per_ns,
+                    (double)hist_percentile(hist, 50.0) / lat_cycles_per_ns,
+                    (double)hist_percentile(hist, 99.0) / lat_cycles_per_ns,
+                    (double)hist_percentile(hist, 99.9) / lat_cycles_per_ns,
+                    (double)hist->max / lat_cycles_per_ns);
+            }
+        }
+    }
+}
+
+unsigned long long hist_percentile(const LAT_HIST *hist, double percent)
+{
+    int i;
+    unsigned long long seen = 0;
+    unsigned long long target = (unsigned long long)(hist->count * percent / 100.0);
+
+    if (target >= hist->count) {
+        target = hist->count - 1;
+    }
+
+    for (i = 0; i < HIST_BUCKETS; i++) {
+        seen += hist->bucket[i];
+
+        if (seen > target) {
+            /* 分位数不超过实际最大值 */
+            return hist_value(i) < hist->max ? hist_value(i) : hist->max;
+        }
+    }
+
+    return hist->max;
+}
+
+int hist_bucket(unsigned long long value)
+{
+    int exp = 0;
+
+    if (value < HIST_SUB_COUNT) {
+        return (int)value;
+    }
+
+    exp = 63 - __builtin_clzll(value);
+    return (exp - HIST_SUB_BITS + 1) * HIST_SUB_COUNT +
+        (int)((value >> (exp - HIST_SUB_BITS)) & (HIST_SUB_COUNT - 1));
+}
+
+unsigned long long hist_value(int bucket)
+{
+    int exp = 0;
+    unsigned long long sub = 0;
+
+    if (bucket < HIST_SUB_COUNT) {
+        return (unsigned long long)bucket;
+    }
+
+    /* 返回子区间的上界 */
+    exp = bucket / HIST_SUB_COUNT + HIST_SUB_BITS - 1;
+    sub = (unsigned long long)(bucket % HIST_SUB_COUNT);
+
+    return ((HIST_SUB_COUNT + sub + 1) << (exp - HIST_SUB_BITS)) - 1;
+}
+
+/*===========================================================================*/
@@ -0,0 +1,423 @@
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "bench_util.h"
+
+/*===========================================================================*/
+/* 多线程扩展性基准测试，按线程数扫描，与系统 malloc 对比 */
+/*===========================================================================*/
+
+#define MT_BASE_OPS         (1024 * 1024)       /* 每个线程的基准操作次数 */
+#define MT_BATCH            256                 /* 批量分配或移交的内存块数量 */
+#define MT_SLOTS            1024                /* larson 负载每组的存活内存块数量 */
+#define MT_EPOCHS           16                  /* larson 负载中内存块组轮换的次数 */
+#define MT_QUEUE            16                  /* 生产者与消费者之间的批次队列长度 */
+#define MT_MAX_THREADS      256
+#define MT_SEED             0x9E3779B97F4A7C15ULL
+
+/* 负载描述 */
+typedef struct mt_workload_st MT_WORKLOAD;
+
+/* 线程参数 */
+typedef struct {
+    const BENCH_ALLOC *alloc;
+    const MT_WORKLOAD *workload;
+    int id;                             /* 线程编号 */
+    int threads;                        /* 线程总数 */
+    unsigned long long ops;             /* 线程完成的操作次数 */
+} MT_THREAD;
+
+/* 线程函数 */
+typedef void (*MT_FUNC)(MT_THREAD *thread);
+
+struct mt_workload_st {
+    const char *name;
+    MT_FUNC func;
+    size_t min_size;
+    size_t max_size;
+    int paired;                         /* 线程数是否必须为偶数 */
+};
+
+/* 一次运行的参数 */
+typedef struct {
+    const MT_WORKLOAD *workload;
+    int threads;
+} MT_RUN;
+
+/* 生产者移交给消费者的批次队列 */
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    void **batch[MT_QUEUE];
+    int head;
+    int count;
+    int done;                           /* 生产者已结束 */
+} MT_QUEUE_ST;
+
+/* 操作次数倍率 */
+static double mt_scale = 1.0;
+
+/* 运行中的共享状态，只在子进程中使用 */
+static pthread_barrier_t mt_barrier;
+static void **mt_slots[MT_MAX_THREADS];
+static MT_QUEUE_ST mt_queue[MT_MAX_THREADS / 2];
+
+/*===========================================================================*/
+
+/* 每个线程独立批量分配和释放（threadtest） */
+static void mt_threadtest(MT_THREAD *thread);
+
+/* 每个线程随机替换存活内存块，各轮之间内存块组在线程间轮换（larson） */
+static void mt_larson(MT_THREAD *thread);
+
+/* 偶数线程分配，奇数线程释放（生产者/消费者） */
+static void mt_handoff(MT_THREAD *thread);
+
+/* 在子进程中运行一次负载 */
+static void mt_run(const BENCH_ALLOC *alloc, void *arg, BENCH_RESULT *result);
+static void *mt_entry(void *arg);
+
+/* 批次队列 */
+static void queue_push(MT_QUEUE_ST *queue, void **batch);
+static void **queue_pop(MT_QUEUE_ST *queue);
+
+static unsigned long long scaled_ops();
+
+/*===========================================================================*/
+
+static MT_WORKLOAD workloads[] = {
+    { "threadtest_64",  mt_threadtest, 64,  64,    0 },
+    { "larson_small",   mt_larson,     8,   512,   0 },
+    { "handoff_small",  mt_handoff,    8,   512,   1 },
+    { "mixed",          mt_larson,     8,   16384, 0 },
+};
+
+/*===========================================================================*/
+
+int main(int argc, char *argv[])
+{
+    size_t i;
+    int j;
+    int threads = 0;
+    int last = 0;
+    int next = 0;
+    int max_threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    const char *filter = NULL;
+
+    MT_RUN run;
+    BENCH_RESULT result[2];
+    double base[2];
+    double rate = 0;
+    const BENCH_ALLOC *allocs[] = { &bench_mem_alloc, &bench_sys_alloc };
+
+    for (j = 1; j < argc; j++) {
+        if (!strcmp(argv[j], "-s") && j + 1 < argc) {
+            mt_scale = atof(argv[++j]);
+        } else if (!strcmp(argv[j], "-t") && j + 1 < argc) {
+            max_threads = atoi(argv[++j]);
+        } else if (!strcmp(argv[j], "-h")) {
+            printf("usage: %s [-s scale] [-t max threads] [workload substring]\n", argv[0]);
+            return 0;
+        } else {
+            filter = argv[j];
+        }
+    }
+
+    if (mt_scale <= 0) {
+        mt_scale = 1.0;
+    }
+
+    if (max_threads < 1) {
+        max_threads = 1;
+    }
+
+    if (max_threads > MT_MAX_THREADS) {
+        max_threads = MT_MAX_THREADS;
+    }
+
+    printf("%-16s %4s %-6s %14s %9s %12s %8s\n",
+        "workload", "thr", "alloc", "ops/sec", "scaling", "peak_rss_kb", "blowup");
+
+    for (i = 0; i < sizeof(workloads) / sizeof(workloads[0]); i++) {
+        if (filter && !strstr(workloads[i].name, filter)) {
+            continue;
+        }
+
+        base[0] = base[1] = 0;
+        last = 0;
+
+        /* 线程数按 2 的幂扫描，最后补上最大线程数 */
+        for (threads = 1; threads <= max_threads; threads = next) {
+            next = threads * 2;
+            if (next > max_threads && threads < max_threads) {
+                next = max_threads;
+            }
+
+            run.workload = workloads + i;
+            run.threads  = threads;
+
+            /* 生产者和消费者成对出现，线程数向上取偶 */
+            if (workloads[i].paired && threads % 2) {
+                run.threads = threads + 1;
+
+                if (run.threads > max_threads && max_threads > 1) {
+                    run.threads = max_threads & ~1;
+                }
+            }
+
+            if (run.threads == last) {
+                continue;
+            }
+
+            last = run.threads;
+
+            for (j = 0; j < 2; j++) {
+                if (bench_run(mt_run, allocs[j], &run, result + j)) {
+                    memset(result + j, 0, sizeof(BENCH_RESULT));
+                }
+            }
+
+            for (j = 0; j < 2; j++) {
+                if (!result[j].ns) {
+                    printf("%-16s %4d %-6s failed\n",
+                        workloads[i].name, run.threads, allocs[j]->name);
+                    continue;
+                }
+
+                rate = (double)result[j].ops * 1e9 / (double)result[j].ns;
+                if (!base[j]) {
+                    base[j] = rate / run.threads;
+                }
+
+                /* 扩展效率 = 实际吞吐 / (单线程吞吐 * 线程数)，内存膨胀以系统 malloc 为基准 */
+                printf("%-16s %4d %-6s %14.0f %8.1f%% %12ld",
+                    workloads[i].name, run.threads, allocs[j]->name, rate,
+                    rate * 100.0 / (base[j] * run.threads), result[j].peak_rss);
+
+                if (!j && result[1].peak_rss) {
+                    printf(" %7.2fx\n", (double)result[0].peak_rss / (double)result[1].peak_rss);
+                } else {
+                    printf("\n");
+                }
+            }
+        }
+    }
+
+    return 0;
+}
+
+/*===========================================================================*/
+
+void mt_threadtest(MT_THREAD *thread)
+{
+    int i;
+    unsigned long long round;
+    unsigned long long rounds = scaled_ops() / (2 * MT_BATCH);
+    size_t size = thread->workload->min_size;
+    void *blocks[MT_BATCH];
+
+    for (round = 0; round < rounds; round++) {
+        for (i = 0; i < MT_BATCH; i++) {
+            blocks[i] = thread->alloc->alloc(size);
+            bench_touch(blocks[i], size);
+        }
+
+        for (i = 0; i < MT_BATCH; i++) {
+            thread->alloc->release(blocks[i]);
+        }
+    }
+
+    thread->ops = rounds * 2 * MT_BATCH;
+}
+
+void mt_larson(MT_THREAD *thread)
+{
+    int epoch;
+    size_t size = 0;
+    unsigned long long i;
+    unsigned long long slot = 0;
+    unsigned long long ops = 0;
+    unsigned long long count = scaled_ops() / (2 * MT_EPOCHS);
+    unsigned long long state = MT_SEED + (unsigned long long)thread->id;
+    void **slots = NULL;
+
+    for (epoch = 0; epoch < MT_EPOCHS; epoch++) {
+        /* 每一轮使用上一轮由其他线程分配的内存块组 */
+        slots = mt_slots[(thread->id + epoch) % thread->threads];
+
+        for (i = 0; i < count; i++) {
+            slot = bench_rand(&state) % MT_SLOTS;
+            size = bench_random_size(&state, thread->workload->min_size, thread->workload->max_size);
+
+            if (slots[slot]) {
+                thread->alloc->release(slots[slot]);
+                ops++;
+            }
+
+            slots[slot] = thread->alloc->alloc(size);
+            bench_touch(slots[slot], size);
+            ops++;
+        }
+
+        pthread_barrier_wait(&mt_barrier);
+    }
+
+    /* 释放当前持有的内存块组 */
+    for (i = 0; i < MT_SLOTS; i++) {
+        if (slots[i]) {
+            thread->alloc->release(slots[i]);
+            slots[i] = NULL;
+            ops++;
+        }
+    }
+
+    thread->ops = ops;
+}
+
+void mt_handoff(MT_THREAD *thread)
+{
+    int i;
+    size_t size = 0;
+    unsigned long long round;
+    unsigned long long rounds = scaled_ops() / (2 * MT_BATCH);
+    unsigned long long state = MT_SEED + (unsigned long long)thread->id;
+    unsigned long long ops = 0;
+
+    MT_QUEUE_ST *queue = mt_queue + thread->id / 2;
+    void **batch = NULL;
+
+    if (thread->id % 2 == 0) {
+        for (round = 0; round < rounds; round++) {
+            batch = (void **)malloc(sizeof(void *) * MT_BATCH);
+
+            for (i = 0; i < MT_BATCH; i++) {
+                size = bench_random_size(&state, thread->workload->min_size, thread->workload->max_size);
+                batch[i] = thread->alloc->alloc(size);
+                bench_touch(batch[i], size);
+            }
+
+            queue_push(queue, batch);
+            ops += MT_BATCH;
+        }
+
+        queue_push(queue, NULL);
+    } else {
+        while ((batch = queue_pop(queue)) != NULL) {
+            for (i = 0; i < MT_BATCH; i++) {
+                thread->alloc->release(batch[i]);
+            }
+
+            free(batch);
+            ops += MT_BATCH;
+        }
+    }
+
+    thread->ops = ops;
+}
+
+void mt_run(const BENCH_ALLOC *alloc, void *arg, BENCH_RESULT *result)
+{
+    int i;
+    unsigned long long start = 0;
+
+    MT_RUN *run = (MT_RUN *)arg;
+    MT_THREAD thread[MT_MAX_THREADS];
+    pthread_t tid[MT_MAX_THREADS];
+
+    pthread_barrier_init(&mt_barrier, NULL, (unsigned)run->threads);
+
+    for (i = 0; i < run->threads; i++) {
+        mt_slots[i] = (void **)calloc(MT_SLOTS, sizeof(void *));
+    }
+
+    for (i = 0; i < run->threads / 2; i++) {
+        memset(mt_queue + i, 0, sizeof(MT_QUEUE_ST));
+        pthread_mutex_init(&mt_queue[i].lock, NULL);
+        pthread_cond_init(&mt_queue[i].cond, NULL);
+    }
+
+    start = bench_now();
+
+    for (i = 0; i < run->threads; i++) {
+        thread[i].alloc    = alloc;
+        thread[i].workload = run->workload;
+        thread[i].id       = i;
+        thread[i].threads  = run->threads;
+        thread[i].ops      = 0;
+
+        pthread_create(tid + i, NULL, mt_entry, thread + i);
+    }
+
+    for (i = 0; i < run->threads; i++) {
+        pthread_join(tid[i], NULL);
+        result->ops += thread[i].ops;
+    }
+
+    result->ns = bench_now() - start;
+
+    for (i = 0; i < run->threads; i++) {
+        free(mt_slots[i]);
+    }
+
+    pthread_barrier_destroy(&mt_barrier);
+}
+
+void *mt_entry(void *arg)
+{
+    MT_THREAD *thread = (MT_THREAD *)arg;
+
+    thread->workload->func(thread);
+    return NULL;
+}
+
+void queue_push(MT_QUEUE_ST *queue, void **batch)
+{
+    pthread_mutex_lock(&queue->lock);
+
+    while (queue->count == MT_QUEUE) {
+        pthread_cond_wait(&queue->cond, &queue->lock);
+    }
+
+    if (batch) {
+        queue->batch[(queue->head + queue->count) % MT_QUEUE] = batch;
+        queue->count++;
+    } else {
+        queue->done = 1;
+    }
+
+    pthread_cond_broadcast(&queue->cond);
+    pthread_mutex_unlock(&queue->lock);
+}
+
+void **queue_pop(MT_QUEUE_ST *queue)
+{
+    void **batch = NULL;
+
+    pthread_mutex_lock(&queue->lock);
+
+    while (!queue->count && !queue->done) {
+        pthread_cond_wait(&queue->cond, &queue->lock);
+    }
+
+    if (queue->count) {
+        batch = queue->batch[queue->head];
+        queue->head = (queue->head + 1) % MT_QUEUE;
+        queue->count--;
+        pthread_cond_broadcast(&queue->cond);
+    }
+
+    pthread_mutex_unlock(&queue->lock);
+    return batch;
+}
+
+unsigned long long scaled_ops()
+{
+    return (unsigned long long)(MT_BASE_OPS * mt_scale);
+}
+
+/*===========================================================================*/
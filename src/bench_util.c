@@ -0,0 +1,235 @@
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <sys/resource.h>
+#include <linux/perf_event.h>
+
+#include "mem.h"
+#include "bench_util.h"
+
+/*===========================================================================*/
+
+static void sys_init();
+static void sys_fini();
+
+/* 开启 NUMA 模式，单节点机器上子进程直接以失败退出 */
+static void numa_init();
+
+/* 从管道中读满指定长度 */
+static int read_full(int fd, void *buf, size_t len);
+
+/*===========================================================================*/
+
+const BENCH_ALLOC bench_mem_alloc = {
+    "mem", create_res, clear_res, mem_malloc, mem_realloc, mem_free
+};
+
+const BENCH_ALLOC bench_sys_alloc = {
+    "glibc", sys_init, sys_fini, malloc, realloc, free
+};
+
+const BENCH_ALLOC bench_numa_alloc = {
+    "numa", numa_init, clear_res, mem_malloc, mem_realloc, mem_free
+};
+
+/*===========================================================================*/
+
+int bench_run(BENCH_FUNC func, const BENCH_ALLOC *alloc, void *arg, BENCH_RESULT *result)
+{
+    int ret = 0;
+    int status = 0;
+    int fds[2];
+    pid_t pid;
+    struct rusage usage;
+
+    memset(result, 0, sizeof(BENCH_RESULT));
+    fflush(stdout);
+
+    if (pipe(fds)) {
+        return -1;
+    }
+
+    pid = fork();
+    if (pid < 0) {
+        close(fds[0]);
+        close(fds[1]);
+        return -1;
+    }
+
+    if (!pid) {
+        close(fds[0]);
+
+        alloc->init();
+        func(alloc, arg, result);
+        alloc->fini();
+
+        status = write(fds[1], result, sizeof(BENCH_RESULT)) == sizeof(BENCH_RESULT);
+        close(fds[1]);
+        _exit(status ? 0 : 1);
+    }
+
+    close(fds[1]);
+    ret = read_full(fds[0], result, sizeof(BENCH_RESULT));
+    close(fds[0]);
+
+    memset(&usage, 0, sizeof(usage));
+    if (wait4(pid, &status, 0, &usage) < 0 || ret ||
+        !WIFEXITED(status) || WEXITSTATUS(status)) {
+        return -1;
+    }
+
+    result->peak_rss = usage.ru_maxrss;
+    return 0;
+}
+
+unsigned long long bench_now()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+unsigned long long bench_rand(unsigned long long *state)
+{
+    unsigned long long x = *state;
+
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+
+    *state = x;
+    return x;
+}
+
+size_t bench_random_size(unsigned long long *state, size_t min_size, size_t max_size)
+{
+    size_t range = 0;
+    int bits = 0;
+
+    if (min_size >= max_size) {
+        return min_size;
+    }
+
+    for (range = max_size; range > min_size; range >>= 1) {
+        bits++;
+    }
+
+    range = max_size >> (bench_rand(state) % (unsigned long long)(bits + 1));
+    if (range < min_size) {
+        range = min_size;
+    }
+
+    return min_size + (size_t)(bench_rand(state) % (unsigned long long)(range - min_size + 1));
+}
+
+void bench_touch(void *ptr, size_t len)
+{
+    if (ptr && len) {
+        ((volatile unsigned char *)ptr)[0] = (unsigned char)len;
+        ((volatile unsigned char *)ptr)[len - 1] = (unsigned char)len;
+    }
+}
+
+int bench_l1d_open()
+{
+    int fd = -1;
+    struct perf_event_attr attr;
+
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HW_CACHE;
+    attr.config = PERF_COUNT_HW_CACHE_L1D |
+        (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+        (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+
+    fd = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+    if (fd < 0) {
+        return -1;
+    }
+
+    ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+    return fd;
+}
+
+long long bench_l1d_close(int fd)
+{
+    long long count = -1;
+
+    if (fd < 0) {
+        return -1;
+    }
+
+    if (read(fd, &count, sizeof(count)) != sizeof(count)) {
+        count = -1;
+    }
+
+    close(fd);
+    return count;
+}
+
+void bench_print_head()
+{
+    printf("%-24s %-6s %12s %14s %9s %12s\n",
+        "workload", "alloc", "ops", "ops/sec", "ns/op", "peak_rss_kb");
+}
+
+void bench_print(const char *workload, const char *alloc, const BENCH_RESULT *result)
+{
+    double sec = (double)result->ns / 1e9;
+
+    printf("%-24s %-6s %12llu %14.0f %9.2f %12ld\n", workload, alloc, result->ops,
+        sec > 0 ? (double)result->ops / sec : 0.0,
+        result->ops ? (double)result->ns / (double)result->ops : 0.0,
+        result->peak_rss);
+}
+
+/*===========================================================================*/
+
+void sys_init()
+{
+}
+
+void sys_fini()
+{
+}
+
+void numa_init()
+{
+    create_res();
+
+    if (mem_enable_numa()) {
+        clear_res();
+        _exit(1);
+    }
+}
+
+int read_full(int fd, void *buf, size_t len)
+{
+    ssize_t ret = 0;
+    unsigned char *cursor = (unsigned char *)buf;
+
+    while (len > 0) {
+        ret = read(fd, cursor, len);
+        if (ret <= 0) {
+            return -1;
+        }
+
+        cursor += ret;
+        len -= (size_t)ret;
+    }
+
+    return 0;
+}
+
+/*===========================================================================*/
@@ -0,0 +1,70 @@
+#ifndef __BENCH_UTIL_H__
+#define __BENCH_UTIL_H__
+
+#include <stddef.h>
+
+/*===========================================================================*/
+/* 基准测试公共部分，仅支持 Linux */
+/*===========================================================================*/
+
+/* 被测分配器 */
+typedef struct {
+    const char *name;
+    void  (*init)();
+    void  (*fini)();
+    void *(*alloc)(size_t len);
+    void *(*resize)(void *ptr, size_t len);
+    void  (*release)(void *ptr);
+} BENCH_ALLOC;
+
+/* mem_malloc 系列 */
+extern const BENCH_ALLOC bench_mem_alloc;
+
+/* 系统 malloc 系列，作为基准 */
+extern const BENCH_ALLOC bench_sys_alloc;
+
+/* NUMA 模式下的 mem_malloc 系列，内存页从节点内存池中按固定间隔切分 */
+extern const BENCH_ALLOC bench_numa_alloc;
+
+/* 单次运行结果 */
+typedef struct {
+    unsigned long long ops;             /* 分配与释放的总次数 */
+    unsigned long long ns;              /* 计时部分的耗时，单位为纳秒 */
+    long peak_rss;                      /* 进程峰值常驻内存，单位为 KB */
+    long long extra[4];                 /* 负载自定义的附加数据 */
+} BENCH_RESULT;
+
+/* 负载函数，自行计时并填写 ops 和 ns */
+typedef void (*BENCH_FUNC)(const BENCH_ALLOC *alloc, void *arg, BENCH_RESULT *result);
+
+/*
+ * 在子进程中运行一次负载，分配器在子进程中初始化和销毁，峰值常驻内存
+ * 由 wait4 取得，各次运行互不影响；子进程异常退出时返回 -1
+ */
+int bench_run(BENCH_FUNC func, const BENCH_ALLOC *alloc, void *arg, BENCH_RESULT *result);
+
+/* 单调时钟，单位为纳秒 */
+unsigned long long bench_now();
+
+/* 可复现的伪随机数，state 不能为 0 */
+unsigned long long bench_rand(unsigned long long *state);
+
+/* 对数均匀分布的随机尺寸，先随机选取数量级，再在数量级内均匀选取 */
+size_t bench_random_size(unsigned long long *state, size_t min_size, size_t max_size);
+
+/* 写入内存块首尾字节，模拟使用并防止分配被优化掉 */
+void bench_touch(void *ptr, size_t len);
+
+/* 开始统计当前线程的 L1 数据缓存读缺失次数，内核不支持或无权限时返回 -1 */
+int bench_l1d_open();
+
+/* 读取 L1 数据缓存读缺失次数并关闭计数器，fd 无效时返回 -1 */
+long long bench_l1d_close(int fd);
+
+/* 打印结果表头和一行结果 */
+void bench_print_head();
+void bench_print(const char *workload, const char *alloc, const BENCH_RESULT *result);
+
+/*===========================================================================*/
+
+#endif /* __BENCH_UTIL_H__ */
@@ -0,0 +1,603 @@
+#if defined(WIN32)
+#define _CRT_SECURE_NO_WARNINGS
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "mem.h"
+#include "mem_page.h"
+#include "mem_dump.h"
+
+/*===========================================================================*/
+/* 堆转储读取工具，读取 mem_dump 生成的转储文件并输出汇总信息 */
+/*===========================================================================*/
+
+#define READER_LINE_SIZE    4096        /* JSON 单行最大长度 */
+#define READER_NAME_SIZE    256         /* 字符串字段最大长度 */
+#define READER_TOP_SITES    20          /* 输出字节数最多的调用位置数量 */
+#define READER_MAX_SITES    65536       /* 调用位置编号上限，超出的编号忽略 */
+#define READER_DATA_SIZE    65536       /* 二进制记录负载的最大长度 */
+
+/* 内存分类汇总 */
+typedef struct {
+    unsigned long long block_size;
+    unsigned long long live_blocks;
+    unsigned long long live_bytes;
+    unsigned long long pages;
+    unsigned long long idle_pages;
+    unsigned long long page_bytes;      /* 由内存页记录累加的内存页总大小 */
+    unsigned long long dump_blocks;     /* 由内存块记录累加的内存块数量 */
+    unsigned long long dump_bytes;      /* 由内存块记录累加的字节数 */
+} READER_CLASS;
+
+/* 调用位置汇总 */
+typedef struct {
+    unsigned int id;
+    int line;
+    char file[READER_NAME_SIZE];
+    char func[READER_NAME_SIZE];
+
+    unsigned long long count;
+    unsigned long long bytes;
+    unsigned long long oldest;          /* 最早的分配时刻 */
+} READER_SITE;
+
+/* 转储汇总 */
+typedef struct {
+    int binary;                         /* 是否为二进制格式 */
+    unsigned long long version;
+    unsigned long long time;            /* 转储时的系统时间 */
+    unsigned long long now;             /* 转储时的单调时钟 */
+    int ended;                          /* 是否读到了结尾记录 */
+
+    unsigned long long records;
+    unsigned long long pages;
+    unsigned long long blocks;
+    unsigned long long bytes;
+
+    READER_CLASS classes[MEM_STATS_CLASS_COUNT];
+
+    READER_SITE *sites;                 /* 以 id 为索引的调用位置表 */
+    size_t site_capacity;
+} READER;
+
+/* 各类二进制记录负载的固定部分长度，以记录类型为索引，短于此长度的记录跳过 */
+static const unsigned long long reader_rec_size[] = {
+    0,
+    24,                                 /* header */
+    64,                                 /* class */
+    48,                                 /* page */
+    12,                                 /* site，两个字符串均为空 */
+    44,                                 /* block */
+    32                                  /* end */
+};
+
+/*===========================================================================*/
+
+/* 获取调用位置，不存在时扩容；编号超过上限时返回 NULL */
+static READER_SITE *reader_site(READER *reader, unsigned long long id);
+
+/* 记录处理 */
+static void on_header(READER *reader, unsigned long long version,
+    unsigned long long time, unsigned long long now);
+static void on_class(READER *reader, unsigned long long index,
+    unsigned long long block_size, unsigned long long live_blocks,
+    unsigned long long live_bytes, unsigned long long pages,
+    unsigned long long idle_pages);
+static void on_page(READER *reader, unsigned long long index,
+    unsigned long long page_size);
+static void on_site(READER *reader, unsigned long long id, unsigned long long line,
+    const char *file, const char *func);
+static void on_block(READER *reader, unsigned long long size,
+    unsigned long long index, unsigned long long site, unsigned long long time);
+
+/* JSON Lines 格式读取 */
+static int read_json(READER *reader, FILE *fp);
+static int json_u64(const char *line, const char *key, unsigned long long *value);
+static int json_str(const char *line, const char *key, char *buff, int size);
+
+/* 二进制格式读取 */
+static int read_binary(READER *reader, FILE *fp);
+/* 读取字段，end 为记录结尾，越过结尾时返回 0 并停在结尾 */
+static unsigned long long get_u16(const unsigned char **cursor, const unsigned char *end);
+static unsigned long long get_u32(const unsigned char **cursor, const unsigned char *end);
+static unsigned long long get_u64(const unsigned char **cursor, const unsigned char *end);
+static void get_str(const unsigned char **cursor, const unsigned char *end,
+    char *buff, int size);
+
+/* 输出汇总信息 */
+static void print_summary(READER *reader);
+static int compare_site(const void *a, const void *b);
+
+/*===========================================================================*/
+
+int main(int argc, char *argv[])
+{
+    int ret = 0;
+    FILE *fp = NULL;
+    char magic[MEM_DUMP_MAGIC_SIZE];
+
+    READER reader;
+
+    if (argc < 2) {
+        printf("usage: %s <dump file>\n", argv[0]);
+        return 1;
+    }
+
+    fp = fopen(argv[1], "rb");
+    if (!fp) {
+        printf("can not open %s\n", argv[1]);
+        return 1;
+    }
+
+    memset(&reader, 0, sizeof(READER));
+
+    /* 通过文件头区分二进制格式和 JSON Lines 格式 */
+    if (fread(magic, 1, MEM_DUMP_MAGIC_SIZE, fp) == MEM_DUMP_MAGIC_SIZE &&
+        !memcmp(magic, MEM_DUMP_MAGIC, MEM_DUMP_MAGIC_SIZE)) {
+        reader.binary = 1;
+        ret = read_binary(&reader, fp);
+    } else {
+        rewind(fp);
+        ret = read_json(&reader, fp);
+    }
+
+    fclose(fp);
+
+    if (ret != MEM_SUCCESS) {
+        printf("%s is not a valid heap dump\n", argv[1]);
+        free(reader.sites);
+        return 1;
+    }
+
+    print_summary(&reader);
+    free(reader.sites);
+
+    return 0;
+}
+
+/*===========================================================================*/
+
+READER_SITE *reader_site(READER *reader, unsigned long long id)
+{
+    size_t capacity = reader->site_capacity;
+    READER_SITE *sites = NULL;
+
+    if (id >= READER_MAX_SITES) {
+        return NULL;
+    }
+
+    if (id >= capacity) {
+        capacity = capacity ? capacity : 64;
+
+        while (capacity <= id) {
+            capacity *= 2;
+        }
+
+        sites = (READER_SITE *)realloc(reader->sites, sizeof(READER_SITE) * capacity);
+        if (!sites) {
+            return NULL;
+        }
+
+        memset(sites + reader->site_capacity, 0,
+            sizeof(READER_SITE) * (capacity - reader->site_capacity));
+
+        reader->sites = sites;
+        reader->site_capacity = capacity;
+    }
+
+    return reader->sites + (size_t)id;
+}
+
+void on_header(READER *reader, unsigned long long version,
+    unsigned long long time, unsigned long long now)
+{
+    reader->version = version;
+    reader->time = time;
+    reader->now = now;
+}
+
+void on_class(READER *reader, unsigned long long index,
+    unsigned long long block_size, unsigned long long live_blocks,
+    unsigned long long live_bytes, unsigned long long pages,
+    unsigned long long idle_pages)
+{
+    READER_CLASS *info = NULL;
+
+    if (index >= MEM_STATS_CLASS_COUNT) {
+        return;
+    }
+
+    info = reader->classes + index;
+    info->block_size  = block_size;
+    info->live_blocks = live_blocks;
+    info->live_bytes  = live_bytes;
+    info->pages       = pages;
+    info->idle_pages  = idle_pages;
+}
+
+void on_page(READER *reader, unsigned long long index, unsigned long long page_size)
+{
+    reader->pages++;
+
+    if (index < MEM_STATS_CLASS_COUNT) {
+        reader->classes[index].page_bytes += page_size;
+    }
+}
+
+void on_site(READER *reader, unsigned long long id, unsigned long long line,
+    const char *file, const char *func)
+{
+    READER_SITE *site = reader_site(reader, id);
+
+    if (!site) {
+        return;
+    }
+
+    site->id = (unsigned int)id;
+    site->line = (int)line;
+
+    strncpy(site->file, file, READER_NAME_SIZE - 1);
+    strncpy(site->func, func, READER_NAME_SIZE - 1);
+}
+
+void on_block(READER *reader, unsigned long long size,
+    unsigned long long index, unsigned long long site, unsigned long long time)
+{
+    READER_SITE *info = NULL;
+
+    reader->blocks++;
+    reader->bytes += size;
+
+    if (index < MEM_STATS_CLASS_COUNT) {
+        reader->classes[index].dump_blocks++;
+        reader->classes[index].dump_bytes += size;
+    }
+
+    if (!site) {
+        return;
+    }
+
+    info = reader_site(reader, site);
+    if (!info) {
+        return;
+    }
+
+    if (!info->count || time < info->oldest) {
+        info->oldest = time;
+    }
+
+    info->count++;
+    info->bytes += size;
+}
+
+int read_json(READER *reader, FILE *fp)
+{
+    char line[READER_LINE_SIZE];
+    char type[32];
+    char file[READER_NAME_SIZE];
+    char func[READER_NAME_SIZE];
+
+    unsigned long long v[8];
+
+    while (fgets(line, READER_LINE_SIZE, fp)) {
+        if (json_str(line, "t", type, sizeof(type)) != MEM_SUCCESS) {
+            continue;
+        }
+
+        reader->records++;
+        memset(v, 0, sizeof(v));
+
+        if (!strcmp(type, "header")) {
+            json_u64(line, "version", v);
+            json_u64(line, "time", v + 1);
+            json_u64(line, "now", v + 2);
+            on_header(reader, v[0], v[1], v[2]);
+        } else if (!strcmp(type, "class")) {
+            json_u64(line, "index", v);
+            json_u64(line, "block_size", v + 1);
+            json_u64(line, "live_blocks", v + 2);
+            json_u64(line, "live_bytes", v + 3);
+            json_u64(line, "pages", v + 4);
+            json_u64(line, "idle_pages", v + 5);
+            on_class(reader, v[0], v[1], v[2], v[3], v[4], v[5]);
+        } else if (!strcmp(type, "page")) {
+            json_u64(line, "class", v);
+            json_u64(line, "page_size", v + 1);
+            on_page(reader, v[0], v[1]);
+        } else if (!strcmp(type, "site")) {
+            json_u64(line, "id", v);
+            json_u64(line, "line", v + 1);
+            json_str(line, "file", file, READER_NAME_SIZE);
+            json_str(line, "func", func, READER_NAME_SIZE);
+            on_site(reader, v[0], v[1], file, func);
+        } else if (!strcmp(type, "block")) {
+            json_u64(line, "size", v);
+            json_u64(line, "class", v + 1);
+            json_u64(line, "site", v + 2);
+            json_u64(line, "time", v + 3);
+            on_block(reader, v[0], v[1], v[2], v[3]);
+        } else if (!strcmp(type, "end")) {
+            reader->ended = 1;
+        }
+    }
+
+    return reader->records ? MEM_SUCCESS : MEM_FAILED;
+}
+
+int json_u64(const char *line, const char *key, unsigned long long *value)
+{
+    char pattern[64];
+    const char *pos = NULL;
+
+    sprintf(pattern, "\"%s\":", key);
+
+    pos = strstr(line, pattern);
+    if (!pos) {
+        return MEM_FAILED;
+    }
+
+    *value = strtoull(pos + strlen(pattern), NULL, 10);
+    return MEM_SUCCESS;
+}
+
+int json_str(const char *line, const char *key, char *buff, int size)
+{
+    int i = 0;
+    char pattern[64];
+    const char *pos = NULL;
+
+    sprintf(pattern, "\"%s\":\"", key);
+
+    pos = strstr(line, pattern);
+    if (!pos) {
+        buff[0] = '\0';
+        return MEM_FAILED;
+    }
+
+    /* 只处理转储中会出现的转义 */
+    for (pos += strlen(pattern); *pos && *pos != '"' && i < size - 1; pos++) {
+        if (*pos == '\\' && pos[1]) {
+            pos++;
+
+            if (*pos == 'u') {
+                buff[i++] = (char)strtol(pos + 1, NULL, 16);
+                pos += 4;
+                continue;
+            }
+        }
+
+        buff[i++] = *pos;
+    }
+
+    buff[i] = '\0';
+    return MEM_SUCCESS;
+}
+
+int read_binary(READER *reader, FILE *fp)
+{
+    unsigned char head[8];
+    unsigned char *data = NULL;
+    const unsigned char *cursor = NULL;
+    const unsigned char *end = NULL;
+
+    unsigned long long type = 0;
+    unsigned long long len = 0;
+    unsigned long long v[8];
+
+    char file[READER_NAME_SIZE];
+    char func[READER_NAME_SIZE];
+
+    data = (unsigned char *)malloc(READER_DATA_SIZE);
+    if (!data) {
+        return MEM_FAILED;
+    }
+
+    while (fread(head, 1, sizeof(head), fp) == sizeof(head)) {
+        cursor = head;
+        end = head + sizeof(head);
+        type = get_u32(&cursor, end);
+        len = get_u32(&cursor, end);
+
+        if (len > READER_DATA_SIZE || fread(data, 1, (size_t)len, fp) != len) {
+            break;
+        }
+
+        reader->records++;
+        cursor = data;
+        end = data + len;
+
+        /* 已知类型的记录短于固定长度时视为损坏，与无法识别的记录一样跳过 */
+        if (type < sizeof(reader_rec_size) / sizeof(reader_rec_size[0]) &&
+            len < reader_rec_size[type]) {
+            continue;
+        }
+
+        switch (type) {
+        case MEM_DUMP_REC_HEADER:
+            v[0] = get_u32(&cursor, end);
+            get_u32(&cursor, end);
+            v[1] = get_u64(&cursor, end);
+            v[2] = get_u64(&cursor, end);
+            on_header(reader, v[0], v[1], v[2]);
+            break;
+
+        case MEM_DUMP_REC_CLASS:
+            v[0] = get_u32(&cursor, end);
+            v[1] = get_u32(&cursor, end);
+            get_u64(&cursor, end);
+            get_u64(&cursor, end);
+            v[2] = get_u64(&cursor, end);
+            v[3] = get_u64(&cursor, end);
+            v[4] = get_u64(&cursor, end);
+            v[5] = get_u64(&cursor, end);
+            on_class(reader, v[0], v[1], v[2], v[3], v[4], v[5]);
+            break;
+
+        case MEM_DUMP_REC_PAGE:
+            get_u64(&cursor, end);
+            v[0] = get_u32(&cursor, end);
+
+            /* 跳过 node 到 alloc_size 的 8 个字段 */
+            cursor += 8 * 4;
+            v[1] = get_u32(&cursor, end);
+            on_page(reader, v[0], v[1]);
+            break;
+
+        case MEM_DUMP_REC_SITE:
+            v[0] = get_u32(&cursor, end);
+            v[1] = get_u32(&cursor, end);
+            get_str(&cursor, end, file, READER_NAME_SIZE);
+            get_str(&cursor, end, func, READER_NAME_SIZE);
+            on_site(reader, v[0], v[1], file, func);
+            break;
+
+        case MEM_DUMP_REC_BLOCK:
+            get_u64(&cursor, end);
+            v[0] = get_u64(&cursor, end);
+            v[1] = get_u32(&cursor, end);
+            get_u32(&cursor, end);
+            v[2] = get_u32(&cursor, end);
+            v[3] = get_u64(&cursor, end);
+            on_block(reader, v[0], v[1], v[2], v[3]);
+            break;
+
+        case MEM_DUMP_REC_END:
+            reader->ended = 1;
+            break;
+
+        default:
+            /* 跳过无法识别的记录 */
+            break;
+        }
+    }
+
+    free(data);
+    return reader->records ? MEM_SUCCESS : MEM_FAILED;
+}
+
+unsigned long long get_u16(const unsigned char **cursor, const unsigned char *end)
+{
+    unsigned long long ret = 0;
+
+    if (end - *cursor < 2) {
+        *cursor = end;
+        return 0;
+    }
+
+    ret = (*cursor)[0] | ((unsigned long long)(*cursor)[1] << 8);
+
+    *cursor += 2;
+    return ret;
+}
+
+unsigned long long get_u32(const unsigned char **cursor, const unsigned char *end)
+{
+    unsigned long long low = get_u16(cursor, end);
+    return low | (get_u16(cursor, end) << 16);
+}
+
+unsigned long long get_u64(const unsigned char **cursor, const unsigned char *end)
+{
+    unsigned long long low = get_u32(cursor, end);
+    return low | (get_u32(cursor, end) << 32);
+}
+
+void get_str(const unsigned char **cursor, const unsigned char *end,
+    char *buff, int size)
+{
+    int len = (int)get_u16(cursor, end);
+    int copy = 0;
+
+    /* 长度字段超出记录时只取到记录结尾 */
+    if (len > end - *cursor) {
+        len = (int)(end - *cursor);
+    }
+
+    copy = len < size - 1 ? len : size - 1;
+
+    memcpy(buff, *cursor, copy);
+    buff[copy] = '\0';
+
+    *cursor += len;
+}
+
+void print_summary(READER *reader)
+{
+    int i;
+    int count = 0;
+    size_t j;
+
+    READER_CLASS *info = NULL;
+    READER_SITE **list = NULL;
+
+    printf("format   = %s, version = %llu%s\n",
+        reader->binary ? "binary" : "json", reader->version,
+        reader->ended ? "" : " (truncated)");
+    printf("records  = %llu\n", reader->records);
+    printf("pages    = %llu\n", reader->pages);
+    printf("blocks   = %llu, bytes = %llu\n", reader->blocks, reader->bytes);
+
+    printf("\nclass  block_size  live_blocks    live_bytes  pages  idle   page_bytes\n");
+
+    for (i = 0; i < MEM_STATS_CLASS_COUNT; i++) {
+        info = reader->classes + i;
+
+        if (!info->pages && !info->dump_blocks) {
+            continue;
+        }
+
+        printf("%5d  %10llu  %11llu  %12llu  %5llu  %4llu  %11llu\n",
+            i, info->block_size, info->dump_blocks, info->dump_bytes,
+            info->pages, info->idle_pages, info->page_bytes);
+    }
+
+    /* 按字节数排序输出调用位置 */
+    list = (READER_SITE **)malloc(sizeof(READER_SITE *) * (reader->site_capacity + 1));
+    if (!list) {
+        return;
+    }
+
+    for (j = 0; j < reader->site_capacity; j++) {
+        if (reader->sites[j].count) {
+            list[count++] = reader->sites + j;
+        }
+    }
+
+    qsort(list, count, sizeof(READER_SITE *), compare_site);
+
+    if (count) {
+        printf("\n%d sites, top %d by bytes:\n", count,
+            count < READER_TOP_SITES ? count : READER_TOP_SITES);
+    }
+
+    for (i = 0; i < count && i < READER_TOP_SITES; i++) {
+        printf("[%d] bytes = %llu count = %llu oldest = %.3fs at %s:%d (%s)\n",
+            i, list[i]->bytes, list[i]->count,
+            reader->now > list[i]->oldest ?
+                (double)(reader->now - list[i]->oldest) / 1e9 : 0.0,
+            list[i]->file, list[i]->line, list[i]->func);
+    }
+
+    free(list);
+}
+
+int compare_site(const void *a, const void *b)
+{
+    const READER_SITE *sa = *(const READER_SITE **)a;
+    const READER_SITE *sb = *(const READER_SITE **)b;
+
+    if (sa->bytes < sb->bytes) {
+        return 1;
+    }
+
+    if (sa->bytes > sb->bytes) {
+        return -1;
+    }
+
+    return 0;
+}
+
+/*===========================================================================*/
@@ -1,13 +1,34 @@
 #ifndef __LINK_H__
 #define __LINK_H__
 
+#include <stddef.h>
+
+#if defined(WIN32)
+#include <windows.h>
+#endif /* WIN32 */
+
 /*===========================================================================*/
-/* 无锁双向链表 */
+/* 侵入式双向链表与无锁栈 */
 /*===========================================================================*/
 
+/*
+ * 链表和栈均不分配内存，节点结构需放在宿主结构的起始位置（即宿主
+ * 结构“继承”自 LINK_NODE 或 LINK_STACK_NODE），全部操作以 static
+ * inline 的方式实现在头文件中，便于编译器内联到分配和释放的热路径。
+ *
+ * 双向链表为环形链表，不是线程安全的，需由调用方加锁；
+ * 无锁栈为 Treiber 栈，可以在多线程下直接使用。
+ */
+
 #define LINK_SUCCESS 0
 #define LINK_FAILED -1
 
+#if defined(_MSC_VER)
+#define LINK_INLINE static __inline
+#else
+#define LINK_INLINE static inline
+#endif /* _MSC_VER */
+
 #ifdef __cplusplus
 extern "C" {
 #endif /* __cplusplus */
@@ -29,37 +50,332 @@ struct link_node_st {
     LINK_NODE *next;
 };
 
+/*-------------------------------------------------------*/
+
+/* 在 target 之前插入节点 */
+#define LINK_INSERT_BEFORE(target, node) \
+    (target)->prev->next = (node); \
+    (node)->prev = (target)->prev; \
+    (node)->next = (target); \
+    (target)->prev = (node);
+
+/* 在 target 之后插入节点 */
+#define LINK_INSERT_AFTER(target, node) \
+    (target)->next->prev = (node); \
+    (node)->prev = (target); \
+    (node)->next = (target)->next; \
+    (target)->next = (node);
+
+/* 移除 target */
+#define LINK_REMOVE(target) \
+    (target)->prev->next = (target)->next; \
+    (target)->next->prev = (target)->prev;
+
+/*-------------------------------------------------------*/
+
 /* 链表还原 */
-void link_reset(LINK *link);
+LINK_INLINE void link_reset(LINK *link)
+{
+    link->head  = NULL;
+    link->tail  = NULL;
+    link->count = 0;
+}
 
-/* 将节点接入尾部 */
-int link_push(LINK *link, LINK_NODE *node);
+/* 将节点接入空链表 */
+LINK_INLINE void link_init_node(LINK *link, LINK_NODE *node)
+{
+    link->head = node;
+    link->tail = node;
+
+    node->next = node;
+    node->prev = node;
+}
+
+/* 将节点接入尾部，O(1) */
+LINK_INLINE int link_push(LINK *link, LINK_NODE *node)
+{
+    if (link->head) {
+        LINK_INSERT_AFTER(link->tail, node);
+        link->tail = node;
+    } else {
+        link_init_node(link, node);
+    }
+
+    link->count++;
+    return LINK_SUCCESS;
+}
+
+/* 将节点接入头部，O(1) */
+LINK_INLINE int link_push_front(LINK *link, LINK_NODE *node)
+{
+    if (link->head) {
+        LINK_INSERT_BEFORE(link->head, node);
+        link->head = node;
+    } else {
+        link_init_node(link, node);
+    }
+
+    link->count++;
+    return LINK_SUCCESS;
+}
 
 /* 按索引插入节点，如 0 则插在第一个，依次类推，查询节点复杂度为 O(n) */
-int link_insert(LINK *link, int index, LINK_NODE *node);
+LINK_INLINE int link_insert(LINK *link, int index, LINK_NODE *node)
+{
+    int i;
+    LINK_NODE *add_node = NULL;
+
+    if (index < 0 || index > link->count) {
+        return LINK_FAILED;
+    }
+
+    if (!index) {
+        return link_push_front(link, node);
+    }
+
+    if (index == link->count) {
+        return link_push(link, node);
+    }
+
+    add_node = link->head;
+
+    /* 先定位到位置，然后插入节点 */
+    for (i = 0; i < index; i++) {
+        add_node = add_node->next;
+    }
+
+    LINK_INSERT_BEFORE(add_node, node);
+
+    link->count++;
+    return LINK_SUCCESS;
+}
 
 /* 在目标节点之前插入节点, target 不能为空 */
-int link_insert_before(LINK *link, LINK_NODE *target, LINK_NODE *node);
+LINK_INLINE int link_insert_before(LINK *link, LINK_NODE *target, LINK_NODE *node)
+{
+    LINK_INSERT_BEFORE(target, node);
+    if (target == link->head) {
+        link->head = node;
+    }
+
+    link->count++;
+    return LINK_SUCCESS;
+}
 
 /* 在目标节点之后插入节点, target 不能为空 */
-int link_insert_after(LINK *link, LINK_NODE *target, LINK_NODE *node);
+LINK_INLINE int link_insert_after(LINK *link, LINK_NODE *target, LINK_NODE *node)
+{
+    LINK_INSERT_AFTER(target, node);
+    if (target == link->tail) {
+        link->tail = node;
+    }
+
+    link->count++;
+    return LINK_SUCCESS;
+}
+
+/*
+ * 强制移除目标节点, 移除成功返回该节点, 移除时不检查节点是否存在，
+ * 算法复杂度为 O(1) ；
+ *
+ * 调用本函数定要万分小心，确保 target 属于 link。
+ */
+LINK_INLINE LINK_NODE *link_remove_force(LINK *link, LINK_NODE *target)
+{
+    if (!link->count) {
+        return NULL;
+    }
+
+    if (link->count == 1) {
+        link->head = NULL;
+        link->tail = NULL;
+    } else {
+        LINK_REMOVE(target);
+
+        if (link->head == target) {
+            link->head = target->next;
+        } else if (link->tail == target) {
+            link->tail = target->prev;
+        }
+    }
+
+    link->count--;
+    return target;
+}
+
+/* 将目标节点移动到头部，O(1)，target 必须属于 link */
+LINK_INLINE void link_move_to_front(LINK *link, LINK_NODE *target)
+{
+    if (link->head == target) {
+        return;
+    }
+
+    link_remove_force(link, target);
+    link_push_front(link, target);
+}
 
 /* 移除尾部节点，同时返回节点地址 */
-LINK_NODE *link_pop(LINK *link);
+LINK_INLINE LINK_NODE *link_pop(LINK *link)
+{
+    return link->tail ? link_remove_force(link, link->tail) : NULL;
+}
 
 /* 根据索引移除节点，查询节点复杂度为 O(n) */
-LINK_NODE *link_remove(LINK *link, int index);
+LINK_INLINE LINK_NODE *link_remove(LINK *link, int index)
+{
+    int i;
+    LINK_NODE *ret = NULL;
 
-/* 移除目标节点, 移除成功返回该节点, 移除时会先查询节点是否存在 */
-LINK_NODE *link_remove_node(LINK *link, LINK_NODE *target);
+    if (index < 0 || index >= link->count) {
+        return NULL;
+    }
 
-/* 
- * 强制移除目标节点, 移除成功返回该节点, 移除时不检查节点是否存在，
- * 算法复杂度为 O(1) ；
+    ret = link->head;
+
+    for (i = 0; i < index; i++) {
+        ret = ret->next;
+    }
+
+    return link_remove_force(link, ret);
+}
+
+/* 移除目标节点, 移除成功返回该节点, 移除时会先查询节点是否存在，O(n) */
+LINK_INLINE LINK_NODE *link_remove_node(LINK *link, LINK_NODE *target)
+{
+    int i;
+    LINK_NODE *node = link->head;
+
+    for (i = 0; i < link->count; i++) {
+        if (node == target) {
+            return link_remove_force(link, target);
+        }
+
+        node = node->next;
+    }
+
+    /* 找不到 target，则不予删除 */
+    return NULL;
+}
+
+/*===========================================================================*/
+
+/*
+ * 无锁栈（Treiber 栈）
  *
- * 调用本函数定要万分小心，确保 target 属于 link。
+ * 栈顶保存在一个 64 位的字中，低位为节点地址，高位为版本号，每次
+ * 出栈都会使版本号加 1，从而避免 ABA 问题：线程 A 读到栈顶 X 和
+ * X->next 之后被挂起，其他线程弹出 X、再压回 X 时，栈顶的版本号
+ * 已经不同，A 的比较交换会失败并重试。
+ *
+ * 64 位平台上用户态地址不超过 48 位，版本号占高 16 位；32 位平台上
+ * 地址和版本号各占 32 位。
+ *
+ * 出栈时会读取栈顶节点的 next，即使该节点已被其他线程弹出，所以节点
+ * 所在的内存在栈的生命周期内必须保持可读（例如来自内存池、不归还给
+ * 系统），这与内存池的空闲链表是一致的。
  */
-LINK_NODE *link_remove_force(LINK *link, LINK_NODE *target);
+
+typedef struct link_stack_node_st LINK_STACK_NODE;
+
+/* 栈节点 */
+struct link_stack_node_st {
+    LINK_STACK_NODE *next;
+};
+
+/* 栈主体结构 */
+typedef struct {
+    volatile unsigned long long top;    /* 栈顶地址与版本号 */
+} LINK_STACK;
+
+#if defined(_WIN64) || defined(__LP64__) || defined(_LP64)
+#define LINK_STACK_ADDR_BITS 48
+#else
+#define LINK_STACK_ADDR_BITS 32
+#endif /* 64 & 32 bit */
+
+#define LINK_STACK_ADDR_MASK ((1ULL << LINK_STACK_ADDR_BITS) - 1)
+
+#define LINK_STACK_ADDR(top) \
+    ((LINK_STACK_NODE *)(size_t)((top) & LINK_STACK_ADDR_MASK))
+
+#define LINK_STACK_TAG(top) ((top) >> LINK_STACK_ADDR_BITS)
+
+#define LINK_STACK_MAKE(node, tag) \
+    (((unsigned long long)(size_t)(node) & LINK_STACK_ADDR_MASK) | \
+     ((unsigned long long)(tag) << LINK_STACK_ADDR_BITS))
+
+/* 原子读取栈顶 */
+LINK_INLINE unsigned long long link_stack_load(volatile unsigned long long *top)
+{
+#if defined(WIN32)
+    return (unsigned long long)InterlockedCompareExchange64((volatile LONGLONG *)top, 0, 0);
+#else /* Linux */
+    return __atomic_load_n(top, __ATOMIC_ACQUIRE);
+#endif /* WIN32 & Linux */
+}
+
+/* 比较交换栈顶，失败时将 old 更新为当前栈顶 */
+LINK_INLINE int link_stack_cas(
+    volatile unsigned long long *top, unsigned long long *old, unsigned long long val)
+{
+#if defined(WIN32)
+    LONGLONG prev = InterlockedCompareExchange64(
+        (volatile LONGLONG *)top, (LONGLONG)val, (LONGLONG)*old);
+
+    if (prev == (LONGLONG)*old) {
+        return 1;
+    }
+
+    *old = (unsigned long long)prev;
+    return 0;
+#else /* Linux */
+    return __atomic_compare_exchange_n(
+        top, old, val, 1, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+#endif /* WIN32 & Linux */
+}
+
+/* 栈还原，不能与其他栈操作并发 */
+LINK_INLINE void link_stack_reset(LINK_STACK *stack)
+{
+    stack->top = 0;
+}
+
+/* 压栈 */
+LINK_INLINE void link_stack_push(LINK_STACK *stack, LINK_STACK_NODE *node)
+{
+    unsigned long long top = link_stack_load(&stack->top);
+    unsigned long long val = 0;
+
+    do {
+        node->next = LINK_STACK_ADDR(top);
+        val = LINK_STACK_MAKE(node, LINK_STACK_TAG(top));
+    } while (!link_stack_cas(&stack->top, &top, val));
+}
+
+/* 出栈，栈为空时返回 NULL */
+LINK_INLINE LINK_STACK_NODE *link_stack_pop(LINK_STACK *stack)
+{
+    unsigned long long top = link_stack_load(&stack->top);
+    unsigned long long val = 0;
+    LINK_STACK_NODE *node = NULL;
+
+    do {
+        node = LINK_STACK_ADDR(top);
+        if (!node) {
+            return NULL;
+        }
+
+        val = LINK_STACK_MAKE(node->next, LINK_STACK_TAG(top) + 1);
+    } while (!link_stack_cas(&stack->top, &top, val));
+
+    return node;
+}
+
+/* 栈是否为空，并发时仅作参考 */
+LINK_INLINE int link_stack_empty(LINK_STACK *stack)
+{
+    return LINK_STACK_ADDR(link_stack_load(&stack->top)) == NULL;
+}
 
 #ifdef __cplusplus
 }
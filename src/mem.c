@@ -3,15 +3,33 @@
 
 #include "mem.h"
 #include "mem_page.h"
+#include "mem_numa.h"
+#include "mem_prof.h"
+#include "mem_site.h"
+#include "mem_report.h"
+#include "mem_dump.h"
+#include "mem_snapshot.h"
+#include "mem_trace.h"
+#include "mem_frag.h"
+#include "mem_guard.h"
+#include "mem_erase.h"
+#include "mem_probe.h"
+#include "mem_lockstat.h"
 
 /*===========================================================================*/
 
 #if defined(WIN32)
+#include <io.h>
 #include <windows.h>
 #else /* Linux */
+#include <unistd.h>
 #include <pthread.h>
 #endif /* WIN32 & Linux */
 
+#if defined(__GLIBC__)
+#include <malloc.h>
+#endif /* __GLIBC__ */
+
 #if defined(WIN32)
 typedef HANDLE MUTEX_HANDLE;
 #else
@@ -63,12 +81,18 @@ static int destroy_mutex(MUTEX_HANDLE *handle)
     return MEM_SUCCESS;
 }
 
+/* 加锁时注明调用路径，用于锁竞争统计，见 mem_lockstat.h */
 #if defined(WIN32)
-#define MEM_LOCK(lock) WaitForSingleObject((lock), INFINITE)
-#define MEM_UNLOCK(lock) ReleaseMutex((lock))
+#define MEM_LOCK(lock, path) \
+    MEM_LOCKSTAT_LOCK((lock), MEM_LOCK_ID_MEM, (path), \
+        WaitForSingleObject((lock), 0) != WAIT_TIMEOUT, \
+        WaitForSingleObject((lock), INFINITE))
+#define MEM_UNLOCK(lock) MEM_LOCKSTAT_UNLOCK(MEM_LOCK_ID_MEM, ReleaseMutex((lock)))
 #else
-#define MEM_LOCK(lock) pthread_mutex_lock(&(lock))
-#define MEM_UNLOCK(lock) pthread_mutex_unlock(&(lock))
+#define MEM_LOCK(lock, path) \
+    MEM_LOCKSTAT_LOCK(&(lock), MEM_LOCK_ID_MEM, (path), \
+        !pthread_mutex_trylock(&(lock)), pthread_mutex_lock(&(lock)))
+#define MEM_UNLOCK(lock) MEM_LOCKSTAT_UNLOCK(MEM_LOCK_ID_MEM, pthread_mutex_unlock(&(lock)))
 #endif
 
 /*===========================================================================*/
@@ -76,6 +100,120 @@ static int destroy_mutex(MUTEX_HANDLE *handle)
 /* 内存互斥锁 */
 static MUTEX_HANDLE mem_lock;
 
+/* 内存压力回调，在锁内设置，在锁内读取后于锁外调用 */
+static MEM_PRESSURE_HANDLER mem_budget_handler = NULL;
+static void *mem_budget_arg = NULL;
+static size_t mem_budget_soft = 0;
+
+/* 越过软限制时在锁外调用内存压力回调 */
+static void budget_notify(size_t used)
+{
+    MEM_PRESSURE_HANDLER handler = NULL;
+    void *arg = NULL;
+    size_t soft_limit = 0;
+
+    MEM_LOCK(mem_lock, MEM_LOCK_PATH_OTHER);
+    handler = mem_budget_handler;
+    arg = mem_budget_arg;
+    soft_limit = mem_budget_soft;
+    MEM_UNLOCK(mem_lock);
+
+    if (handler) {
+        handler(used, soft_limit, arg);
+    }
+}
+
+/* 将转储数据写入文件描述符 */
+static int dump_to_fd(const void *data, size_t len, void *arg)
+{
+    int fd = *(int *)arg;
+    const unsigned char *cursor = (const unsigned char *)data;
+
+#if defined(WIN32)
+    int ret = 0;
+#else /* Linux */
+    ssize_t ret = 0;
+#endif /* WIN32 & Linux */
+
+    while (len > 0) {
+#if defined(WIN32)
+        ret = _write(fd, cursor, (unsigned int)len);
+#else /* Linux */
+        ret = write(fd, cursor, len);
+#endif /* WIN32 & Linux */
+
+        if (ret <= 0) {
+            return MEM_FAILED;
+        }
+
+        cursor += ret;
+        len -= (size_t)ret;
+    }
+
+    return MEM_SUCCESS;
+}
+
+/* 在指定分类中分配内存块，分类中没有可用的内存页时先创建内存页 */
+static unsigned char *alloc_index(int index, size_t len)
+{
+    unsigned char *ret = NULL;
+    size_t used = 0;
+    int crossed = 0;
+
+    MEM_LOCK(mem_lock, MEM_LOCK_PATH_MALLOC);
+
+    /* 获取空闲内存页地址 */
+    if (!usable_page_exist(index)) {
+        /* 新分配一个空闲页，超过硬限制时失败，下面取不到内存块 */
+        mem_page_malloc(index, 0);
+    }
+
+    /* 获取空闲内存块 */
+    ret = alloc_block_index(index, len);
+    crossed = page_budget_crossed(&used);
+
+    MEM_UNLOCK(mem_lock);
+
+    if (crossed) {
+        budget_notify(used);
+    }
+
+    return ret;
+}
+
+/* 保护页分配完成后的记录，保护页分配不参与采样堆分析 */
+static unsigned char *guard_done(unsigned char *ptr, size_t len)
+{
+    if (mem_trace_on) {
+        mem_trace_malloc(ptr, len);
+    }
+
+    MEM_PROBE2(malloc, ptr, len);
+    return ptr;
+}
+
+/* 将保护页内存池中的内存块迁移到普通内存页 */
+static unsigned char *guard_realloc(void *ptr, size_t len)
+{
+    size_t size = mem_guard_len(ptr);
+    unsigned char *ret = alloc_index(get_page_index(len), len);
+
+    if (ret) {
+        memcpy(ret, ptr, size < len ? size : len);
+        mem_guard_free(ptr);
+    }
+
+    return ret;
+}
+
+/* 内存块被采样过则移除采样记录，需在内存块释放之前调用 */
+static void prof_free(void *ptr, int dbg)
+{
+    if (get_addr_block_flag(ptr, dbg) & MEM_BLOCK_FLAG_SAMPLED) {
+        mem_prof_remove(ptr);
+    }
+}
+
 void create_res() 
 {
     create_mutex(&mem_lock);
@@ -83,30 +221,55 @@ void create_res()
 
 void clear_res()
 {
-    MEM_LOCK(mem_lock);
+    mem_pressure_stop();
+    mem_guard_clear();
+    mem_prof_stop();
+    mem_trace_stop();
+
+    MEM_LOCK(mem_lock, MEM_LOCK_PATH_OTHER);
     clear_mem_pages();
+    mem_numa_clear();
+    mem_site_clear();
     MEM_UNLOCK(mem_lock);
 
+    /* 等待擦除线程处理完 clear_mem_pages 释放的大内存 */
+    mem_scrub_stop();
+
     destroy_mutex(&mem_lock);
 }
 
+int mem_enable_numa()
+{
+    int ret = MEM_FAILED;
+
+    MEM_LOCK(mem_lock, MEM_LOCK_PATH_OTHER);
+    ret = page_enable_numa();
+    MEM_UNLOCK(mem_lock);
+
+    return ret;
+}
+
 void *mem_malloc(size_t len)
 {
     unsigned char *ret = NULL;
-    int index = get_page_index(len);
 
-    MEM_LOCK(mem_lock);
+    /* 被采样的分配放在保护页内存池中，见 mem_guard.h */
+    if (MEM_GUARD_SAMPLE() && (ret = mem_guard_alloc(len)) != NULL) {
+        return guard_done(ret, len);
+    }
 
-    /* 获取空闲内存页地址 */
-    if (!usable_page_exist(index)) {
-        /* 新分配一个空闲页 */
-        mem_page_malloc(index, 0);
+    ret = alloc_index(get_page_index(len), len);
+
+    /* 采样记录直接在分配函数中调用，保证调用栈的层数固定 */
+    if (ret && MEM_PROF_SAMPLE(len) && mem_prof_record(ret, len) == MEM_SUCCESS) {
+        set_addr_block_flag(ret, 0, MEM_BLOCK_FLAG_SAMPLED);
     }
 
-    /* 获取空闲内存块 */
-    ret = alloc_block(len);
+    if (ret && mem_trace_on) {
+        mem_trace_malloc(ret, len);
+    }
 
-    MEM_UNLOCK(mem_lock);
+    MEM_PROBE2(malloc, ret, len);
     return ret;
 }
 
@@ -116,19 +279,39 @@ void *mem_realloc(void *ptr, size_t len)
     int index = 0;
     int index_new = 0;
     int dst_size  = 0;
+    int crossed = 0;
+    size_t used = 0;
 
+    unsigned long long trace_id = 0;
     unsigned char *ret = NULL;
 
     if (!ptr) {
         return NULL;
     }
 
+    /* realloc 之前取出轨迹中的对象编号，见 mem_trace.h */
+    if (mem_trace_on) {
+        trace_id = mem_trace_realloc_begin(ptr);
+    }
+
+    /* 保护页内存池中的内存块迁移到普通内存页 */
+    if (MEM_GUARD_OWNS(ptr)) {
+        ret = guard_realloc(ptr, len);
+
+        if (trace_id) {
+            mem_trace_realloc_end(trace_id, ptr, ret, len);
+        }
+
+        MEM_PROBE3(realloc, ptr, ret, len);
+        return ret;
+    }
+
     size = get_addr_block_len(ptr, 0);
     index = get_page_index(size);
     index_new = get_page_index(len);
 
     if (size < (int)len || index > index_new) {
-        MEM_LOCK(mem_lock);
+        MEM_LOCK(mem_lock, MEM_LOCK_PATH_REALLOC);
 
         /* 变更内存页 */
         if (!usable_page_exist(index_new)) {
@@ -137,26 +320,45 @@ void *mem_realloc(void *ptr, size_t len)
         }
 
         /* 获取空闲内存块 */
-        ret = alloc_block(len);
+        ret = alloc_block_index(index_new, len);
         dst_size = (int)((size < (int)len) ? size : len);
 
         if (ret) {
             /* 内存拷贝 */
             memcpy(ret, ptr, dst_size);
 
+            if (mem_prof_rate) {
+                prof_free(ptr, 0);
+            }
+
             /* 释放原始的内存块 */
             free_block(ptr, 0);
         }
 
+        crossed = page_budget_crossed(&used);
+        MEM_UNLOCK(mem_lock);
+
+        if (crossed) {
+            budget_notify(used);
+        }
+
+        if (ret && MEM_PROF_SAMPLE(len) && mem_prof_record(ret, len) == MEM_SUCCESS) {
+            set_addr_block_flag(ret, 0, MEM_BLOCK_FLAG_SAMPLED);
+        }
+    } else if (index == index_new) {
+        ret = (unsigned char *)ptr;
+
+        MEM_LOCK(mem_lock, MEM_LOCK_PATH_REALLOC);
+        set_addr_block_size(ptr, 0, len);
         MEM_UNLOCK(mem_lock);
-        return ret;
     }
 
-    if (index == index_new) {
-        return ptr;
+    if (trace_id) {
+        mem_trace_realloc_end(trace_id, ptr, ret, len);
     }
 
-    return NULL;
+    MEM_PROBE3(realloc, ptr, ret, len);
+    return ret;
 }
 
 void mem_free(void *ptr)
@@ -165,7 +367,26 @@ void mem_free(void *ptr)
         return;
     }
 
-    MEM_LOCK(mem_lock);
+    MEM_PROBE1(free, ptr);
+
+    if (MEM_GUARD_OWNS(ptr)) {
+        if (mem_trace_on) {
+            mem_trace_free(ptr);
+        }
+
+        mem_guard_free(ptr);
+        return;
+    }
+
+    if (mem_prof_rate) {
+        prof_free(ptr, 0);
+    }
+
+    if (mem_trace_on) {
+        mem_trace_free(ptr);
+    }
+
+    MEM_LOCK(mem_lock, MEM_LOCK_PATH_FREE);
     free_block(ptr, 0);
     MEM_UNLOCK(mem_lock);
 }
@@ -174,8 +395,10 @@ void *mem_dbg_malloc(size_t len, const char *func, const char *file, int line)
 {
     unsigned char *ret  = NULL;
     int index = get_page_index(len);
-    
-    MEM_LOCK(mem_lock);
+    int crossed = 0;
+    size_t used = 0;
+
+    MEM_LOCK(mem_lock, MEM_LOCK_PATH_MALLOC);
 
     /* 获取空闲内存页地址 */
     if (!usable_page_exist(index)) {
@@ -185,8 +408,23 @@ void *mem_dbg_malloc(size_t len, const char *func, const char *file, int line)
 
     /* 获取空闲内存块 */
     ret = alloc_block_dbg(len, func, file, line);
+    crossed = page_budget_crossed(&used);
 
     MEM_UNLOCK(mem_lock);
+
+    if (crossed) {
+        budget_notify(used);
+    }
+
+    if (ret && MEM_PROF_SAMPLE(len) && mem_prof_record(ret, len) == MEM_SUCCESS) {
+        set_addr_block_flag(ret, 1, MEM_BLOCK_FLAG_SAMPLED);
+    }
+
+    if (ret && mem_trace_on) {
+        mem_trace_malloc(ret, len);
+    }
+
+    MEM_PROBE2(malloc, ret, len);
     return ret;
 }
 
@@ -196,19 +434,27 @@ void *mem_dbg_realloc(void *ptr, size_t len, const char *func, const char *file,
     int index = 0;
     int index_new = 0;
     int dst_size  = 0;
+    int crossed = 0;
+    size_t used = 0;
 
+    unsigned long long trace_id = 0;
     unsigned char *ret = NULL;
 
     if (!ptr) {
         return NULL;
     }
 
+    /* realloc 之前取出轨迹中的对象编号，见 mem_trace.h */
+    if (mem_trace_on) {
+        trace_id = mem_trace_realloc_begin(ptr);
+    }
+
     size = get_addr_block_len(ptr, 1);
     index = get_page_index(size);
     index_new = get_page_index(len);
 
     if (size < (int)len || index > index_new) {
-        MEM_LOCK(mem_lock);
+        MEM_LOCK(mem_lock, MEM_LOCK_PATH_REALLOC);
 
         /* 变更内存页 */
         if (!usable_page_exist(index_new)) {
@@ -225,19 +471,38 @@ void *mem_dbg_realloc(void *ptr, size_t len, const char *func, const char *file,
             /* 内存拷贝 */
             memcpy(ret, ptr, dst_size);
 
+            if (mem_prof_rate) {
+                prof_free(ptr, 1);
+            }
+
             /* 释放原始的内存块 */
             free_block(ptr, 1);
         }
 
+        crossed = page_budget_crossed(&used);
+        MEM_UNLOCK(mem_lock);
+
+        if (crossed) {
+            budget_notify(used);
+        }
+
+        if (ret && MEM_PROF_SAMPLE(len) && mem_prof_record(ret, len) == MEM_SUCCESS) {
+            set_addr_block_flag(ret, 1, MEM_BLOCK_FLAG_SAMPLED);
+        }
+    } else if (index == index_new) {
+        ret = (unsigned char *)ptr;
+
+        MEM_LOCK(mem_lock, MEM_LOCK_PATH_REALLOC);
+        set_addr_block_size(ptr, 1, len);
         MEM_UNLOCK(mem_lock);
-        return ret;
     }
 
-    if (index == index_new) {
-        return ptr;
+    if (trace_id) {
+        mem_trace_realloc_end(trace_id, ptr, ret, len);
     }
 
-    return NULL;
+    MEM_PROBE3(realloc, ptr, ret, len);
+    return ret;
 }
 
 void *mem_dbg_calloc(size_t num, size_t size, const char *func, const char *file, int line)
@@ -245,8 +510,10 @@ void *mem_dbg_calloc(size_t num, size_t size, const char *func, const char *file
     size_t len = num * size;
     unsigned char *ret = NULL;
     int index = get_page_index(len);
+    int crossed = 0;
+    size_t used = 0;
 
-    MEM_LOCK(mem_lock);
+    MEM_LOCK(mem_lock, MEM_LOCK_PATH_MALLOC);
 
     /* 获取空闲内存页地址 */
     if (!usable_page_exist(index)) {
@@ -256,8 +523,23 @@ void *mem_dbg_calloc(size_t num, size_t size, const char *func, const char *file
 
     /* 获取空闲内存块 */
     ret = alloc_block_dbg(len, func, file, line);
+    crossed = page_budget_crossed(&used);
 
     MEM_UNLOCK(mem_lock);
+
+    if (crossed) {
+        budget_notify(used);
+    }
+
+    if (ret && MEM_PROF_SAMPLE(len) && mem_prof_record(ret, len) == MEM_SUCCESS) {
+        set_addr_block_flag(ret, 1, MEM_BLOCK_FLAG_SAMPLED);
+    }
+
+    if (ret && mem_trace_on) {
+        mem_trace_malloc(ret, len);
+    }
+
+    MEM_PROBE2(malloc, ret, len);
     return ret;
 }
 
@@ -267,59 +549,328 @@ void mem_dbg_free(void *ptr)
         return;
     }
 
-    MEM_LOCK(mem_lock);
+    MEM_PROBE1(free, ptr);
+
+    if (mem_prof_rate) {
+        prof_free(ptr, 1);
+    }
+
+    if (mem_trace_on) {
+        mem_trace_free(ptr);
+    }
+
+    MEM_LOCK(mem_lock, MEM_LOCK_PATH_FREE);
     free_block(ptr, 1);
     MEM_UNLOCK(mem_lock);
 }
 
 void mem_clear(void *ptr, size_t len)
 {
-#ifdef WIN32
-    if (ptr) {
-        SecureZeroMemory(ptr, len);
+    mem_erase(ptr, len);
+}
+
+int mem_budget_set(size_t soft_limit, size_t hard_limit,
+    MEM_PRESSURE_HANDLER handler, void *arg)
+{
+    size_t used = 0;
+    int crossed = 0;
+
+    if (hard_limit && soft_limit > hard_limit) {
+        return MEM_FAILED;
     }
-#else /* Linux */
-    volatile unsigned char *p =
-        (volatile unsigned char *)ptr;
 
-    if (p) {
-        while (len-- > 0) {
-            *p++ = 0;
+    MEM_LOCK(mem_lock, MEM_LOCK_PATH_OTHER);
+
+    mem_budget_handler = handler;
+    mem_budget_arg = arg;
+    mem_budget_soft = soft_limit;
+
+    page_budget_set(soft_limit, hard_limit);
+    crossed = page_budget_crossed(&used);
+
+    MEM_UNLOCK(mem_lock);
+
+    if (crossed) {
+        budget_notify(used);
+    }
+
+    return MEM_SUCCESS;
+}
+
+size_t mem_trim(size_t keep_bytes)
+{
+    size_t ret = 0;
+
+    MEM_LOCK(mem_lock, MEM_LOCK_PATH_OTHER);
+    ret = page_trim(keep_bytes);
+
+    /* NUMA 模式下内存页归还到内存池，仍由分配器持有，只计算归还给系统的部分 */
+    if (mem_numa_enabled()) {
+        ret = mem_numa_trim();
+    }
+
+    MEM_UNLOCK(mem_lock);
+
+#if defined(__GLIBC__)
+    malloc_trim(0);
+#endif /* __GLIBC__ */
+
+    return ret;
+}
+
+size_t mem_budget_used()
+{
+    size_t ret = 0;
+
+    MEM_LOCK(mem_lock, MEM_LOCK_PATH_OTHER);
+    ret = page_budget_used();
+    MEM_UNLOCK(mem_lock);
+
+    return ret;
+}
+
+int mem_class_tune(size_t *sizes, int count)
+{
+    int ret = MEM_FAILED;
+
+    MEM_LOCK(mem_lock, MEM_LOCK_PATH_OTHER);
+    ret = page_class_tune(sizes, count);
+    MEM_UNLOCK(mem_lock);
+
+    return ret;
+}
+
+int mem_class_load(const size_t *sizes, int count)
+{
+    int ret = MEM_FAILED;
+
+    MEM_LOCK(mem_lock, MEM_LOCK_PATH_OTHER);
+    ret = page_class_load(sizes, count);
+    MEM_UNLOCK(mem_lock);
+
+    return ret;
+}
+
+int mem_class_load_str(const char *spec)
+{
+    int count = 0;
+    char *end = NULL;
+    size_t sizes[MEM_CLASS_MAX] = { 0 };
+
+    if (!spec) {
+        return MEM_FAILED;
+    }
+
+    while (*spec) {
+        if (count == MEM_CLASS_MAX) {
+            return MEM_FAILED;
+        }
+
+        sizes[count++] = (size_t)strtoul(spec, &end, 10);
+        if (end == spec || (*end && *end != ',')) {
+            return MEM_FAILED;
         }
+
+        spec = *end ? end + 1 : end;
+    }
+
+    return mem_class_load(sizes, count);
+}
+
+int mem_class_get(size_t *sizes, int count)
+{
+    int ret = 0;
+
+    if (!sizes || count <= 0) {
+        return MEM_FAILED;
+    }
+
+    MEM_LOCK(mem_lock, MEM_LOCK_PATH_OTHER);
+    ret = page_class_get(sizes, count);
+    MEM_UNLOCK(mem_lock);
+
+    return ret;
+}
+
+int mem_stats_get(struct mem_stats *stats)
+{
+    if (!stats) {
+        return MEM_FAILED;
+    }
+
+    MEM_LOCK(mem_lock, MEM_LOCK_PATH_PRINT);
+    page_get_stats(stats);
+    MEM_UNLOCK(mem_lock);
+
+    return MEM_SUCCESS;
+}
+
+int mem_frag_get(struct mem_frag_stats *stats)
+{
+    if (!stats) {
+        return MEM_FAILED;
+    }
+
+    MEM_LOCK(mem_lock, MEM_LOCK_PATH_PRINT);
+    mem_frag_build(stats);
+    MEM_UNLOCK(mem_lock);
+
+    return MEM_SUCCESS;
+}
+
+void mem_print_frag_report()
+{
+    struct mem_frag_stats stats;
+
+    mem_frag_get(&stats);
+    mem_frag_print(&stats);
+}
+
+struct mem_snapshot *mem_snapshot_take()
+{
+    int ret = MEM_FAILED;
+    size_t capacity = 64;
+    struct mem_snapshot *snapshot = NULL;
+
+    /*
+     * 快照的内存在锁外申请，锁内只拷贝计数器；调用位置数量超过预估
+     * 容量时按实际数量重新申请，再次拷贝
+     */
+    for (;;) {
+        snapshot = mem_snapshot_alloc(capacity);
+        if (!snapshot) {
+            return NULL;
+        }
+
+        MEM_LOCK(mem_lock, MEM_LOCK_PATH_PRINT);
+        ret = mem_snapshot_fill(snapshot, capacity);
+        MEM_UNLOCK(mem_lock);
+
+        if (ret == MEM_SUCCESS) {
+            return snapshot;
+        }
+
+        capacity = snapshot->site_count + snapshot->site_count / 4;
+        mem_snapshot_free(snapshot);
     }
-#endif /* WIN32 & Linux */
 }
 
 void mem_print_info()
 {
+    MEM_LOCK(mem_lock, MEM_LOCK_PATH_PRINT);
     page_print_basic_info(0);
+    MEM_UNLOCK(mem_lock);
 }
 
 void mem_dbg_print_info()
 {
+    MEM_LOCK(mem_lock, MEM_LOCK_PATH_PRINT);
     page_print_basic_info(1);
+    MEM_UNLOCK(mem_lock);
 }
 
 void mem_print_block_list(size_t len)
 {
     int index = get_page_index(len);
+
+    MEM_LOCK(mem_lock, MEM_LOCK_PATH_PRINT);
     page_print_block_list(index, 0);
+    MEM_UNLOCK(mem_lock);
 }
 
 void mem_dbg_print_block_list(size_t len)
 {
     int index = get_page_index(len);
+
+    MEM_LOCK(mem_lock, MEM_LOCK_PATH_PRINT);
     page_print_block_list(index, 1);
+    MEM_UNLOCK(mem_lock);
 }
 
 void mem_print_leak_info()
 {
+    MEM_LOCK(mem_lock, MEM_LOCK_PATH_PRINT);
     page_print_allocated_info(0);
+    MEM_UNLOCK(mem_lock);
 }
 
 void mem_dbg_print_leak_info()
 {
+    MEM_LOCK(mem_lock, MEM_LOCK_PATH_PRINT);
     page_print_allocated_info(1);
+    MEM_UNLOCK(mem_lock);
+}
+
+void mem_print_leak_report()
+{
+    MEM_REPORT *report = NULL;
+
+    /* 持锁期间只做一次遍历汇总，排序和打印在锁外进行 */
+    MEM_LOCK(mem_lock, MEM_LOCK_PATH_PRINT);
+    report = mem_report_build();
+    MEM_UNLOCK(mem_lock);
+
+    mem_report_print(report);
+    mem_report_free(report);
+}
+
+int mem_dump(MEM_DUMP_SINK sink, void *arg, int format)
+{
+    int i;
+    int ret = MEM_FAILED;
+    size_t pages = 0;
+    size_t sites = 64;
+    size_t blocks = 0;
+    struct mem_stats stats;
+    MEM_DUMP *dump = NULL;
+
+    if (!sink || (format != MEM_DUMP_JSON && format != MEM_DUMP_BINARY)) {
+        return MEM_FAILED;
+    }
+
+    MEM_LOCK(mem_lock, MEM_LOCK_PATH_PRINT);
+    page_get_stats(&stats);
+    MEM_UNLOCK(mem_lock);
+
+    for (i = 0; i < stats.class_count; i++) {
+        pages  += (size_t)stats.classes[i].page_count;
+        blocks += (size_t)stats.classes[i].live_blocks;
+    }
+
+    /*
+     * 与 mem_snapshot_take 相同，记录的内存在锁外申请，锁内只拷贝
+     * 内存页、调用位置和内存块；数量超过预估容量时按实际数量重新申请，
+     * 再次拷贝。格式化和输出回调都在解锁之后进行
+     */
+    for (;;) {
+        dump = mem_dump_alloc(pages + pages / 4, sites, blocks + blocks / 4);
+        if (!dump) {
+            return MEM_FAILED;
+        }
+
+        MEM_LOCK(mem_lock, MEM_LOCK_PATH_PRINT);
+        ret = mem_dump_fill(dump);
+        MEM_UNLOCK(mem_lock);
+
+        if (ret == MEM_SUCCESS) {
+            break;
+        }
+
+        pages  = dump->page_count;
+        sites  = dump->site_count + dump->site_count / 4;
+        blocks = dump->block_count;
+        mem_dump_free(dump);
+    }
+
+    ret = mem_dump_write(dump, sink, arg, format);
+    mem_dump_free(dump);
+
+    return ret;
+}
+
+int mem_dump_fd(int fd, int format)
+{
+    return mem_dump(dump_to_fd, &fd, format);
 }
 
 /*===========================================================================*/
@@ -25,6 +25,8 @@ extern "C" {
         #define PRINT_MEM_INFO mem_dbg_print_info(0)
         #define PRINT_BLOCK_LIST(len) mem_dbg_print_block_list(0, (len))
         #define PRINT_LEAK_INFO mem_dbg_print_leak_info(0)
+        #define PRINT_LEAK_REPORT mem_print_leak_report()
+        #define PRINT_FRAG_REPORT mem_print_frag_report()
     #else
         #define MEM_MALLOC(len) mem_malloc(len)
         #define MEM_REALLOC(p, len) mem_realloc((p), (len))
@@ -33,6 +35,8 @@ extern "C" {
         #define PRINT_MEM_INFO mem_print_info(0)
         #define PRINT_BLOCK_LIST(len) mem_print_block_list(0, (len))
         #define PRINT_LEAK_INFO mem_print_leak_info(0)
+        #define PRINT_LEAK_REPORT mem_print_leak_report()
+        #define PRINT_FRAG_REPORT mem_print_frag_report()
     #endif /* DEBUG */
 
     #define CLEAR_RES clear_res()
@@ -44,12 +48,166 @@ extern "C" {
     #define PRINT_MEM_INFO
     #define PRINT_BLOCK_LIST
     #define PRINT_LEAK_INFO
+    #define PRINT_LEAK_REPORT
+    #define PRINT_FRAG_REPORT
 
     #define CLEAR_RES
 #endif /* USE_MEMORY */
 
 #define MEM_CLEAR(p, len) mem_clear((p), (len))
-#define MEM_CLEAR_FREE(p, len) (MEM_CLEAR((p), (len)), MEM_FREE((p)))
+#define MEM_CLEAR_FREE(p, len) (MEM_CLEAR((p), (len)), IDLE_MEM_FREE((p)))
+
+/* 内存分类数量，包含 0 内存和大内存两个分类 */
+#define MEM_STATS_CLASS_COUNT 15
+
+/* 可自定义的内存分类数量上限，不含 0 内存和大内存 */
+#define MEM_CLASS_MAX (MEM_STATS_CLASS_COUNT - 2)
+
+/* 单个内存分类的统计信息 */
+struct mem_class_stats {
+    size_t block_size;                  /* 单位内存块尺寸，大内存分类无意义 */
+    unsigned long long alloc_count;     /* 累计分配次数 */
+    unsigned long long free_count;      /* 累计释放次数 */
+    unsigned long long live_blocks;     /* 正在使用的内存块数量 */
+    unsigned long long live_bytes;      /* 正在使用的字节数 */
+    unsigned long long page_count;      /* 内存页数量 */
+    unsigned long long idle_pages;      /* 空闲内存页数量 */
+    unsigned long long large_bytes;     /* 正在使用的大内存字节数 */
+    unsigned long long requested_bytes; /* 正在使用的内存块实际申请的字节数 */
+};
+
+/* 内存统计信息 */
+struct mem_stats {
+    int class_count;                    /* 有效的内存分类数量 */
+    struct mem_class_stats classes[MEM_STATS_CLASS_COUNT];
+};
+
+/* 内存页占用率直方图的区间数量：空闲页，以及 (0, 10%] ~ (90%, 100%] */
+#define MEM_FRAG_OCCUPANCY_BINS 11
+
+/*
+ * 单个内存分类的内存使用效率，system_bytes 按成因拆分为：
+ *
+ * system = requested + rounding + header + partial + idle + page + wrapper
+ */
+struct mem_frag_class {
+    size_t block_size;                  /* 单位内存块尺寸，大内存分类无意义 */
+    unsigned long long requested_bytes; /* 用户申请的字节数 */
+    unsigned long long allocated_bytes; /* 分配给用户的字节数，按分类尺寸向上取整 */
+    unsigned long long system_bytes;    /* 向系统申请的字节数 */
+
+    unsigned long long rounding_bytes;  /* 向上取整到分类尺寸 */
+    unsigned long long header_bytes;    /* 正在使用的内存块头部 */
+    unsigned long long partial_bytes;   /* 部分使用的内存页中的空闲内存块 */
+    unsigned long long idle_bytes;      /* 保留的空闲内存页 */
+    unsigned long long page_bytes;      /* 正在使用的内存页头部 */
+    unsigned long long wrapper_bytes;   /* 0 内存和大内存的包装内存页 */
+
+    unsigned long long page_count;      /* 内存页数量 */
+    unsigned long long occupancy[MEM_FRAG_OCCUPANCY_BINS]; /* 按占用率统计的内存页数量 */
+};
+
+/* 内存使用效率 */
+struct mem_frag_stats {
+    int class_count;                    /* 有效的内存分类数量 */
+    struct mem_frag_class classes[MEM_STATS_CLASS_COUNT];
+    struct mem_frag_class total;        /* 所有分类之和，block_size 无意义 */
+};
+
+/* 单个调用位置的统计信息，只有 DEBUG 模式的内存块带有调用位置 */
+struct mem_site_stats {
+    unsigned int id;                    /* 调用位置编号，从 1 开始 */
+    int line;                           /* 调用 malloc 的行数 */
+    const char *file;                   /* 所属文件，不含目录 */
+    const char *func;                   /* 所属函数 */
+    long long live_blocks;              /* 正在使用的内存块数量，差异中为增量 */
+    long long live_bytes;               /* 正在使用的字节数，差异中为增量 */
+};
+
+/* 堆快照 */
+struct mem_snapshot {
+    unsigned long long time;            /* 快照时刻，单调时钟，单位为纳秒 */
+    struct mem_stats stats;             /* 各内存分类的统计信息 */
+    size_t site_count;                  /* 调用位置数量 */
+    struct mem_site_stats *sites;       /* 调用位置，按编号排列 */
+};
+
+/* 单个内存分类在两次快照之间的增量 */
+struct mem_class_delta {
+    size_t block_size;                  /* 单位内存块尺寸 */
+    long long live_blocks;              /* 内存块数量增量 */
+    long long live_bytes;               /* 字节数增量 */
+    long long page_count;               /* 内存页数量增量 */
+};
+
+/* 两次快照之间的差异 */
+struct mem_snapshot_diff {
+    unsigned long long interval;        /* 两次快照的时间间隔，单位为纳秒 */
+    struct mem_class_delta classes[MEM_STATS_CLASS_COUNT];
+    size_t site_count;                  /* 有变化的调用位置数量 */
+    struct mem_site_stats *sites;       /* 有变化的调用位置，按字节数增量由大到小排列 */
+};
+
+/* 分配器中的锁 */
+#define MEM_LOCK_ID_MEM         0       /* 全局内存锁 */
+#define MEM_LOCK_ID_PROF        1       /* 采样堆分析 */
+#define MEM_LOCK_ID_TRACE       2       /* 分配轨迹记录 */
+#define MEM_LOCK_ID_GUARD       3       /* 保护页内存池 */
+#define MEM_LOCK_ID_SCRUB       4       /* 释放时擦除队列 */
+#define MEM_LOCK_ID_COUNT       5
+
+/* 加锁的调用路径 */
+#define MEM_LOCK_PATH_MALLOC    0
+#define MEM_LOCK_PATH_FREE      1
+#define MEM_LOCK_PATH_REALLOC   2
+#define MEM_LOCK_PATH_PRINT     3       /* 打印、统计、快照与转储 */
+#define MEM_LOCK_PATH_OTHER     4       /* 开关、设置、收缩与后台线程等 */
+#define MEM_LOCK_PATH_COUNT     5
+
+/*
+ * 持锁时长直方图的区间数量：第 0 档小于 2^MEM_LOCK_HOLD_MIN_SHIFT 纳秒，
+ * 第 i 档为 [2^(i+4), 2^(i+5)) 纳秒，最后一档不设上限
+ */
+#define MEM_LOCK_HOLD_BUCKETS   16
+#define MEM_LOCK_HOLD_MIN_SHIFT 5
+
+/* 持锁时长的抽样间隔，每个调用路径每 16 次加锁计时一次，须为 2 的幂 */
+#define MEM_LOCK_HOLD_SAMPLE    16
+
+/* 单把锁在单个调用路径上的竞争统计 */
+struct mem_lock_path_stats {
+    unsigned long long acquired;        /* 获得锁的次数 */
+    unsigned long long contended;       /* 其中需要等待的次数 */
+    unsigned long long wait_ns;         /* 等待的总时长，单位为纳秒 */
+    unsigned long long hold_samples;    /* 抽样计时的持有次数 */
+    unsigned long long hold_ns;         /* 抽样持有的总时长，单位为纳秒 */
+    unsigned long long hold_hist[MEM_LOCK_HOLD_BUCKETS]; /* 抽样持有时长直方图 */
+};
+
+/* 锁竞争统计 */
+struct mem_lock_stats {
+    unsigned long long elapsed;         /* 开启统计或清零以来的时长，单位为纳秒 */
+    struct mem_lock_path_stats locks[MEM_LOCK_ID_COUNT][MEM_LOCK_PATH_COUNT];
+};
+
+/* 堆转储格式，见 mem_dump.h */
+#define MEM_DUMP_JSON   0               /* JSON Lines，每行一条记录 */
+#define MEM_DUMP_BINARY 1               /* 紧凑的二进制格式 */
+
+/*
+ * 堆转储输出回调，返回 0 表示成功；回调在分配器锁外调用，可以在
+ * 回调中申请或释放本分配器的内存，这些变化不会出现在本次转储中
+ */
+typedef int (*MEM_DUMP_SINK)(const void *data, size_t len, void *arg);
+
+/*
+ * 内存压力回调，used 为当前向系统申请的字节数；回调在分配器锁外、由
+ * 越过软限制的那次分配所在的线程调用，可以在回调中释放本分配器的内存
+ */
+typedef void (*MEM_PRESSURE_HANDLER)(size_t used, size_t soft_limit, void *arg);
+
+/* 跨进程共享内存堆句柄，见 mem_shm.h */
+typedef struct mem_shm_st MEM_SHM;
 
 /* 初始化内存资源 */
 void create_res();
@@ -57,6 +215,13 @@ void create_res();
 /* 销毁内存资源 */
 void clear_res();
 
+/*
+ * 开启 NUMA 模式，内存页按节点分池管理，线程从所属节点的内存池中分配；
+ * 需在 create_res 之后、申请内存之前调用，单节点机器上返回 -1 并保持
+ * 普通模式
+ */
+int mem_enable_numa();
+
 /* 通用内存管理函数 */
 void *mem_malloc(size_t len);
 void *mem_realloc(void *ptr, size_t len);
@@ -67,9 +232,240 @@ void *mem_dbg_malloc(size_t len, const char *func, const char *file, int line);
 void *mem_dbg_realloc(void *ptr, size_t len, const char *func, const char *file, int line);
 void  mem_dbg_free(void *ptr);
 
-/* 内存擦除 */
+/*
+ * 安全擦除，不会被编译器优化掉；按 CPU 支持的最宽向量寄存器写零，
+ * 大块内存使用非临时存储，见 mem_erase.h
+ */
 void mem_clear(void *ptr, size_t len);
 
+/*
+ * 获取各个内存分类的统计信息，计数器在分配和释放时增量维护，
+ * 本函数不遍历内存页，复杂度为 O(分类数量)
+ */
+int mem_stats_get(struct mem_stats *stats);
+
+/*
+ * 获取各个内存分类的内存使用效率，给出申请字节数、分配字节数与向系统
+ * 申请的字节数之间的差距及其成因；需要遍历所有内存页，复杂度为
+ * O(内存页数量)
+ */
+int mem_frag_get(struct mem_frag_stats *stats);
+
+/* 打印内存使用效率报告，包括成因拆分和内存页占用率直方图 */
+void mem_print_frag_report();
+
+/*
+ * 设置内存预算，统计的是内存页与大内存数据区向系统申请的字节数，
+ * 在创建和释放时增量维护，0 表示不限制：
+ *
+ * 1.由下向上越过软限制时调用一次 handler，回落到软限制以下后重新计数；
+ * 2.需要向系统申请内存且会超过硬限制的分配直接返回 NULL，realloc 失败
+ * 时原内存块保持不变。
+ *
+ * 硬限制不为 0 时须不小于软限制。
+ */
+int mem_budget_set(size_t soft_limit, size_t hard_limit,
+    MEM_PRESSURE_HANDLER handler, void *arg);
+
+/* 获取当前向系统申请的字节数 */
+size_t mem_budget_used();
+
+/*
+ * 收缩内存，不影响正在使用的内存块：
+ *
+ * 1.释放空闲内存页，直至缓存的空闲内存页不超过 keep_bytes；
+ * 2.NUMA 模式下内存页归还到节点内存池，已切分的内存全部空闲的内存区
+ *   整体归还物理内存并留待复用，其余空闲内存只归还其中完整的系统页；
+ * 3.使用 glibc 时调用 malloc_trim 归还系统堆中的空闲内存。
+ *
+ * 返回离开分配器的字节数：普通模式下为交还给 C 库的内存页字节数，其中
+ * 多少被 C 库归还给系统无法获知；NUMA 模式下为通过 madvise 归还给系统
+ * 的字节数，只计算曾被写入的系统页，同一段内存不会重复计算
+ */
+size_t mem_trim(size_t keep_bytes);
+
+/*
+ * 开始监听内存压力，收到压力通知时调用 mem_trim(keep_bytes)，见
+ * mem_pressure.h；Linux 下 path 为 PSI 压力文件，传 NULL 时使用系统
+ * 级的 /proc/pressure/memory，容器内应传入所在 cgroup 的 memory.pressure；
+ * 内核不支持 PSI 或者没有权限时返回 -1
+ */
+int mem_pressure_start(const char *path, size_t keep_bytes);
+
+/* 停止监听内存压力 */
+void mem_pressure_stop();
+
+/*
+ * 开启释放时擦除：长度不小于 min_len 的大内存在归还给系统之前先擦除，
+ * 见 mem_erase.h；deferred 为 0 时在释放路径上同步擦除，否则交给后台
+ * 擦除线程，释放调用不再承担擦除的耗时。已开启时返回 -1
+ */
+int mem_scrub_start(size_t min_len, int deferred);
+
+/* 停止释放时擦除，等待擦除线程处理完队列中的内存 */
+void mem_scrub_stop();
+
+/*
+ * 开启锁竞争统计，见 mem_lockstat.h：按锁和调用路径记录加锁次数、
+ * 竞争次数、等待总时长和持锁时长直方图；只有发生等待和被抽样的加锁
+ * 才读取时间戳，可以常开。首次开启时需要约 10 毫秒校准时钟，已开启
+ * 时直接返回
+ */
+int mem_lock_stats_start();
+
+/* 停止锁竞争统计，已有的数据保留 */
+void mem_lock_stats_stop();
+
+/* 清零锁竞争统计，可以在统计期间调用 */
+void mem_lock_stats_reset();
+
+/* 获取锁竞争统计，读取时不持锁，各计数器为近似快照 */
+int mem_lock_stats_get(struct mem_lock_stats *stats);
+
+/* 打印锁竞争统计 */
+void mem_print_lock_stats();
+
+/*
+ * 开启采样保护页分配，平均每 rate 次非 dbg 分配中有一次放在独立的
+ * 数据页上，其后紧跟不可访问的保护页，见 mem_guard.h：越界访问和释放
+ * 后使用会立即触发访问错误，并打印内存块分配和释放时的调用栈。
+ *
+ * slots 为保护页内存池的槽位数量，即同时存在的采样内存块的上限，只在
+ * 首次调用时生效；未被采样的分配只多出一次线程局部的减法。只在 Linux
+ * 下支持，其他平台返回 -1
+ */
+int mem_guard_start(size_t rate, int slots);
+
+/* 停止采样，已采样的内存块仍可正常使用和释放 */
+void mem_guard_stop();
+
+/*
+ * 按负载调整内存分类：
+ *
+ * 1.分配器以 8 字节为粒度累计 512 字节以内的申请次数，mem_class_tune
+ * 据此求出内部碎片（分类尺寸与申请尺寸之差的总和）最小的分类表，分类
+ * 数量不超过 count 和 MEM_CLASS_MAX，浪费相同时取数量较少的方案；最大
+ * 分类固定为 512 字节，sizes 按升序输出，返回分类数量，尚无统计时返回 -1；
+ *
+ * 2.将结果保存在服务的配置中，下次启动时在 create_res 之后、申请内存
+ * 之前通过 mem_class_load 加载，已有内存页时返回 -1；
+ *
+ * 3.sizes 须为升序排列、8 的倍数，最后一项为 512；128 字节以内的分类
+ * 使用 1K 内存页，256 字节以内使用 2K 内存页，其余使用 4K 内存页。
+ */
+int mem_class_tune(size_t *sizes, int count);
+int mem_class_load(const size_t *sizes, int count);
+
+/* 从逗号分隔的字符串加载分类表，如 "16,24,40,64,128,256,512" */
+int mem_class_load_str(const char *spec);
+
+/* 获取当前的分类表，返回分类数量 */
+int mem_class_get(size_t *sizes, int count);
+
+/*
+ * 跨进程共享内存堆，与本进程的内存页相互独立，不需要 create_res：
+ *
+ * 1.mem_shm_create 创建 size 字节（按页向上取整）的共享内存区并初始化，
+ * name 不为空时使用 POSIX 共享内存（如 "/worker_heap"，名字已存在时失败），
+ * 其余进程通过 mem_shm_attach(name) 挂接；name 为空时使用匿名的 memfd，
+ * 描述符由 mem_shm_fd 获得，可由子进程继承或经 unix 域套接字传递，
+ * 再通过 mem_shm_attach_fd 挂接；
+ *
+ * 2.区域内的元数据均保存为偏移，各进程的映射地址可以不同；在共享的
+ * 数据结构中保存指针时应转换为偏移（mem_shm_offset / mem_shm_ptr），
+ * 根对象可通过 mem_shm_set_root / mem_shm_get_root 交换；
+ *
+ * 3.任意挂接的进程都可以分配和释放，由区域内的进程共享互斥量保护；
+ * 区域大小在创建后固定，用尽时分配返回 NULL；
+ *
+ * 4.mem_shm_detach 只解除本进程的映射，命名的共享内存需由
+ * mem_shm_unlink 删除，所有进程解除映射后释放。
+ *
+ * 只在 Linux 下支持，其他平台创建和挂接均返回 NULL
+ */
+MEM_SHM *mem_shm_create(const char *name, size_t size);
+MEM_SHM *mem_shm_attach(const char *name);
+MEM_SHM *mem_shm_attach_fd(int fd);
+int   mem_shm_fd(MEM_SHM *shm);
+void  mem_shm_detach(MEM_SHM *shm);
+int   mem_shm_unlink(const char *name);
+
+void *mem_shm_malloc(MEM_SHM *shm, size_t len);
+void  mem_shm_free(MEM_SHM *shm, void *ptr);
+
+/* 指针与偏移的转换，NULL 对应偏移 0 */
+size_t mem_shm_offset(MEM_SHM *shm, const void *ptr);
+void  *mem_shm_ptr(MEM_SHM *shm, size_t offset);
+
+/* 设置和获取根对象 */
+void  mem_shm_set_root(MEM_SHM *shm, void *ptr);
+void *mem_shm_get_root(MEM_SHM *shm);
+
+/* 获取已分配给页段的字节数 */
+size_t mem_shm_used(MEM_SHM *shm);
+
+/*
+ * 持久化堆，共享内存堆的文件模式，用于进程重启后直接沿用上次构建的
+ * 数据结构：
+ *
+ * 1.mem_shm_open_file 打开 path，文件为空或不存在时按 size 创建，否则
+ * 沿用文件的大小、重新映射并保留其中的全部内存块，通过根对象找回数据；
+ * 同一时刻只允许一个进程打开，其余进程打开时返回 NULL；
+ *
+ * 2.正常退出前调用 mem_shm_flush 将全部内容同步到文件并标记为一致；
+ * 未标记为一致的文件（如进程崩溃）再次打开时返回 NULL，需删除后重建；
+ *
+ * 3.mem_shm_flush 之后对内存块内容的直接修改无法被跟踪，应在最后一次
+ * 修改之后调用，然后 mem_shm_detach。
+ */
+MEM_SHM *mem_shm_open_file(const char *path, size_t size);
+int mem_shm_flush(MEM_SHM *shm);
+
+/*
+ * 开启采样堆分析，平均每分配 rate 字节记录一次调用栈，未被采样的
+ * 分配只多出一次线程局部的减法；重复调用会清除已有的采样记录
+ */
+int mem_prof_start(size_t rate);
+
+/* 关闭采样堆分析 */
+void mem_prof_stop();
+
+/* 打印存活的采样调用栈及其估算字节数 */
+void mem_prof_print();
+
+/*
+ * 获取堆快照，包括各内存分类和各调用位置的存活内存；分配器锁只在
+ * 拷贝计数器时持有，复杂度为 O(分类数量 + 调用位置数量)，快照的内存
+ * 在锁外申请，不占用本分配器的内存
+ */
+struct mem_snapshot *mem_snapshot_take();
+
+/* 释放堆快照 */
+void mem_snapshot_free(struct mem_snapshot *snapshot);
+
+/*
+ * 比较两次快照，给出由 older 到 newer 的增长，不需要持有分配器锁；
+ * 两次快照之间调用过 clear_res 时调用位置编号不再可比
+ */
+struct mem_snapshot_diff *mem_snapshot_diff(
+    const struct mem_snapshot *older, const struct mem_snapshot *newer);
+
+/* 打印快照差异 */
+void mem_snapshot_print_diff(const struct mem_snapshot_diff *diff);
+
+/* 释放快照差异 */
+void mem_snapshot_diff_free(struct mem_snapshot_diff *diff);
+
+/*
+ * 开始记录分配轨迹，每次 malloc/free/realloc 以事件的形式写入 path，
+ * 格式见 mem_trace.h；事件先写入线程缓冲区，写满后交给后台写线程整块
+ * 写入文件；重复调用会结束之前的记录
+ */
+int mem_trace_start(const char *path);
+
+/* 结束记录，写出所有线程缓冲区并关闭文件 */
+void mem_trace_stop();
+
 /* 打印内存信息 */
 void mem_print_info();
 void mem_dbg_print_info();
@@ -82,6 +478,24 @@ void mem_dbg_print_block_list(size_t len);
 void mem_print_leak_info();
 void mem_dbg_print_leak_info();
 
+/*
+ * 按调用位置汇总打印正在使用的内存块，给出数量、字节数以及最早和
+ * 最近一次分配距今的时间，按字节数由大到小排列；非 DEBUG 模式下
+ * 按内存分类汇总
+ */
+void mem_print_leak_report();
+
+/*
+ * 以流的形式转储整个堆，包括内存分类、内存页、调用位置和所有正在
+ * 使用的内存块，输出经过缓冲后分批交给 sink；分配器锁只在拷贝记录
+ * 时持有，复杂度为 O(内存页数量 + 内存块数量)，记录的内存向系统申请，
+ * 每个内存块约 48 字节
+ */
+int mem_dump(MEM_DUMP_SINK sink, void *arg, int format);
+
+/* 将堆转储写入文件描述符 */
+int mem_dump_fd(int fd, int format);
+
 #ifdef __cplusplus
 }
 #endif /* __cplusplus */
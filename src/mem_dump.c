@@ -0,0 +1,492 @@
+#if defined(WIN32)
+#define _CRT_SECURE_NO_WARNINGS
+#endif
+
+#include <time.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "mem.h"
+#include "mem_page.h"
+#include "mem_site.h"
+#include "mem_dump.h"
+
+/*===========================================================================*/
+
+#define MEM_DUMP_BUFF_SIZE  8192        /* 输出缓冲区大小 */
+#define MEM_DUMP_LINE_SIZE  1024        /* 单条记录的最大长度 */
+#define MEM_DUMP_NAME_SIZE  256         /* 字符串字段的最大长度 */
+
+/* 带缓冲的转储输出 */
+typedef struct {
+    MEM_DUMP_WRITE write;               /* 输出回调 */
+    void *arg;                          /* 回调参数 */
+    int format;                         /* 转储格式 */
+    int failed;                         /* 输出回调是否失败过 */
+
+    unsigned long long pages;           /* 已输出的内存页数量 */
+    unsigned long long blocks;          /* 已输出的内存块数量 */
+    unsigned long long bytes;           /* 已输出的内存块字节数 */
+    unsigned long long sites;           /* 已输出的调用位置数量 */
+
+    size_t used;                        /* 缓冲区已使用的字节数 */
+    unsigned char buff[MEM_DUMP_BUFF_SIZE];
+} MEM_DUMP_WRITER;
+
+/* 二进制记录 */
+typedef struct {
+    size_t len;
+    unsigned char data[MEM_DUMP_LINE_SIZE];
+} MEM_DUMP_RECORD;
+
+/*===========================================================================*/
+
+/* 遍历回调，拷贝记录 */
+static void collect_page(const MEM_PAGE_STATE *state, void *arg);
+static void collect_site(const MEM_SITE *site, void *arg);
+static void collect_block(const MEM_BLOCK_INFO *info, void *arg);
+
+/* 将缓冲区内容交给输出回调 */
+static void writer_flush(MEM_DUMP_WRITER *writer);
+
+/* 写入一段数据 */
+static void writer_put(MEM_DUMP_WRITER *writer, const void *data, size_t len);
+
+/* 写入一行 JSON */
+static void writer_line(MEM_DUMP_WRITER *writer, const char *format, ...);
+
+/* 写入一条二进制记录 */
+static void writer_record(MEM_DUMP_WRITER *writer, int type, MEM_DUMP_RECORD *rec);
+
+/* 二进制记录字段 */
+static void put_u16(MEM_DUMP_RECORD *rec, unsigned int value);
+static void put_u32(MEM_DUMP_RECORD *rec, unsigned long value);
+static void put_u64(MEM_DUMP_RECORD *rec, unsigned long long value);
+static void put_str(MEM_DUMP_RECORD *rec, const char *str);
+
+/* JSON 字符串转义 */
+static const char *json_escape(const char *str, char *buff, int size);
+
+/* 输出单条记录 */
+static void dump_page(MEM_DUMP_WRITER *writer, const MEM_PAGE_STATE *state);
+static void dump_site(MEM_DUMP_WRITER *writer, const MEM_DUMP_SITE *site);
+static void dump_block(MEM_DUMP_WRITER *writer, const MEM_DUMP_BLOCK *info);
+
+/*===========================================================================*/
+
+MEM_DUMP *mem_dump_alloc(size_t pages, size_t sites, size_t blocks)
+{
+    MEM_DUMP *dump = (MEM_DUMP *)malloc(sizeof(MEM_DUMP));
+
+    if (!dump) {
+        return NULL;
+    }
+
+    memset(dump, 0, sizeof(MEM_DUMP));
+
+    if (pages) {
+        dump->pages = (MEM_PAGE_STATE *)malloc(pages * sizeof(MEM_PAGE_STATE));
+        if (!dump->pages) {
+            mem_dump_free(dump);
+            return NULL;
+        }
+        dump->page_capacity = pages;
+    }
+
+    if (sites) {
+        dump->sites = (MEM_DUMP_SITE *)malloc(sites * sizeof(MEM_DUMP_SITE));
+        if (!dump->sites) {
+            mem_dump_free(dump);
+            return NULL;
+        }
+        dump->site_capacity = sites;
+    }
+
+    if (blocks) {
+        dump->blocks = (MEM_DUMP_BLOCK *)malloc(blocks * sizeof(MEM_DUMP_BLOCK));
+        if (!dump->blocks) {
+            mem_dump_free(dump);
+            return NULL;
+        }
+        dump->block_capacity = blocks;
+    }
+
+    return dump;
+}
+
+int mem_dump_fill(MEM_DUMP *dump)
+{
+    dump->time = (unsigned long long)time(NULL);
+    dump->now = mem_site_now();
+    dump->page_count = 0;
+    dump->site_count = 0;
+    dump->block_count = 0;
+    page_get_stats(&dump->stats);
+
+    page_walk_pages(collect_page, dump);
+    mem_site_walk(collect_site, dump);
+    page_walk_blocks(collect_block, dump);
+
+    if (dump->page_count > dump->page_capacity ||
+        dump->site_count > dump->site_capacity ||
+        dump->block_count > dump->block_capacity) {
+        return MEM_FAILED;
+    }
+
+    return MEM_SUCCESS;
+}
+
+void mem_dump_free(MEM_DUMP *dump)
+{
+    if (dump) {
+        free(dump->pages);
+        free(dump->sites);
+        free(dump->blocks);
+        free(dump);
+    }
+}
+
+int mem_dump_write(const MEM_DUMP *dump, MEM_DUMP_WRITE write, void *arg, int format)
+{
+    int i;
+    size_t j;
+
+    const struct mem_class_stats *info = NULL;
+
+    MEM_DUMP_RECORD rec;
+    MEM_DUMP_WRITER *writer = NULL;
+
+    if (!dump || !write) {
+        return MEM_FAILED;
+    }
+
+    if (format != MEM_DUMP_JSON && format != MEM_DUMP_BINARY) {
+        return MEM_FAILED;
+    }
+
+    /* 缓冲区较大，不放在栈上 */
+    writer = (MEM_DUMP_WRITER *)malloc(sizeof(MEM_DUMP_WRITER));
+    if (!writer) {
+        return MEM_FAILED;
+    }
+
+    memset(writer, 0, sizeof(MEM_DUMP_WRITER) - MEM_DUMP_BUFF_SIZE);
+    writer->write = write;
+    writer->arg = arg;
+    writer->format = format;
+
+    /* 头部 */
+    if (format == MEM_DUMP_JSON) {
+        writer_line(writer,
+            "{\"t\":\"header\",\"version\":%d,\"classes\":%d,\"time\":%llu,\"now\":%llu}\n",
+            MEM_DUMP_VERSION, dump->stats.class_count, dump->time, dump->now);
+    } else {
+        writer_put(writer, MEM_DUMP_MAGIC, MEM_DUMP_MAGIC_SIZE);
+
+        rec.len = 0;
+        put_u32(&rec, MEM_DUMP_VERSION);
+        put_u32(&rec, dump->stats.class_count);
+        put_u64(&rec, dump->time);
+        put_u64(&rec, dump->now);
+        writer_record(writer, MEM_DUMP_REC_HEADER, &rec);
+    }
+
+    /* 内存分类 */
+    for (i = 0; i < dump->stats.class_count; i++) {
+        info = dump->stats.classes + i;
+
+        if (format == MEM_DUMP_JSON) {
+            writer_line(writer,
+                "{\"t\":\"class\",\"index\":%d,\"block_size\":%lu,\"allocs\":%llu,"
+                "\"frees\":%llu,\"live_blocks\":%llu,\"live_bytes\":%llu,"
+                "\"pages\":%llu,\"idle_pages\":%llu,\"large_bytes\":%llu}\n",
+                i, (unsigned long)info->block_size, info->alloc_count,
+                info->free_count, info->live_blocks, info->live_bytes,
+                info->page_count, info->idle_pages, info->large_bytes);
+        } else {
+            rec.len = 0;
+            put_u32(&rec, i);
+            put_u32(&rec, (unsigned long)info->block_size);
+            put_u64(&rec, info->alloc_count);
+            put_u64(&rec, info->free_count);
+            put_u64(&rec, info->live_blocks);
+            put_u64(&rec, info->live_bytes);
+            put_u64(&rec, info->page_count);
+            put_u64(&rec, info->idle_pages);
+            put_u64(&rec, info->large_bytes);
+            writer_record(writer, MEM_DUMP_REC_CLASS, &rec);
+        }
+    }
+
+    for (j = 0; j < dump->page_count; j++) {
+        dump_page(writer, dump->pages + j);
+    }
+
+    for (j = 0; j < dump->site_count; j++) {
+        dump_site(writer, dump->sites + j);
+    }
+
+    for (j = 0; j < dump->block_count; j++) {
+        dump_block(writer, dump->blocks + j);
+    }
+
+    /* 结尾 */
+    if (format == MEM_DUMP_JSON) {
+        writer_line(writer,
+            "{\"t\":\"end\",\"pages\":%llu,\"blocks\":%llu,\"bytes\":%llu,\"sites\":%llu}\n",
+            writer->pages, writer->blocks, writer->bytes, writer->sites);
+    } else {
+        rec.len = 0;
+        put_u64(&rec, writer->pages);
+        put_u64(&rec, writer->blocks);
+        put_u64(&rec, writer->bytes);
+        put_u64(&rec, writer->sites);
+        writer_record(writer, MEM_DUMP_REC_END, &rec);
+    }
+
+    writer_flush(writer);
+
+    i = writer->failed ? MEM_FAILED : MEM_SUCCESS;
+    free(writer);
+
+    return i;
+}
+
+/*===========================================================================*/
+
+void collect_page(const MEM_PAGE_STATE *state, void *arg)
+{
+    MEM_DUMP *dump = (MEM_DUMP *)arg;
+
+    if (dump->page_count < dump->page_capacity) {
+        dump->pages[dump->page_count] = *state;
+    }
+
+    dump->page_count++;
+}
+
+void collect_site(const MEM_SITE *site, void *arg)
+{
+    MEM_DUMP *dump = (MEM_DUMP *)arg;
+    MEM_DUMP_SITE *dst = NULL;
+
+    if (dump->site_count < dump->site_capacity) {
+        dst = dump->sites + dump->site_count;
+        dst->id = site->id;
+        dst->line = site->line;
+        dst->file = site->file;
+        dst->func = site->func;
+    }
+
+    dump->site_count++;
+}
+
+void collect_block(const MEM_BLOCK_INFO *info, void *arg)
+{
+    MEM_DUMP *dump = (MEM_DUMP *)arg;
+    MEM_DUMP_BLOCK *dst = NULL;
+
+    if (dump->block_count < dump->block_capacity) {
+        dst = dump->blocks + dump->block_count;
+        dst->ptr = info->ptr;
+        dst->size = info->size;
+        dst->index = info->index;
+        dst->node = info->node;
+        dst->site = info->site ? info->site->id : 0;
+        dst->time = info->time;
+        dst->thread = info->thread;
+    }
+
+    dump->block_count++;
+}
+
+void writer_flush(MEM_DUMP_WRITER *writer)
+{
+    if (writer->used && !writer->failed) {
+        if (writer->write(writer->buff, writer->used, writer->arg)) {
+            writer->failed = 1;
+        }
+    }
+
+    writer->used = 0;
+}
+
+void writer_put(MEM_DUMP_WRITER *writer, const void *data, size_t len)
+{
+    if (writer->used + len > MEM_DUMP_BUFF_SIZE) {
+        writer_flush(writer);
+    }
+
+    memcpy(writer->buff + writer->used, data, len);
+    writer->used += len;
+}
+
+void writer_line(MEM_DUMP_WRITER *writer, const char *format, ...)
+{
+    int len = 0;
+    va_list args;
+
+    /* 保证缓冲区剩余空间足够容纳一条记录，直接在缓冲区中格式化 */
+    if (writer->used + MEM_DUMP_LINE_SIZE > MEM_DUMP_BUFF_SIZE) {
+        writer_flush(writer);
+    }
+
+    va_start(args, format);
+    len = vsnprintf((char *)writer->buff + writer->used, MEM_DUMP_LINE_SIZE, format, args);
+    va_end(args);
+
+    if (len > 0) {
+        writer->used += (len < MEM_DUMP_LINE_SIZE) ? len : MEM_DUMP_LINE_SIZE - 1;
+    }
+}
+
+void writer_record(MEM_DUMP_WRITER *writer, int type, MEM_DUMP_RECORD *rec)
+{
+    MEM_DUMP_RECORD head;
+
+    head.len = 0;
+    put_u32(&head, type);
+    put_u32(&head, (unsigned long)rec->len);
+
+    writer_put(writer, head.data, head.len);
+    writer_put(writer, rec->data, rec->len);
+}
+
+void put_u16(MEM_DUMP_RECORD *rec, unsigned int value)
+{
+    rec->data[rec->len++] = (unsigned char)(value & 0xFF);
+    rec->data[rec->len++] = (unsigned char)((value >> 8) & 0xFF);
+}
+
+void put_u32(MEM_DUMP_RECORD *rec, unsigned long value)
+{
+    put_u16(rec, (unsigned int)(value & 0xFFFF));
+    put_u16(rec, (unsigned int)((value >> 16) & 0xFFFF));
+}
+
+void put_u64(MEM_DUMP_RECORD *rec, unsigned long long value)
+{
+    put_u32(rec, (unsigned long)(value & 0xFFFFFFFFUL));
+    put_u32(rec, (unsigned long)(value >> 32));
+}
+
+void put_str(MEM_DUMP_RECORD *rec, const char *str)
+{
+    size_t len = str ? strlen(str) : 0;
+
+    if (len > MEM_DUMP_NAME_SIZE) {
+        len = MEM_DUMP_NAME_SIZE;
+    }
+
+    put_u16(rec, (unsigned int)len);
+    memcpy(rec->data + rec->len, str, len);
+    rec->len += len;
+}
+
+const char *json_escape(const char *str, char *buff, int size)
+{
+    int i = 0;
+
+    for (; str && *str && i < size - 7; str++) {
+        if (*str == '"' || *str == '\\') {
+            buff[i++] = '\\';
+            buff[i++] = *str;
+        } else if ((unsigned char)*str < 0x20) {
+            i += sprintf(buff + i, "\\u%04x", (unsigned char)*str);
+        } else {
+            buff[i++] = *str;
+        }
+    }
+
+    buff[i] = '\0';
+    return buff;
+}
+
+void dump_page(MEM_DUMP_WRITER *writer, const MEM_PAGE_STATE *state)
+{
+    MEM_DUMP_RECORD rec;
+
+    writer->pages++;
+
+    if (writer->format == MEM_DUMP_JSON) {
+        writer_line(writer,
+            "{\"t\":\"page\",\"addr\":%llu,\"class\":%d,\"node\":%d,\"type\":%d,"
+            "\"status\":%d,\"using\":%d,\"blocks\":%d,\"block_head\":%d,"
+            "\"block_data\":%d,\"alloc_size\":%d,\"page_size\":%d}\n",
+            (unsigned long long)(size_t)state->addr, state->index, state->node,
+            state->type, state->status, state->using_count, state->block_num,
+            state->block_head, state->block_data, state->alloc_size, state->page_size);
+        return;
+    }
+
+    rec.len = 0;
+    put_u64(&rec, (unsigned long long)(size_t)state->addr);
+    put_u32(&rec, state->index);
+    put_u32(&rec, state->node);
+    put_u32(&rec, state->type);
+    put_u32(&rec, state->status);
+    put_u32(&rec, state->using_count);
+    put_u32(&rec, state->block_num);
+    put_u32(&rec, state->block_head);
+    put_u32(&rec, state->block_data);
+    put_u32(&rec, state->alloc_size);
+    put_u32(&rec, state->page_size);
+    writer_record(writer, MEM_DUMP_REC_PAGE, &rec);
+}
+
+void dump_site(MEM_DUMP_WRITER *writer, const MEM_DUMP_SITE *site)
+{
+    MEM_DUMP_RECORD rec;
+
+    char file[MEM_DUMP_NAME_SIZE];
+    char func[MEM_DUMP_NAME_SIZE];
+
+    writer->sites++;
+
+    if (writer->format == MEM_DUMP_JSON) {
+        writer_line(writer,
+            "{\"t\":\"site\",\"id\":%u,\"line\":%d,\"file\":\"%s\",\"func\":\"%s\"}\n",
+            site->id, site->line,
+            json_escape(site->file, file, MEM_DUMP_NAME_SIZE),
+            json_escape(site->func, func, MEM_DUMP_NAME_SIZE));
+        return;
+    }
+
+    rec.len = 0;
+    put_u32(&rec, site->id);
+    put_u32(&rec, site->line);
+    put_str(&rec, site->file);
+    put_str(&rec, site->func);
+    writer_record(writer, MEM_DUMP_REC_SITE, &rec);
+}
+
+void dump_block(MEM_DUMP_WRITER *writer, const MEM_DUMP_BLOCK *info)
+{
+    MEM_DUMP_RECORD rec;
+
+    writer->blocks++;
+    writer->bytes += info->size;
+
+    if (writer->format == MEM_DUMP_JSON) {
+        writer_line(writer,
+            "{\"t\":\"block\",\"addr\":%llu,\"size\":%llu,\"class\":%d,\"node\":%d,"
+            "\"site\":%u,\"time\":%llu,\"thread\":%llu}\n",
+            (unsigned long long)(size_t)info->ptr, (unsigned long long)info->size,
+            info->index, info->node, info->site, info->time, info->thread);
+        return;
+    }
+
+    rec.len = 0;
+    put_u64(&rec, (unsigned long long)(size_t)info->ptr);
+    put_u64(&rec, (unsigned long long)info->size);
+    put_u32(&rec, info->index);
+    put_u32(&rec, info->node);
+    put_u32(&rec, info->site);
+    put_u64(&rec, info->time);
+    put_u64(&rec, info->thread);
+    writer_record(writer, MEM_DUMP_REC_BLOCK, &rec);
+}
+
+/*===========================================================================*/
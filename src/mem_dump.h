@@ -0,0 +1,106 @@
+#ifndef __MEM_DUMP_H__
+#define __MEM_DUMP_H__
+
+#include <stddef.h>
+
+#include "mem.h"
+#include "mem_page.h"
+
+/*===========================================================================*/
+/* 堆转储 */
+/*===========================================================================*/
+
+/*
+ * 转储由一串记录组成，顺序固定为：
+ *
+ * header -- class * n -- page * n -- site * n -- block * n -- end
+ *
+ * 1.JSON Lines 格式：每行一个 JSON 对象，字段 "t" 为记录类型，
+ * 取值为 header、class、page、site、block、end；
+ *
+ * 2.二进制格式：文件以 8 字节的 MEM_DUMP_MAGIC 开头，之后每条记录为
+ * 4 字节类型 + 4 字节负载长度 + 负载，所有整数均为小端序，负载中
+ * 字段的顺序与 JSON 格式中字段的顺序一致，字符串以 2 字节长度 + 内容
+ * 的形式保存；
+ *
+ * 3.block 记录的 site 字段引用 site 记录的 id，为 0 表示没有调用位置
+ * （非 dbg 模式）；time 字段与 header 中的 now 字段同为单调时钟，两者
+ * 之差即为内存块的存活时间。
+ *
+ * 版本号变化表示记录字段发生了不兼容的变化，新增记录类型不改变版本号，
+ * 读取方应跳过无法识别的记录。
+ */
+
+#define MEM_DUMP_VERSION        1
+#define MEM_DUMP_MAGIC          "MMDUMP\0\0"
+#define MEM_DUMP_MAGIC_SIZE     8
+
+/* 记录类型 */
+#define MEM_DUMP_REC_HEADER     1
+#define MEM_DUMP_REC_CLASS      2
+#define MEM_DUMP_REC_PAGE       3
+#define MEM_DUMP_REC_SITE       4
+#define MEM_DUMP_REC_BLOCK      5
+#define MEM_DUMP_REC_END        6
+
+/* 转储输出回调，见 mem.h - MEM_DUMP_SINK */
+typedef int (*MEM_DUMP_WRITE)(const void *data, size_t len, void *arg);
+
+/* 转储中的调用位置，file 和 func 为调用方传入的常量字符串 */
+typedef struct {
+    unsigned int id;                    /* 调用位置编号 */
+    int line;                           /* 调用 malloc 的行数 */
+    const char *file;                   /* 所属文件，不含目录 */
+    const char *func;                   /* 所属函数 */
+} MEM_DUMP_SITE;
+
+/* 转储中的内存块 */
+typedef struct {
+    const void *ptr;                    /* 用户可用的内存地址 */
+    size_t size;                        /* 申请的字节数 */
+    int index;                          /* 内存分类索引 */
+    int node;                           /* 所属 NUMA 内存池 */
+    unsigned int site;                  /* 调用位置编号，没有时为 0 */
+    unsigned long long time;            /* 分配时刻，见 mem_site_now */
+    unsigned long long thread;          /* 分配线程 */
+} MEM_DUMP_BLOCK;
+
+/*
+ * 锁内拷贝出的堆状态，输出时不需要持有分配器锁；各 count 为实际数量，
+ * 超过对应的 capacity 时只拷贝了前 capacity 条
+ */
+typedef struct {
+    unsigned long long time;            /* 转储时刻，time(NULL) */
+    unsigned long long now;             /* 转储时刻，见 mem_site_now */
+    struct mem_stats stats;             /* 各内存分类的统计信息 */
+
+    size_t page_capacity;
+    size_t page_count;
+    MEM_PAGE_STATE *pages;
+
+    size_t site_capacity;
+    size_t site_count;
+    MEM_DUMP_SITE *sites;
+
+    size_t block_capacity;
+    size_t block_count;
+    MEM_DUMP_BLOCK *blocks;
+} MEM_DUMP;
+
+/* 申请可容纳指定数量记录的空转储，不需要持有分配器锁 */
+MEM_DUMP *mem_dump_alloc(size_t pages, size_t sites, size_t blocks);
+
+/*
+ * 拷贝内存分类、内存页、调用位置和内存块，调用方需持有分配器锁；
+ * 任一记录数量超过容量时返回 -1，并在对应的 count 中给出所需容量
+ */
+int mem_dump_fill(MEM_DUMP *dump);
+
+/* 将拷贝出的堆状态写入输出回调，不需要持有分配器锁 */
+int mem_dump_write(const MEM_DUMP *dump, MEM_DUMP_WRITE write, void *arg, int format);
+
+void mem_dump_free(MEM_DUMP *dump);
+
+/*===========================================================================*/
+
+#endif /* __MEM_DUMP_H__ */
@@ -0,0 +1,450 @@
+#if defined(WIN32)
+#define _CRT_SECURE_NO_WARNINGS
+#else
+#define _GNU_SOURCE
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "mem.h"
+#include "link.h"
+#include "mem_page.h"
+#include "mem_lockstat.h"
+#include "mem_erase.h"
+
+/*===========================================================================*/
+
+#if defined(WIN32)
+#include <windows.h>
+typedef SRWLOCK SCRUB_LOCK_HANDLE;
+typedef CONDITION_VARIABLE SCRUB_COND_HANDLE;
+#define SCRUB_LOCK_INITIALIZER SRWLOCK_INIT
+#define SCRUB_COND_INITIALIZER CONDITION_VARIABLE_INIT
+#define SCRUB_LOCK(lock, path) \
+    MEM_LOCKSTAT_LOCK(&(lock), MEM_LOCK_ID_SCRUB, (path), \
+        TryAcquireSRWLockExclusive(&(lock)), AcquireSRWLockExclusive(&(lock)))
+#define SCRUB_UNLOCK(lock) MEM_LOCKSTAT_UNLOCK(MEM_LOCK_ID_SCRUB, ReleaseSRWLockExclusive(&(lock)))
+#define SCRUB_WAIT(cond, lock) \
+    do { \
+        SCRUB_WAIT_RELEASE(); \
+        SleepConditionVariableSRW(&(cond), &(lock), INFINITE, 0); \
+        SCRUB_WAIT_ACQUIRED(); \
+    } while (0)
+#define SCRUB_SIGNAL(cond) WakeConditionVariable(&(cond))
+#else /* Linux */
+#include <pthread.h>
+typedef pthread_mutex_t SCRUB_LOCK_HANDLE;
+typedef pthread_cond_t SCRUB_COND_HANDLE;
+#define SCRUB_LOCK_INITIALIZER PTHREAD_MUTEX_INITIALIZER
+#define SCRUB_COND_INITIALIZER PTHREAD_COND_INITIALIZER
+#define SCRUB_LOCK(lock, path) \
+    MEM_LOCKSTAT_LOCK(&(lock), MEM_LOCK_ID_SCRUB, (path), \
+        !pthread_mutex_trylock(&(lock)), pthread_mutex_lock(&(lock)))
+#define SCRUB_UNLOCK(lock) MEM_LOCKSTAT_UNLOCK(MEM_LOCK_ID_SCRUB, pthread_mutex_unlock(&(lock)))
+#define SCRUB_WAIT(cond, lock) \
+    do { \
+        SCRUB_WAIT_RELEASE(); \
+        pthread_cond_wait(&(cond), &(lock)); \
+        SCRUB_WAIT_ACQUIRED(); \
+    } while (0)
+#define SCRUB_SIGNAL(cond) pthread_cond_signal(&(cond))
+#endif /* WIN32 & Linux */
+
+/* 条件变量等待期间锁被释放，等待前后分别计入锁竞争统计 */
+#define SCRUB_WAIT_RELEASE() \
+    do { \
+        if (mem_lockstat_on) { \
+            mem_lockstat_release(MEM_LOCK_ID_SCRUB); \
+        } \
+    } while (0)
+#define SCRUB_WAIT_ACQUIRED() \
+    do { \
+        if (mem_lockstat_on) { \
+            mem_lockstat_acquired(MEM_LOCK_ID_SCRUB, MEM_LOCK_PATH_OTHER, 0); \
+        } \
+    } while (0)
+
+/* GCC/Clang 下的 x86 平台可以按函数指定指令集并在运行时检测 */
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define ERASE_X86 1
+#include <immintrin.h>
+#else
+#define ERASE_X86 0
+#endif /* __GNUC__ && x86 */
+
+/* 编译器内存屏障：声明 ptr 指向的内存可能被读取，之前的写入不能消除 */
+#if defined(__GNUC__)
+#define ERASE_BARRIER(ptr) __asm__ __volatile__("" : : "r"(ptr) : "memory")
+#else
+#define ERASE_BARRIER(ptr) ((void)(ptr))
+#endif /* __GNUC__ */
+
+/*===========================================================================*/
+
+/* 擦除实现 */
+typedef void (*ERASE_FUNC)(void *ptr, size_t len);
+
+/* 擦除队列中的大内存，占用被擦除内存的开头 */
+typedef struct {
+    LINK_NODE node;
+    size_t len;                 /* 整段内存的字节数 */
+} SCRUB_ITEM;
+
+/*===========================================================================*/
+
+/* 按机器字写零，不依赖指令集 */
+static void erase_word(void *ptr, size_t len);
+
+#if ERASE_X86
+static void erase_sse2(void *ptr, size_t len) __attribute__((target("sse2")));
+static void erase_avx2(void *ptr, size_t len) __attribute__((target("avx2")));
+static void erase_avx512(void *ptr, size_t len) __attribute__((target("avx512f")));
+#endif /* ERASE_X86 */
+
+/* 首次擦除时选择实现 */
+static void erase_resolve(void *ptr, size_t len);
+
+/* 擦除线程，逐个擦除并释放队列中的大内存 */
+#if defined(WIN32)
+static DWORD WINAPI scrub_run(LPVOID arg);
+#else /* Linux */
+static void *scrub_run(void *arg);
+#endif /* WIN32 & Linux */
+
+/*===========================================================================*/
+
+size_t mem_scrub_min = 0;
+
+static ERASE_FUNC volatile erase_impl = erase_resolve;
+static const char *volatile erase_impl_name = NULL;
+
+static SCRUB_LOCK_HANDLE scrub_lock = SCRUB_LOCK_INITIALIZER;
+static SCRUB_COND_HANDLE scrub_cond = SCRUB_COND_INITIALIZER;
+
+static LINK scrub_queue;                /* 待擦除的大内存 */
+static size_t scrub_pending = 0;        /* 已入队但尚未擦除完的字节数 */
+static int scrub_deferred = 0;          /* 擦除线程是否在运行 */
+static int scrub_stopping = 0;          /* 通知擦除线程清空队列后退出 */
+
+#if defined(WIN32)
+static HANDLE scrub_thread = NULL;
+#else /* Linux */
+static pthread_t scrub_thread;
+#endif /* WIN32 & Linux */
+
+/*===========================================================================*/
+
+void mem_erase(void *ptr, size_t len)
+{
+    if (!ptr || !len) {
+        return;
+    }
+
+    erase_impl(ptr, len);
+    ERASE_BARRIER(ptr);
+}
+
+const char *mem_erase_name()
+{
+    if (!erase_impl_name) {
+        erase_resolve(NULL, 0);
+    }
+
+    return erase_impl_name;
+}
+
+int mem_scrub_start(size_t min_len, int deferred)
+{
+    int ret = MEM_SUCCESS;
+
+    /* 整段内存的开头要能放下队列节点 */
+    if (min_len < sizeof(SCRUB_ITEM)) {
+        min_len = sizeof(SCRUB_ITEM);
+    }
+
+    SCRUB_LOCK(scrub_lock, MEM_LOCK_PATH_OTHER);
+
+    if (mem_scrub_min) {
+        SCRUB_UNLOCK(scrub_lock);
+        return MEM_FAILED;
+    }
+
+    if (deferred) {
+        link_reset(&scrub_queue);
+        scrub_pending  = 0;
+        scrub_stopping = 0;
+
+#if defined(WIN32)
+        scrub_thread = CreateThread(NULL, 0, scrub_run, NULL, 0, NULL);
+        ret = scrub_thread ? MEM_SUCCESS : MEM_FAILED;
+#else /* Linux */
+        ret = pthread_create(&scrub_thread, NULL, scrub_run, NULL) ? MEM_FAILED : MEM_SUCCESS;
+#endif /* WIN32 & Linux */
+    }
+
+    if (ret == MEM_SUCCESS) {
+        scrub_deferred = deferred ? 1 : 0;
+        mem_scrub_min  = min_len;
+    }
+
+    SCRUB_UNLOCK(scrub_lock);
+
+    return ret;
+}
+
+void mem_scrub_stop()
+{
+    int deferred = 0;
+
+    SCRUB_LOCK(scrub_lock, MEM_LOCK_PATH_OTHER);
+
+    deferred = scrub_deferred;
+    mem_scrub_min  = 0;
+    scrub_deferred = 0;
+
+    if (deferred) {
+        scrub_stopping = 1;
+        SCRUB_SIGNAL(scrub_cond);
+    }
+
+    SCRUB_UNLOCK(scrub_lock);
+
+    if (!deferred) {
+        return;
+    }
+
+    /* 擦除线程清空队列后才退出 */
+#if defined(WIN32)
+    WaitForSingleObject(scrub_thread, INFINITE);
+    CloseHandle(scrub_thread);
+    scrub_thread = NULL;
+#else /* Linux */
+    pthread_join(scrub_thread, NULL);
+#endif /* WIN32 & Linux */
+}
+
+void mem_scrub_free(void *ptr, size_t len)
+{
+    SCRUB_ITEM *item = (SCRUB_ITEM *)ptr;
+
+    if (!mem_scrub_min || len < mem_scrub_min) {
+        free(ptr);
+        return;
+    }
+
+    SCRUB_LOCK(scrub_lock, MEM_LOCK_PATH_FREE);
+
+    /* 开关可能在读取 mem_scrub_min 之后被修改，持锁后重新判断 */
+    if (scrub_deferred && scrub_pending + len <= MEM_SCRUB_MAX_PENDING) {
+        item->len = len;
+        link_push(&scrub_queue, &item->node);
+        scrub_pending += len;
+
+        SCRUB_SIGNAL(scrub_cond);
+        SCRUB_UNLOCK(scrub_lock);
+        return;
+    }
+
+    SCRUB_UNLOCK(scrub_lock);
+
+    /* 同步模式或者队列积压过多时，在释放路径上直接擦除 */
+    mem_erase(ptr, len);
+    free(ptr);
+}
+
+/*===========================================================================*/
+
+void erase_word(void *ptr, size_t len)
+{
+#if defined(WIN32)
+    SecureZeroMemory(ptr, len);
+#else
+    volatile unsigned char *p = (volatile unsigned char *)ptr;
+
+    while (len && ((size_t)p & (sizeof(size_t) - 1))) {
+        *p++ = 0;
+        len--;
+    }
+
+    for (; len >= sizeof(size_t); p += sizeof(size_t), len -= sizeof(size_t)) {
+        *(volatile size_t *)p = 0;
+    }
+
+    while (len--) {
+        *p++ = 0;
+    }
+#endif /* WIN32 */
+}
+
+#if ERASE_X86
+void erase_sse2(void *ptr, size_t len)
+{
+    unsigned char *p = (unsigned char *)ptr;
+    __m128i zero = _mm_setzero_si128();
+
+    /* 首部逐字节写到 16 字节对齐 */
+    while (len && ((size_t)p & 15)) {
+        *p++ = 0;
+        len--;
+    }
+
+    if (len >= MEM_ERASE_STREAM_SIZE) {
+        for (; len >= 64; p += 64, len -= 64) {
+            _mm_stream_si128((__m128i *)p, zero);
+            _mm_stream_si128((__m128i *)(p + 16), zero);
+            _mm_stream_si128((__m128i *)(p + 32), zero);
+            _mm_stream_si128((__m128i *)(p + 48), zero);
+        }
+
+        /* 非临时存储是弱序的，之后的释放不能越过这些写入 */
+        _mm_sfence();
+    }
+
+    for (; len >= 16; p += 16, len -= 16) {
+        _mm_store_si128((__m128i *)p, zero);
+    }
+
+    while (len--) {
+        *p++ = 0;
+    }
+}
+
+void erase_avx2(void *ptr, size_t len)
+{
+    unsigned char *p = (unsigned char *)ptr;
+    __m256i zero = _mm256_setzero_si256();
+
+    while (len && ((size_t)p & 31)) {
+        *p++ = 0;
+        len--;
+    }
+
+    if (len >= MEM_ERASE_STREAM_SIZE) {
+        for (; len >= 128; p += 128, len -= 128) {
+            _mm256_stream_si256((__m256i *)p, zero);
+            _mm256_stream_si256((__m256i *)(p + 32), zero);
+            _mm256_stream_si256((__m256i *)(p + 64), zero);
+            _mm256_stream_si256((__m256i *)(p + 96), zero);
+        }
+
+        _mm_sfence();
+    }
+
+    for (; len >= 32; p += 32, len -= 32) {
+        _mm256_store_si256((__m256i *)p, zero);
+    }
+
+    /* 避免之后的 SSE 代码付出状态切换的代价 */
+    _mm256_zeroupper();
+
+    while (len--) {
+        *p++ = 0;
+    }
+}
+
+void erase_avx512(void *ptr, size_t len)
+{
+    unsigned char *p = (unsigned char *)ptr;
+    __m512i zero = _mm512_setzero_si512();
+
+    while (len && ((size_t)p & 63)) {
+        *p++ = 0;
+        len--;
+    }
+
+    if (len >= MEM_ERASE_STREAM_SIZE) {
+        for (; len >= 256; p += 256, len -= 256) {
+            _mm512_stream_si512((void *)p, zero);
+            _mm512_stream_si512((void *)(p + 64), zero);
+            _mm512_stream_si512((void *)(p + 128), zero);
+            _mm512_stream_si512((void *)(p + 192), zero);
+        }
+
+        _mm_sfence();
+    }
+
+    for (; len >= 64; p += 64, len -= 64) {
+        _mm512_store_si512((void *)p, zero);
+    }
+
+    _mm256_zeroupper();
+
+    while (len--) {
+        *p++ = 0;
+    }
+}
+#endif /* ERASE_X86 */
+
+void erase_resolve(void *ptr, size_t len)
+{
+    ERASE_FUNC impl = erase_word;
+    const char *name = "word";
+
+#if ERASE_X86
+    __builtin_cpu_init();
+
+    if (__builtin_cpu_supports("avx512f")) {
+        impl = erase_avx512;
+        name = "avx512";
+    } else if (__builtin_cpu_supports("avx2")) {
+        impl = erase_avx2;
+        name = "avx2";
+    } else if (__builtin_cpu_supports("sse2")) {
+        impl = erase_sse2;
+        name = "sse2";
+    }
+#endif /* ERASE_X86 */
+
+    /* 多个线程同时选择时结果相同，无需加锁 */
+    erase_impl_name = name;
+    erase_impl = impl;
+
+    if (ptr) {
+        impl(ptr, len);
+    }
+}
+
+#if defined(WIN32)
+DWORD WINAPI scrub_run(LPVOID arg)
+#else /* Linux */
+void *scrub_run(void *arg)
+#endif /* WIN32 & Linux */
+{
+    SCRUB_ITEM *item = NULL;
+    size_t len = 0;
+
+    (void)arg;
+
+    SCRUB_LOCK(scrub_lock, MEM_LOCK_PATH_OTHER);
+
+    for (;;) {
+        while (!scrub_queue.count && !scrub_stopping) {
+            SCRUB_WAIT(scrub_cond, scrub_lock);
+        }
+
+        if (!scrub_queue.count) {
+            break;
+        }
+
+        /* 先入队的先擦除 */
+        item = (SCRUB_ITEM *)link_remove_force(&scrub_queue, scrub_queue.head);
+        len  = item->len;
+
+        SCRUB_UNLOCK(scrub_lock);
+
+        mem_erase(item, len);
+        free(item);
+
+        SCRUB_LOCK(scrub_lock, MEM_LOCK_PATH_OTHER);
+        scrub_pending -= len;
+    }
+
+    SCRUB_UNLOCK(scrub_lock);
+
+#if defined(WIN32)
+    return 0;
+#else /* Linux */
+    return NULL;
+#endif /* WIN32 & Linux */
+}
@@ -0,0 +1,41 @@
+#ifndef __MEM_ERASE_H__
+#define __MEM_ERASE_H__
+
+#include <stddef.h>
+
+/*===========================================================================*/
+/* 安全擦除 */
+/*===========================================================================*/
+
+/*
+ * 1.擦除按 CPU 支持的最宽向量寄存器写零，x86 下首次调用时通过 cpuid 在
+ * AVX-512、AVX2 与 SSE2 之间选择实现，其余平台按机器字写零；擦除结束后
+ * 以编译器内存屏障声明内存已被读取，避免编译器把即将释放的内存的写入
+ * 当作死存储消除；
+ *
+ * 2.长度不小于 MEM_ERASE_STREAM_SIZE 时使用非临时存储，写入绕过缓存，
+ * 擦除大块内存不会把热数据挤出缓存；
+ *
+ * 3.释放时擦除（scrub）只作用于大内存，小内存在释放时已经覆写：同步模式
+ * 在释放路径上直接擦除；延迟模式把大内存挂到擦除队列，由后台线程擦除
+ * 后再归还给系统，队列积压超过 MEM_SCRUB_MAX_PENDING 时退化为同步擦除。
+ */
+
+#define MEM_ERASE_STREAM_SIZE   (256 * 1024)    /* 使用非临时存储的最小长度 */
+#define MEM_SCRUB_MAX_PENDING   (64 << 20)      /* 擦除队列积压的字节数上限 */
+
+/* 释放时擦除的最小长度，为 0 时表示未开启 */
+extern size_t mem_scrub_min;
+
+/* 擦除 len 字节，不会被编译器优化掉 */
+void mem_erase(void *ptr, size_t len);
+
+/* 当前使用的擦除实现名称 */
+const char *mem_erase_name();
+
+/* 归还大内存的整段内存，开启释放时擦除且长度达到阈值时先擦除 */
+void mem_scrub_free(void *ptr, size_t len);
+
+/*===========================================================================*/
+
+#endif /* __MEM_ERASE_H__ */
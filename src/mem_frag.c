@@ -0,0 +1,194 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "mem.h"
+#include "mem_page.h"
+#include "mem_frag.h"
+
+/*===========================================================================*/
+
+#define MEM_FRAG_LARGE_INDEX (MEM_STATS_CLASS_COUNT - 1)
+
+/*===========================================================================*/
+
+/* 遍历回调，按内存页累计各项开销 */
+static void frag_visit(const MEM_PAGE_STATE *state, void *arg);
+
+/* 将一个分类累加到总计 */
+static void frag_add(struct mem_frag_class *total, const struct mem_frag_class *info);
+
+/* 输出占总量的百分比 */
+static double frag_percent(unsigned long long part, unsigned long long total);
+
+/*===========================================================================*/
+
+void mem_frag_build(struct mem_frag_stats *stats)
+{
+    int i;
+    struct mem_stats page_stats;
+    struct mem_frag_class *info = NULL;
+
+    memset(stats, 0, sizeof(struct mem_frag_stats));
+    stats->class_count = MEM_STATS_CLASS_COUNT;
+
+    page_get_stats(&page_stats);
+    page_walk_pages(frag_visit, stats);
+
+    for (i = 0; i < MEM_STATS_CLASS_COUNT; i++) {
+        info = stats->classes + i;
+
+        info->block_size      = page_stats.classes[i].block_size;
+        info->requested_bytes = page_stats.classes[i].requested_bytes;
+
+        /* 大内存按申请尺寸分配，没有取整 */
+        if (info->allocated_bytes > info->requested_bytes) {
+            info->rounding_bytes = info->allocated_bytes - info->requested_bytes;
+        }
+
+        frag_add(&stats->total, info);
+    }
+}
+
+void mem_frag_print(const struct mem_frag_stats *stats)
+{
+    int i;
+    int j;
+    const struct mem_frag_class *info = NULL;
+
+    if (!stats) {
+        return;
+    }
+
+    info = &stats->total;
+
+    printf("<=========================fragmentation report=======================>\n");
+    printf("requested = %llu, allocated = %llu, system = %llu, efficiency = %.1f%%\n",
+        info->requested_bytes, info->allocated_bytes, info->system_bytes,
+        frag_percent(info->requested_bytes, info->system_bytes));
+    printf("overhead: rounding = %llu (%.1f%%), header = %llu (%.1f%%), "
+        "partial = %llu (%.1f%%)\n",
+        info->rounding_bytes, frag_percent(info->rounding_bytes, info->system_bytes),
+        info->header_bytes, frag_percent(info->header_bytes, info->system_bytes),
+        info->partial_bytes, frag_percent(info->partial_bytes, info->system_bytes));
+    printf("          idle = %llu (%.1f%%), page = %llu (%.1f%%), wrapper = %llu (%.1f%%)\n",
+        info->idle_bytes, frag_percent(info->idle_bytes, info->system_bytes),
+        info->page_bytes, frag_percent(info->page_bytes, info->system_bytes),
+        info->wrapper_bytes, frag_percent(info->wrapper_bytes, info->system_bytes));
+
+    printf("\nlink  size   requested   allocated      system  effic"
+        "    rounding      header     partial        idle  page+wrap\n");
+
+    for (i = 0; i < stats->class_count; i++) {
+        info = stats->classes + i;
+
+        if (!info->system_bytes) {
+            continue;
+        }
+
+        printf("%02d  %6lu  %10llu  %10llu  %10llu  %4.1f%%  %10llu  %10llu  %10llu  %10llu  %9llu\n",
+            i, (unsigned long)info->block_size, info->requested_bytes,
+            info->allocated_bytes, info->system_bytes,
+            frag_percent(info->requested_bytes, info->system_bytes),
+            info->rounding_bytes, info->header_bytes, info->partial_bytes,
+            info->idle_bytes, info->page_bytes + info->wrapper_bytes);
+    }
+
+    /* 内存页占用率直方图，0 列为空闲页 */
+    printf("\nlink  pages  occupancy: idle  <=10%% <=20%% <=30%% <=40%% <=50%%"
+        " <=60%% <=70%% <=80%% <=90%% <=100%%\n");
+
+    for (i = 1; i < MEM_FRAG_LARGE_INDEX; i++) {
+        info = stats->classes + i;
+
+        if (!info->page_count) {
+            continue;
+        }
+
+        printf("%02d  %7llu            ", i, info->page_count);
+
+        for (j = 0; j < MEM_FRAG_OCCUPANCY_BINS; j++) {
+            printf(" %5llu", info->occupancy[j]);
+        }
+
+        printf("\n");
+    }
+
+    printf("<=========================fragmentation report=======================>\n");
+}
+
+/*===========================================================================*/
+
+void frag_visit(const MEM_PAGE_STATE *state, void *arg)
+{
+    int bin = 0;
+    unsigned long long slot = 0;
+    unsigned long long used = 0;
+
+    struct mem_frag_stats *stats = (struct mem_frag_stats *)arg;
+    struct mem_frag_class *info = NULL;
+
+    if (state->index < 0 || state->index >= MEM_STATS_CLASS_COUNT) {
+        return;
+    }
+
+    info = stats->classes + state->index;
+    slot = (unsigned long long)(state->block_head + state->block_data);
+    used = (unsigned long long)state->using_count;
+
+    info->page_count++;
+    info->system_bytes += state->page_size;
+
+    /* 空闲页不论类型整页计入保留开销 */
+    if (!state->using_count) {
+        info->idle_bytes += state->page_size;
+        info->occupancy[0]++;
+        return;
+    }
+
+    /*
+     * 0 内存和大内存：内存页只是包装，实际数据单独申请，其大小为
+     * 总申请大小减去页内内存块，包含一个内存块头部
+     */
+    if (state->index == 0 || state->index == MEM_FRAG_LARGE_INDEX) {
+        info->wrapper_bytes   += state->page_size;
+        info->system_bytes    += state->alloc_size - slot;
+        info->allocated_bytes += state->alloc_size - slot - state->block_head;
+        info->header_bytes    += state->block_head;
+        return;
+    }
+
+    bin = (int)((used * 10 + state->block_num - 1) / state->block_num);
+    info->occupancy[bin]++;
+
+    info->allocated_bytes += used * state->block_data;
+    info->header_bytes    += used * state->block_head;
+    info->partial_bytes   += (state->block_num - used) * slot;
+    info->page_bytes      += state->page_size - state->block_num * slot;
+}
+
+void frag_add(struct mem_frag_class *total, const struct mem_frag_class *info)
+{
+    int i;
+
+    total->requested_bytes += info->requested_bytes;
+    total->allocated_bytes += info->allocated_bytes;
+    total->system_bytes    += info->system_bytes;
+    total->rounding_bytes  += info->rounding_bytes;
+    total->header_bytes    += info->header_bytes;
+    total->partial_bytes   += info->partial_bytes;
+    total->idle_bytes      += info->idle_bytes;
+    total->page_bytes      += info->page_bytes;
+    total->wrapper_bytes   += info->wrapper_bytes;
+    total->page_count      += info->page_count;
+
+    for (i = 0; i < MEM_FRAG_OCCUPANCY_BINS; i++) {
+        total->occupancy[i] += info->occupancy[i];
+    }
+}
+
+double frag_percent(unsigned long long part, unsigned long long total)
+{
+    return total ? (double)part * 100.0 / (double)total : 0.0;
+}
+
+/*===========================================================================*/
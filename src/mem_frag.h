@@ -0,0 +1,18 @@
+#ifndef __MEM_FRAG_H__
+#define __MEM_FRAG_H__
+
+/*===========================================================================*/
+/* 内存使用效率统计 */
+/*===========================================================================*/
+
+struct mem_frag_stats;
+
+/* 遍历所有内存页统计内存使用效率，调用方需持有分配器锁 */
+void mem_frag_build(struct mem_frag_stats *stats);
+
+/* 打印统计结果，不需要持有分配器锁 */
+void mem_frag_print(const struct mem_frag_stats *stats);
+
+/*===========================================================================*/
+
+#endif /* __MEM_FRAG_H__ */
@@ -0,0 +1,488 @@
+#if defined(WIN32)
+#define _CRT_SECURE_NO_WARNINGS
+#else
+#define _GNU_SOURCE
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "mem.h"
+#include "mem_page.h"
+#include "mem_lockstat.h"
+#include "mem_guard.h"
+
+/*===========================================================================*/
+
+#if defined(__linux__)
+#include <signal.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#endif /* __linux__ */
+
+#if defined(__GLIBC__)
+#include <execinfo.h>
+#endif /* __GLIBC__ */
+
+#if defined(WIN32)
+#include <windows.h>
+typedef SRWLOCK GUARD_LOCK_HANDLE;
+#define GUARD_LOCK_INITIALIZER SRWLOCK_INIT
+#define GUARD_LOCK(lock, path) \
+    MEM_LOCKSTAT_LOCK(&(lock), MEM_LOCK_ID_GUARD, (path), \
+        TryAcquireSRWLockExclusive(&(lock)), AcquireSRWLockExclusive(&(lock)))
+#define GUARD_UNLOCK(lock) MEM_LOCKSTAT_UNLOCK(MEM_LOCK_ID_GUARD, ReleaseSRWLockExclusive(&(lock)))
+#else /* Linux */
+typedef pthread_mutex_t GUARD_LOCK_HANDLE;
+#define GUARD_LOCK_INITIALIZER PTHREAD_MUTEX_INITIALIZER
+#define GUARD_LOCK(lock, path) \
+    MEM_LOCKSTAT_LOCK(&(lock), MEM_LOCK_ID_GUARD, (path), \
+        !pthread_mutex_trylock(&(lock)), pthread_mutex_lock(&(lock)))
+#define GUARD_UNLOCK(lock) MEM_LOCKSTAT_UNLOCK(MEM_LOCK_ID_GUARD, pthread_mutex_unlock(&(lock)))
+#endif /* WIN32 & Linux */
+
+/*===========================================================================*/
+
+#define MEM_GUARD_ALIGN 8               /* 内存块对齐字节数 */
+
+/* 槽位状态 */
+#define GUARD_SLOT_EMPTY    0           /* 从未使用 */
+#define GUARD_SLOT_LIVE     1           /* 正在使用 */
+#define GUARD_SLOT_FREED    2           /* 已释放 */
+
+/* 错误类型 */
+#define GUARD_ERROR_OVERFLOW    0       /* 越过内存块末尾 */
+#define GUARD_ERROR_UNDERFLOW   1       /* 越过内存块开头 */
+#define GUARD_ERROR_USE_FREED   2       /* 释放后使用 */
+#define GUARD_ERROR_WILD        3       /* 访问从未使用的槽位 */
+#define GUARD_ERROR_DOUBLE_FREE 4       /* 重复释放 */
+#define GUARD_ERROR_BAD_FREE    5       /* 释放的地址不是内存块首地址 */
+
+/* 调用栈 */
+typedef struct {
+    int depth;
+    unsigned long long thread;
+    void *frames[MEM_GUARD_MAX_DEPTH];
+} GUARD_TRACE;
+
+/* 槽位信息 */
+typedef struct {
+    int state;                  /* 槽位状态 */
+    size_t ptr;                 /* 内存块地址 */
+    size_t len;                 /* 申请的字节数 */
+
+    GUARD_TRACE alloc;          /* 分配时的调用栈 */
+    GUARD_TRACE free;           /* 释放时的调用栈 */
+} GUARD_SLOT;
+
+/*===========================================================================*/
+
+size_t mem_guard_rate = 0;
+MEM_GUARD_TLS long long mem_guard_countdown = 0;
+
+size_t mem_guard_base = 0;
+size_t mem_guard_size = 0;
+
+static GUARD_LOCK_HANDLE guard_lock = GUARD_LOCK_INITIALIZER;
+
+static GUARD_SLOT *guard_slots = NULL;
+static int guard_slot_count = 0;
+static int guard_cursor = 0;    /* 下一次查找可用槽位的起点 */
+static size_t guard_page = 0;   /* 系统页大小 */
+
+/* 线程的随机数种子 */
+static MEM_GUARD_TLS unsigned long long guard_thread_seed = 0;
+
+#if defined(__linux__)
+static struct sigaction guard_old_action;
+#endif /* __linux__ */
+
+/*===========================================================================*/
+
+/* 记录当前调用栈 */
+static void save_trace(GUARD_TRACE *trace);
+
+/* 打印错误报告，可在信号处理函数中调用 */
+static void report(int error, size_t addr, const GUARD_SLOT *slot);
+
+/* 打印调用栈 */
+static void report_trace(const char *title, const GUARD_TRACE *trace);
+
+/* 将字符串写到标准错误输出 */
+static void report_write(const char *info);
+
+#if defined(__linux__)
+/* SIGSEGV 处理函数 */
+static void guard_signal(int sig, siginfo_t *info, void *context);
+#endif /* __linux__ */
+
+/*===========================================================================*/
+
+int mem_guard_start(size_t rate, int slots)
+{
+#if defined(__linux__)
+    struct sigaction action;
+    void *pool = NULL;
+
+    if (!rate || slots <= 0) {
+        return MEM_FAILED;
+    }
+
+    GUARD_LOCK(guard_lock, MEM_LOCK_PATH_OTHER);
+
+    /* 内存池创建后不再改变，重复调用只更新采样间隔 */
+    if (!guard_slots) {
+        guard_page = (size_t)sysconf(_SC_PAGESIZE);
+
+        pool = mmap(NULL, (2 * (size_t)slots + 1) * guard_page,
+            PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (pool == MAP_FAILED) {
+            GUARD_UNLOCK(guard_lock);
+            return MEM_FAILED;
+        }
+
+        guard_slots = (GUARD_SLOT *)calloc((size_t)slots, sizeof(GUARD_SLOT));
+        if (!guard_slots) {
+            munmap(pool, (2 * (size_t)slots + 1) * guard_page);
+            GUARD_UNLOCK(guard_lock);
+            return MEM_FAILED;
+        }
+
+        memset(&action, 0, sizeof(action));
+        action.sa_sigaction = guard_signal;
+        action.sa_flags = SA_SIGINFO | SA_ONSTACK;
+        sigemptyset(&action.sa_mask);
+        sigaction(SIGSEGV, &action, &guard_old_action);
+
+        guard_slot_count = slots;
+        guard_cursor = 0;
+
+        mem_guard_base = (size_t)pool;
+        mem_guard_size = (2 * (size_t)slots + 1) * guard_page;
+    }
+
+    mem_guard_rate = rate;
+
+    GUARD_UNLOCK(guard_lock);
+    return MEM_SUCCESS;
+#else
+    (void)rate;
+    (void)slots;
+    return MEM_FAILED;
+#endif /* __linux__ */
+}
+
+void mem_guard_stop()
+{
+    mem_guard_rate = 0;
+}
+
+int mem_guard_sample()
+{
+    unsigned long long x = guard_thread_seed;
+    int ret = x != 0;
+
+    if (!x) {
+        x = (unsigned long long)(size_t)&guard_thread_seed ^ 0x9E3779B97F4A7C15ULL;
+    }
+
+    /* xorshift64，跳过的分配次数在 [0, 2 * rate - 2] 之间均匀分布，平均间隔为 rate */
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    guard_thread_seed = x;
+
+    mem_guard_countdown = (long long)(x % (2 * (unsigned long long)mem_guard_rate - 1));
+
+    /* 线程首次进入时只初始化采样间隔，不做采样 */
+    return ret;
+}
+
+void *mem_guard_alloc(size_t len)
+{
+#if defined(__linux__)
+    int i;
+    int index = -1;
+    size_t page = 0;
+    GUARD_SLOT *slot = NULL;
+
+    if (len > guard_page) {
+        return NULL;
+    }
+
+    GUARD_LOCK(guard_lock, MEM_LOCK_PATH_MALLOC);
+
+    /* 从上次的位置开始环形查找，已释放的槽位尽量晚一些复用 */
+    for (i = 0; i < guard_slot_count; i++) {
+        if (guard_slots[(guard_cursor + i) % guard_slot_count].state != GUARD_SLOT_LIVE) {
+            index = (guard_cursor + i) % guard_slot_count;
+            break;
+        }
+    }
+
+    if (index < 0) {
+        GUARD_UNLOCK(guard_lock);
+        return NULL;
+    }
+
+    guard_cursor = (index + 1) % guard_slot_count;
+
+    slot = guard_slots + index;
+    page = mem_guard_base + (2 * (size_t)index + 1) * guard_page;
+
+    if (mprotect((void *)page, guard_page, PROT_READ | PROT_WRITE)) {
+        GUARD_UNLOCK(guard_lock);
+        return NULL;
+    }
+
+    /*
+     * 内存块紧贴数据页末尾；0 字节的申请也占用 MEM_GUARD_ALIGN 字节，
+     * 否则首地址会落在其后的保护页上
+     */
+    memset(slot, 0, sizeof(GUARD_SLOT));
+    slot->state = GUARD_SLOT_LIVE;
+    slot->len = len;
+    slot->ptr = (page + guard_page - (len < MEM_GUARD_ALIGN ? MEM_GUARD_ALIGN : len)) &
+        ~((size_t)MEM_GUARD_ALIGN - 1);
+
+    GUARD_UNLOCK(guard_lock);
+
+    save_trace(&slot->alloc);
+    return (void *)slot->ptr;
+#else
+    (void)len;
+    return NULL;
+#endif /* __linux__ */
+}
+
+void mem_guard_free(void *ptr)
+{
+#if defined(__linux__)
+    size_t addr = (size_t)ptr;
+    size_t index = (addr - mem_guard_base) / guard_page;
+    GUARD_SLOT *slot = NULL;
+
+    /* 偶数页为保护页 */
+    if (!(index & 1)) {
+        report(GUARD_ERROR_BAD_FREE, addr, NULL);
+        abort();
+    }
+
+    slot = guard_slots + index / 2;
+
+    GUARD_LOCK(guard_lock, MEM_LOCK_PATH_FREE);
+
+    if (slot->state != GUARD_SLOT_LIVE || slot->ptr != addr) {
+        GUARD_UNLOCK(guard_lock);
+
+        report(slot->state == GUARD_SLOT_FREED && slot->ptr == addr ?
+            GUARD_ERROR_DOUBLE_FREE : GUARD_ERROR_BAD_FREE, addr, slot);
+        abort();
+    }
+
+    save_trace(&slot->free);
+    slot->state = GUARD_SLOT_FREED;
+
+    /* 数据页恢复为不可访问并归还物理内存 */
+    index = mem_guard_base + index * guard_page;
+    madvise((void *)index, guard_page, MADV_DONTNEED);
+    mprotect((void *)index, guard_page, PROT_NONE);
+
+    GUARD_UNLOCK(guard_lock);
+#else
+    (void)ptr;
+#endif /* __linux__ */
+}
+
+size_t mem_guard_len(void *ptr)
+{
+    size_t index = ((size_t)ptr - mem_guard_base) / guard_page;
+
+    if (!guard_slots || !(index & 1)) {
+        return 0;
+    }
+
+    return guard_slots[index / 2].len;
+}
+
+void mem_guard_clear()
+{
+#if defined(__linux__)
+    GUARD_LOCK(guard_lock, MEM_LOCK_PATH_OTHER);
+
+    mem_guard_rate = 0;
+
+    if (guard_slots) {
+        sigaction(SIGSEGV, &guard_old_action, NULL);
+        munmap((void *)mem_guard_base, mem_guard_size);
+        free(guard_slots);
+
+        guard_slots = NULL;
+        guard_slot_count = 0;
+        mem_guard_base = 0;
+        mem_guard_size = 0;
+    }
+
+    GUARD_UNLOCK(guard_lock);
+#endif /* __linux__ */
+}
+
+/*===========================================================================*/
+
+void save_trace(GUARD_TRACE *trace)
+{
+#if defined(__GLIBC__)
+    void *frames[MEM_GUARD_MAX_DEPTH + MEM_GUARD_SKIP_FRAMES];
+    int depth = backtrace(frames, MEM_GUARD_MAX_DEPTH + MEM_GUARD_SKIP_FRAMES);
+
+    depth = depth > MEM_GUARD_SKIP_FRAMES ? depth - MEM_GUARD_SKIP_FRAMES : 0;
+    memcpy(trace->frames, frames + MEM_GUARD_SKIP_FRAMES, depth * sizeof(void *));
+    trace->depth = depth;
+#else
+    trace->depth = 0;
+#endif /* __GLIBC__ */
+
+#if defined(__linux__)
+    trace->thread = (unsigned long long)pthread_self();
+#endif /* __linux__ */
+}
+
+void report(int error, size_t addr, const GUARD_SLOT *slot)
+{
+    char buff[256] = { 0 };
+    const char *name = NULL;
+    size_t offset = 0;
+
+    switch (error) {
+    case GUARD_ERROR_OVERFLOW:    name = "heap-buffer-overflow";  break;
+    case GUARD_ERROR_UNDERFLOW:   name = "heap-buffer-underflow"; break;
+    case GUARD_ERROR_USE_FREED:   name = "heap-use-after-free";   break;
+    case GUARD_ERROR_DOUBLE_FREE: name = "double-free";           break;
+    case GUARD_ERROR_BAD_FREE:    name = "invalid-free";          break;
+    default:                      name = "wild-access";           break;
+    }
+
+    report_write("<============================guard check============================>\n");
+
+    snprintf(buff, sizeof(buff), "%s on address %p\n", name, (void *)addr);
+    report_write(buff);
+
+    if (slot && slot->state != GUARD_SLOT_EMPTY) {
+        if (addr >= slot->ptr + slot->len) {
+            offset = addr - (slot->ptr + slot->len);
+            snprintf(buff, sizeof(buff), "%lu bytes after %lu-byte block at %p\n",
+                (unsigned long)offset, (unsigned long)slot->len, (void *)slot->ptr);
+        } else if (addr < slot->ptr) {
+            offset = slot->ptr - addr;
+            snprintf(buff, sizeof(buff), "%lu bytes before %lu-byte block at %p\n",
+                (unsigned long)offset, (unsigned long)slot->len, (void *)slot->ptr);
+        } else {
+            offset = addr - slot->ptr;
+            snprintf(buff, sizeof(buff), "%lu bytes inside %lu-byte block at %p\n",
+                (unsigned long)offset, (unsigned long)slot->len, (void *)slot->ptr);
+        }
+
+        report_write(buff);
+        report_trace("allocated", &slot->alloc);
+
+        if (slot->state == GUARD_SLOT_FREED) {
+            report_trace("freed", &slot->free);
+        }
+    }
+
+    report_write("<============================guard check============================>\n");
+}
+
+void report_trace(const char *title, const GUARD_TRACE *trace)
+{
+    char buff[128] = { 0 };
+
+    snprintf(buff, sizeof(buff), "%s by thread %llu:\n", title, trace->thread);
+    report_write(buff);
+
+#if defined(__GLIBC__)
+    backtrace_symbols_fd((void *const *)trace->frames, trace->depth, 2);
+#endif /* __GLIBC__ */
+}
+
+void report_write(const char *info)
+{
+#if defined(__linux__)
+    size_t len = strlen(info);
+    ssize_t ret = 0;
+
+    while (len > 0 && (ret = write(2, info, len)) > 0) {
+        info += ret;
+        len -= (size_t)ret;
+    }
+#else
+    fputs(info, stderr);
+#endif /* __linux__ */
+}
+
+#if defined(__linux__)
+void guard_signal(int sig, siginfo_t *info, void *context)
+{
+    size_t addr = (size_t)info->si_addr;
+    size_t index = 0;
+
+    GUARD_SLOT *left = NULL;
+    GUARD_SLOT *right = NULL;
+
+    /* 不属于保护页内存池的访问错误交给原有的处理方式 */
+    if (!MEM_GUARD_OWNS(addr)) {
+        if (guard_old_action.sa_flags & SA_SIGINFO) {
+            guard_old_action.sa_sigaction(sig, info, context);
+            return;
+        }
+
+        if (guard_old_action.sa_handler != SIG_DFL &&
+            guard_old_action.sa_handler != SIG_IGN) {
+            guard_old_action.sa_handler(sig);
+            return;
+        }
+
+        sigaction(SIGSEGV, &guard_old_action, NULL);
+        return;
+    }
+
+    index = (addr - mem_guard_base) / guard_page;
+
+    if (index & 1) {
+        /* 访问数据页：槽位已释放或者从未使用 */
+        left = guard_slots + index / 2;
+        report(left->state == GUARD_SLOT_FREED ?
+            GUARD_ERROR_USE_FREED : GUARD_ERROR_WILD, addr, left);
+    } else {
+        /* 访问保护页：归属于距离最近的正在使用的内存块 */
+        left  = index > 0 ? guard_slots + index / 2 - 1 : NULL;
+        right = (int)(index / 2) < guard_slot_count ? guard_slots + index / 2 : NULL;
+
+        if (left && left->state != GUARD_SLOT_LIVE) {
+            left = NULL;
+        }
+
+        if (right && right->state != GUARD_SLOT_LIVE) {
+            right = NULL;
+        }
+
+        if (left && (!right || addr - (left->ptr + left->len) < right->ptr - addr)) {
+            report(GUARD_ERROR_OVERFLOW, addr, left);
+        } else if (right) {
+            report(GUARD_ERROR_UNDERFLOW, addr, right);
+        } else {
+            report(GUARD_ERROR_WILD, addr, NULL);
+        }
+    }
+
+    /* 恢复原有的处理方式，返回后重新执行出错的指令时由其终止进程 */
+    sigaction(SIGSEGV, &guard_old_action, NULL);
+    if (guard_old_action.sa_handler == SIG_IGN) {
+        signal(SIGSEGV, SIG_DFL);
+    }
+}
+#endif /* __linux__ */
+
+/*===========================================================================*/
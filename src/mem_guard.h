@@ -0,0 +1,76 @@
+#ifndef __MEM_GUARD_H__
+#define __MEM_GUARD_H__
+
+#include <stddef.h>
+
+/*===========================================================================*/
+/* 采样保护页分配器 */
+/*===========================================================================*/
+
+/*
+ * 保护页内存池为一段连续的虚拟内存，数据页与保护页交替排列：
+ *
+ * | guard | slot0 | guard | slot1 | guard | ... | slotn | guard |
+ *
+ * 1.被采样的分配独占一个槽位的数据页，内存块紧贴数据页的末尾（按 8 字节
+ * 对齐），越界写会立即触及其后的保护页，向前越界则触及之前的保护页；
+ *
+ * 2.释放后数据页恢复为不可访问并归还物理内存，槽位按环形顺序复用，所以
+ * 已释放的内存块在其余槽位轮转一遍之前都保持不可访问，期间的释放后使用
+ * 同样会立即触发访问错误；
+ *
+ * 3.访问错误由 SIGSEGV 处理函数捕获，打印错误类型以及该内存块分配和释放
+ * 时的调用栈，之后恢复原有的信号处理方式，由其终止进程；重复释放和非法
+ * 释放在 mem_guard_free 中检查，打印报告后直接终止进程。
+ *
+ * 只在 Linux 下支持。
+ */
+
+#if defined(WIN32)
+#define MEM_GUARD_TLS __declspec(thread)
+#else /* Linux */
+#define MEM_GUARD_TLS __thread
+#endif /* WIN32 & Linux */
+
+#define MEM_GUARD_MAX_DEPTH     16      /* 保存的调用栈深度 */
+#define MEM_GUARD_SKIP_FRAMES   2       /* 跳过记录调用栈的函数和 mem_guard_alloc/free */
+
+/* 平均采样间隔（分配次数），为 0 时表示未开启 */
+extern size_t mem_guard_rate;
+
+/* 当前线程距离下一次采样剩余的分配次数 */
+extern MEM_GUARD_TLS long long mem_guard_countdown;
+
+/* 保护页内存池的起始地址和大小，未创建时大小为 0 */
+extern size_t mem_guard_base;
+extern size_t mem_guard_size;
+
+/*
+ * 采样判定：未开启时只有一次比较，开启后每次分配只做一次线程局部的
+ * 减法，计数耗尽时才进入 mem_guard_sample 重新计算采样间隔
+ */
+#define MEM_GUARD_SAMPLE() \
+    (mem_guard_rate && --mem_guard_countdown < 0 && mem_guard_sample())
+
+/* 地址是否属于保护页内存池，只有一次减法和一次比较 */
+#define MEM_GUARD_OWNS(ptr) \
+    ((size_t)(ptr) - mem_guard_base < mem_guard_size)
+
+/* 重置当前线程的采样间隔，返回非 0 表示本次分配需要采样 */
+int mem_guard_sample();
+
+/* 从保护页内存池分配，尺寸超过一页或者没有可用槽位时返回 NULL */
+void *mem_guard_alloc(size_t len);
+
+/* 释放保护页内存池中的内存块，重复释放或者地址非法时终止进程 */
+void mem_guard_free(void *ptr);
+
+/* 获取保护页内存池中内存块的申请尺寸 */
+size_t mem_guard_len(void *ptr);
+
+/* 释放保护页内存池并恢复信号处理，调用后不能再访问其中的内存块 */
+void mem_guard_clear();
+
+/*===========================================================================*/
+
+#endif /* __MEM_GUARD_H__ */
@@ -0,0 +1,324 @@
+#if defined(WIN32)
+#define _CRT_SECURE_NO_WARNINGS
+#else
+#define _GNU_SOURCE
+#endif
+
+#include <stdio.h>
+#include <string.h>
+
+#include "mem.h"
+#include "mem_page.h"
+#include "mem_lockstat.h"
+
+/*===========================================================================*/
+
+#if defined(WIN32)
+#include <windows.h>
+#else /* Linux */
+#include <time.h>
+#endif /* WIN32 & Linux */
+
+/*===========================================================================*/
+
+/* 单把锁的统计，按缓存行隔开 */
+typedef struct {
+    unsigned long long since;           /* 获得锁的时刻，未记录时为 0 */
+    int path;                           /* 本次持有的调用路径 */
+    struct mem_lock_path_stats paths[MEM_LOCK_PATH_COUNT];
+    char pad[64];
+} LOCKSTAT_ENTRY;
+
+/*===========================================================================*/
+
+/* 时钟周期换算为纳秒 */
+static unsigned long long lockstat_ns(unsigned long long ticks);
+
+/* 校准时钟周期与纳秒的换算比例 */
+static void lockstat_calibrate();
+
+/* 持有时长对应的直方图区间 */
+static int lockstat_bucket(unsigned long long ns);
+
+/*===========================================================================*/
+
+volatile int mem_lockstat_on = 0;
+
+static LOCKSTAT_ENTRY lockstat_entries[MEM_LOCK_ID_COUNT];
+
+/* 清零时的基线，读取时减去 */
+static struct mem_lock_stats lockstat_base;
+
+/* 每个时钟周期的纳秒数，左移 MEM_LOCKSTAT_SHIFT 位的定点数 */
+static unsigned long long lockstat_mult = 0;
+
+/* 统计区间，单位为纳秒，stop 为 0 表示仍在统计 */
+static unsigned long long lockstat_start = 0;
+static unsigned long long lockstat_stop = 0;
+
+static const char *lockstat_lock_names[MEM_LOCK_ID_COUNT] = {
+    "mem", "prof", "trace", "guard", "scrub"
+};
+
+static const char *lockstat_path_names[MEM_LOCK_PATH_COUNT] = {
+    "malloc", "free", "realloc", "print", "other"
+};
+
+/*===========================================================================*/
+
+int mem_lock_stats_start()
+{
+    if (mem_lockstat_on) {
+        return MEM_SUCCESS;
+    }
+
+    if (!lockstat_mult) {
+        lockstat_calibrate();
+    }
+
+    /* 先开启再记录基线，开启瞬间的加锁同时计入基线和当前值，相减后抵消 */
+    mem_lockstat_on = 1;
+    mem_lock_stats_reset();
+
+    return MEM_SUCCESS;
+}
+
+void mem_lock_stats_stop()
+{
+    if (!mem_lockstat_on) {
+        return;
+    }
+
+    mem_lockstat_on = 0;
+    lockstat_stop = mem_lockstat_clock();
+}
+
+void mem_lock_stats_reset()
+{
+    int i;
+
+    for (i = 0; i < MEM_LOCK_ID_COUNT; i++) {
+        memcpy(lockstat_base.locks[i], lockstat_entries[i].paths,
+            sizeof(lockstat_base.locks[i]));
+    }
+
+    lockstat_start = mem_lockstat_clock();
+    lockstat_stop = mem_lockstat_on ? 0 : lockstat_start;
+}
+
+int mem_lock_stats_get(struct mem_lock_stats *stats)
+{
+    int i;
+    int j;
+    int k;
+    struct mem_lock_path_stats *dst = NULL;
+    const struct mem_lock_path_stats *cur = NULL;
+    const struct mem_lock_path_stats *base = NULL;
+
+    if (!stats) {
+        return MEM_FAILED;
+    }
+
+    memset(stats, 0, sizeof(*stats));
+
+    if (lockstat_start) {
+        stats->elapsed = (lockstat_stop ? lockstat_stop : mem_lockstat_clock()) - lockstat_start;
+    }
+
+    for (i = 0; i < MEM_LOCK_ID_COUNT; i++) {
+        for (j = 0; j < MEM_LOCK_PATH_COUNT; j++) {
+            dst  = &stats->locks[i][j];
+            cur  = &lockstat_entries[i].paths[j];
+            base = &lockstat_base.locks[i][j];
+
+            dst->acquired     = cur->acquired - base->acquired;
+            dst->contended    = cur->contended - base->contended;
+            dst->wait_ns      = cur->wait_ns - base->wait_ns;
+            dst->hold_samples = cur->hold_samples - base->hold_samples;
+            dst->hold_ns      = cur->hold_ns - base->hold_ns;
+
+            for (k = 0; k < MEM_LOCK_HOLD_BUCKETS; k++) {
+                dst->hold_hist[k] = cur->hold_hist[k] - base->hold_hist[k];
+            }
+        }
+    }
+
+    return MEM_SUCCESS;
+}
+
+void mem_print_lock_stats()
+{
+    int i;
+    int j;
+    int k;
+    struct mem_lock_stats stats;
+    const struct mem_lock_path_stats *info = NULL;
+
+    mem_lock_stats_get(&stats);
+
+    printf("<=========================lock contention=========================>\n");
+    printf("elapsed = %.3f ms\n", (double)stats.elapsed / 1e6);
+    printf("\nlock   path        acquired   contended  contend  wait_ns/wait  hold_ns/acq\n");
+
+    for (i = 0; i < MEM_LOCK_ID_COUNT; i++) {
+        for (j = 0; j < MEM_LOCK_PATH_COUNT; j++) {
+            info = &stats.locks[i][j];
+
+            if (!info->acquired) {
+                continue;
+            }
+
+            printf("%-6s %-8s %11llu %11llu  %6.2f%%  %12.1f %12.1f\n",
+                lockstat_lock_names[i], lockstat_path_names[j],
+                info->acquired, info->contended,
+                100.0 * (double)info->contended / (double)info->acquired,
+                info->contended ? (double)info->wait_ns / (double)info->contended : 0.0,
+                info->hold_samples ? (double)info->hold_ns / (double)info->hold_samples : 0.0);
+        }
+    }
+
+    /* 抽样持锁时长直方图，第 k 列的下限为 2^(k+4) 纳秒 */
+    printf("\nlock   path     hold time: <32ns");
+    for (k = 1; k < MEM_LOCK_HOLD_BUCKETS; k++) {
+        if (k + MEM_LOCK_HOLD_MIN_SHIFT - 1 < 10) {
+            printf(" %5dn", 1 << (k + MEM_LOCK_HOLD_MIN_SHIFT - 1));
+        } else {
+            printf(" %5du", 1 << (k + MEM_LOCK_HOLD_MIN_SHIFT - 1 - 10));
+        }
+    }
+    printf("\n");
+
+    for (i = 0; i < MEM_LOCK_ID_COUNT; i++) {
+        for (j = 0; j < MEM_LOCK_PATH_COUNT; j++) {
+            info = &stats.locks[i][j];
+
+            if (!info->acquired) {
+                continue;
+            }
+
+            printf("%-6s %-8s            %5llu", lockstat_lock_names[i],
+                lockstat_path_names[j], info->hold_hist[0]);
+
+            for (k = 1; k < MEM_LOCK_HOLD_BUCKETS; k++) {
+                printf(" %6llu", info->hold_hist[k]);
+            }
+
+            printf("\n");
+        }
+    }
+
+    printf("<=========================lock contention=========================>\n");
+}
+
+/*===========================================================================*/
+
+unsigned long long mem_lockstat_clock()
+{
+#if defined(WIN32)
+    LARGE_INTEGER freq;
+    LARGE_INTEGER now;
+
+    QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&now);
+
+    return (unsigned long long)(now.QuadPart / freq.QuadPart) * 1000000000ULL +
+        (unsigned long long)(now.QuadPart % freq.QuadPart) * 1000000000ULL /
+        (unsigned long long)freq.QuadPart;
+#else /* Linux */
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000ULL + (unsigned long long)ts.tv_nsec;
+#endif /* WIN32 & Linux */
+}
+
+void mem_lockstat_acquired(int id, int path, unsigned long long wait_start)
+{
+    LOCKSTAT_ENTRY *entry = &lockstat_entries[id];
+    struct mem_lock_path_stats *stats = &entry->paths[path];
+    unsigned long long now = 0;
+
+    stats->acquired++;
+
+    if (wait_start) {
+        now = MEM_LOCKSTAT_TICKS();
+        stats->contended++;
+        stats->wait_ns += lockstat_ns(now > wait_start ? now - wait_start : 0);
+    }
+
+    /* 持锁时长按间隔抽样 */
+    if (!(stats->acquired & (MEM_LOCK_HOLD_SAMPLE - 1))) {
+        entry->since = now ? now : MEM_LOCKSTAT_TICKS();
+        entry->path  = path;
+    }
+}
+
+void mem_lockstat_release(int id)
+{
+    LOCKSTAT_ENTRY *entry = &lockstat_entries[id];
+    struct mem_lock_path_stats *stats = NULL;
+    unsigned long long now = 0;
+    unsigned long long ns = 0;
+
+    /* 开启统计之前获得的锁没有记录获得时刻 */
+    if (!entry->since) {
+        return;
+    }
+
+    now = MEM_LOCKSTAT_TICKS();
+    ns  = lockstat_ns(now > entry->since ? now - entry->since : 0);
+
+    stats = &entry->paths[entry->path];
+    stats->hold_samples++;
+    stats->hold_ns += ns;
+    stats->hold_hist[lockstat_bucket(ns)]++;
+
+    entry->since = 0;
+}
+
+/*===========================================================================*/
+
+unsigned long long lockstat_ns(unsigned long long ticks)
+{
+    return (ticks * lockstat_mult) >> MEM_LOCKSTAT_SHIFT;
+}
+
+void lockstat_calibrate()
+{
+    unsigned long long ns_start = 0;
+    unsigned long long ns_end = 0;
+    unsigned long long tick_start = 0;
+    unsigned long long tick_end = 0;
+
+    ns_start = mem_lockstat_clock();
+    tick_start = MEM_LOCKSTAT_TICKS();
+
+    /* 忙等待一小段时间，时长足够时换算误差在千分之一以内 */
+    do {
+        ns_end = mem_lockstat_clock();
+    } while (ns_end - ns_start < MEM_LOCKSTAT_CALIBRATE);
+
+    tick_end = MEM_LOCKSTAT_TICKS();
+
+    if (tick_end > tick_start) {
+        lockstat_mult = ((ns_end - ns_start) << MEM_LOCKSTAT_SHIFT) / (tick_end - tick_start);
+    }
+
+    if (!lockstat_mult) {
+        lockstat_mult = 1;
+    }
+}
+
+int lockstat_bucket(unsigned long long ns)
+{
+    int bucket = 0;
+
+    ns >>= MEM_LOCK_HOLD_MIN_SHIFT;
+
+    while (ns && bucket < MEM_LOCK_HOLD_BUCKETS - 1) {
+        ns >>= 1;
+        bucket++;
+    }
+
+    return bucket;
+}
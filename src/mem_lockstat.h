@@ -0,0 +1,84 @@
+#ifndef __MEM_LOCKSTAT_H__
+#define __MEM_LOCKSTAT_H__
+
+#include "mem.h"
+#include "mem_probe.h"
+
+/*===========================================================================*/
+/* 锁竞争统计 */
+/*===========================================================================*/
+
+/*
+ * 1.分配器中的每把锁在加锁时先尝试一次非阻塞加锁，失败才算作竞争，
+ * 开启统计后记录开始等待的时刻；获得锁后累加次数，每个调用路径每
+ * MEM_LOCK_HOLD_SAMPLE 次加锁记录一次获得时刻，释放前按持有时长累加
+ * 到该路径的直方图；读取时间戳的开销与一次加解锁相当，逐次计时会使
+ * 无竞争的分配慢一倍以上；
+ *
+ * 2.每把锁的统计只在持有该锁时修改，不需要原子操作，也不会与加锁
+ * 以外的缓存行发生争用；不同锁的统计按缓存行隔开；
+ *
+ * 3.时间戳在 x86 下取 TSC，开启统计时与单调时钟对比校准，换算为纳秒
+ * 只需一次乘法和移位；其余平台直接取单调时钟；
+ *
+ * 4.读取和清零不持锁：读取得到的是各计数器的近似快照，清零时记录当前
+ * 值作为基线，之后的读取减去基线，因此读取方不会写入统计。
+ */
+
+#define MEM_LOCKSTAT_SHIFT      16      /* 时钟周期换算为纳秒的定点小数位数 */
+#define MEM_LOCKSTAT_CALIBRATE  10000000ULL /* 校准时长，单位为纳秒 */
+
+/* 是否开启统计 */
+extern volatile int mem_lockstat_on;
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define MEM_LOCKSTAT_TICKS() __builtin_ia32_rdtsc()
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define MEM_LOCKSTAT_TICKS() __rdtsc()
+#else
+#define MEM_LOCKSTAT_TICKS() mem_lockstat_clock()
+#endif /* rdtsc */
+
+/*
+ * 带统计的加锁：try_lock 为非阻塞加锁表达式，成功时为真；wait_lock 为
+ * 阻塞加锁表达式。锁被占用时触发 lock_wait 和 lock_acquire 探针，见
+ * mem_probe.h
+ */
+#define MEM_LOCKSTAT_LOCK(lock, id, path, try_lock, wait_lock) \
+    do { \
+        unsigned long long lockstat_wait_ = 0; \
+        if (!(try_lock)) { \
+            MEM_PROBE1(lock_wait, (lock)); \
+            if (mem_lockstat_on) { \
+                lockstat_wait_ = MEM_LOCKSTAT_TICKS(); \
+            } \
+            wait_lock; \
+            MEM_PROBE1(lock_acquire, (lock)); \
+        } \
+        if (mem_lockstat_on) { \
+            mem_lockstat_acquired((id), (path), lockstat_wait_); \
+        } \
+    } while (0)
+
+/* 带统计的解锁，unlock 为解锁表达式 */
+#define MEM_LOCKSTAT_UNLOCK(id, unlock) \
+    do { \
+        if (mem_lockstat_on) { \
+            mem_lockstat_release(id); \
+        } \
+        unlock; \
+    } while (0)
+
+/* 单调时钟，单位为纳秒 */
+unsigned long long mem_lockstat_clock();
+
+/* 获得锁后调用，wait_start 为开始等待的时刻，未等待时为 0 */
+void mem_lockstat_acquired(int id, int path, unsigned long long wait_start);
+
+/* 释放锁之前调用，按持有时长计入直方图 */
+void mem_lockstat_release(int id);
+
+/*===========================================================================*/
+
+#endif /* __MEM_LOCKSTAT_H__ */
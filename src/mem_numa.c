@@ -0,0 +1,606 @@
+#if !defined(WIN32)
+#define _GNU_SOURCE
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "mem_page.h"
+#include "mem_numa.h"
+#include "link.h"
+
+/*===========================================================================*/
+
+#if defined(__linux__)
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif /* __linux__ */
+
+/* 线程局部变量 */
+#if defined(WIN32)
+#define MEM_TLS __declspec(thread)
+#else /* Linux */
+#define MEM_TLS __thread
+#endif /* WIN32 & Linux */
+
+/*===========================================================================*/
+
+#define MEM_NUMA_CHUNK_SIZE   (1 << 20)    /* 每次向系统映射的内存区大小 */
+#define MEM_NUMA_BUCKET_COUNT 32           /* 每个节点空闲内存链表数量 */
+#define MEM_NUMA_ALIGN        64           /* 内存池分配对齐字节数 */
+#define MEM_NUMA_MASK_BITS    1024         /* 节点掩码位数，不小于内核的 MAX_NUMNODES */
+
+/*
+ * 只有 1 个可用节点时是否仍进入内存池模式，默认关闭；基准测试中开启，
+ * 使单节点机器上也能走内存池切分内存页的路径，对比缓存着色的效果
+ */
+#ifndef MEM_NUMA_FORCE_POOL
+#define MEM_NUMA_FORCE_POOL 0
+#endif /* MEM_NUMA_FORCE_POOL */
+
+/* 内存策略，见 linux/mempolicy.h */
+#define MEM_MPOL_PREFERRED    1
+#define MEM_MPOL_F_MEMS_ALLOWED (1 << 2)
+
+#define MEM_NUMA_ALIGN_SIZE(size) \
+    (((size) + MEM_NUMA_ALIGN - 1) & (~((size_t)MEM_NUMA_ALIGN - 1)))
+
+#define MEM_NUMA_MASK_LONGS \
+    (MEM_NUMA_MASK_BITS / (8 * sizeof(unsigned long)))
+
+/* 空闲内存，继承自 LINK_STACK_NODE */
+typedef struct {
+    LINK_STACK_NODE node;
+    int trimmed;                /* 是否已经尝试归还物理内存 */
+    size_t size;                /* 空闲内存尺寸 */
+    size_t released;            /* 已归还给系统的字节数 */
+} MEM_NUMA_FREE;
+
+/* 映射的内存区，头部记录在内存区的起始位置 */
+typedef struct mem_numa_chunk_st MEM_NUMA_CHUNK;
+struct mem_numa_chunk_st {
+    MEM_NUMA_CHUNK *next;
+    size_t size;
+    size_t carved;              /* 已切分出的字节数 */
+
+    /* 收缩时的统计 */
+    size_t free;                /* 已切分的内存中空闲的字节数 */
+    size_t released;            /* 空闲内存中已归还给系统的字节数 */
+};
+
+/* 
+ * 相同尺寸的空闲内存栈，空闲内存本身作为栈节点，内存区在
+ * mem_numa_clear 之前不会归还系统，满足无锁栈对节点内存的要求
+ */
+typedef struct {
+    size_t size;                /* 空闲内存尺寸 */
+    LINK_STACK free;            /* 空闲内存栈 */
+} MEM_NUMA_BUCKET;
+
+/* 节点内存池 */
+typedef struct {
+    int node;                   /* 系统节点编号 */
+
+    MEM_NUMA_CHUNK *chunk;      /* 已映射的内存区链表，表头为当前内存区 */
+    MEM_NUMA_CHUNK *empty;      /* 物理内存已归还、等待复用的内存区 */
+    unsigned char *cursor;      /* 当前内存区的可用位置 */
+    size_t remain;              /* 当前内存区剩余字节数 */
+
+    MEM_NUMA_BUCKET bucket[MEM_NUMA_BUCKET_COUNT];
+} MEM_NUMA_POOL;
+
+/*===========================================================================*/
+
+static int numa_enabled = 0;
+static int numa_node_count = 1;
+static MEM_NUMA_POOL numa_pool[MEM_NUMA_MAX_NODE];
+
+/* 线程所属节点，-1 表示尚未确定 */
+static MEM_TLS int numa_thread_node = -1;
+
+/*===========================================================================*/
+
+/* 获取 cpu 当前所在的系统节点 */
+static int get_cpu_node();
+
+/* 将内存区绑定到系统节点 */
+static int bind_node(void *addr, size_t size, int node);
+
+/* 从内存池中切分内存 */
+static void *pool_carve(MEM_NUMA_POOL *pool, size_t size);
+
+/* 查找尺寸对应的空闲链表 */
+static MEM_NUMA_BUCKET *pool_bucket(MEM_NUMA_POOL *pool, size_t size);
+
+/* 将空闲内存中完整的系统页归还给系统，返回归还的字节数 */
+static size_t free_trim(MEM_NUMA_FREE *block);
+
+/* 收缩一个节点内存池，返回归还给系统的字节数 */
+static size_t pool_trim(MEM_NUMA_POOL *pool);
+
+/* 归还内存区中除头部所在系统页以外的物理内存，返回归还的字节数 */
+static size_t chunk_trim(MEM_NUMA_CHUNK *chunk);
+
+/* 查找内存所属的内存区，chunks 按地址升序排列 */
+static MEM_NUMA_CHUNK *chunk_find(MEM_NUMA_CHUNK **chunks, size_t count, void *ptr);
+static int compare_chunk(const void *a, const void *b);
+
+/*===========================================================================*/
+
+int mem_numa_init()
+{
+#if defined(__linux__)
+    int i;
+    int mode = 0;
+    int count = 0;
+
+    unsigned long mask[MEM_NUMA_MASK_LONGS];
+    size_t bits = 8 * sizeof(unsigned long);
+
+    if (numa_enabled) {
+        return MEM_SUCCESS;
+    }
+
+    memset(mask, 0, sizeof(mask));
+
+    /* 获取当前进程允许使用的节点 */
+    if (syscall(SYS_get_mempolicy, &mode, mask,
+            MEM_NUMA_MASK_BITS, NULL, MEM_MPOL_F_MEMS_ALLOWED)) {
+        return MEM_FAILED;
+    }
+
+    memset(numa_pool, 0, sizeof(numa_pool));
+
+    for (i = 0; i < MEM_NUMA_MASK_BITS && count < MEM_NUMA_MAX_NODE; i++) {
+        if (mask[i / bits] & (1UL << (i % bits))) {
+            numa_pool[count++].node = i;
+        }
+    }
+
+    /* 单节点机器保持普通模式 */
+    if (count < 1 || (count == 1 && !MEM_NUMA_FORCE_POOL)) {
+        return MEM_FAILED;
+    }
+
+    numa_node_count = count;
+    numa_enabled = 1;
+    return MEM_SUCCESS;
+#else
+    return MEM_FAILED;
+#endif /* __linux__ */
+}
+
+void mem_numa_clear()
+{
+#if defined(__linux__)
+    int i;
+
+    MEM_NUMA_CHUNK *chunk = NULL;
+    MEM_NUMA_CHUNK *next = NULL;
+
+    for (i = 0; i < numa_node_count && numa_enabled; i++) {
+        chunk = numa_pool[i].chunk;
+
+        while (chunk) {
+            next = chunk->next;
+            munmap(chunk, chunk->size);
+            chunk = next;
+        }
+
+        chunk = numa_pool[i].empty;
+
+        while (chunk) {
+            next = chunk->next;
+            munmap(chunk, chunk->size);
+            chunk = next;
+        }
+    }
+#endif /* __linux__ */
+
+    memset(numa_pool, 0, sizeof(numa_pool));
+    numa_node_count = 1;
+    numa_enabled = 0;
+}
+
+int mem_numa_enabled()
+{
+    return numa_enabled;
+}
+
+int mem_numa_node_count()
+{
+    return numa_node_count;
+}
+
+int mem_numa_current_node()
+{
+    int i;
+    int node = 0;
+
+    if (!numa_enabled) {
+        return 0;
+    }
+
+    if (numa_thread_node >= 0) {
+        return numa_thread_node;
+    }
+
+    /* 将系统节点编号转换为内存池索引，未知节点归入 0 号内存池 */
+    node = get_cpu_node();
+    numa_thread_node = 0;
+
+    for (i = 0; i < numa_node_count; i++) {
+        if (numa_pool[i].node == node) {
+            numa_thread_node = i;
+            break;
+        }
+    }
+
+    return numa_thread_node;
+}
+
+void *mem_numa_alloc(int node, size_t size)
+{
+    MEM_NUMA_POOL *pool = NULL;
+    MEM_NUMA_BUCKET *bucket = NULL;
+    void *ret = NULL;
+
+    if (!numa_enabled || node < 0 || node >= numa_node_count) {
+        return NULL;
+    }
+
+    pool = numa_pool + node;
+    size = MEM_NUMA_ALIGN_SIZE(size);
+
+    /* 优先复用已归还的内存 */
+    bucket = pool_bucket(pool, size);
+    if (bucket) {
+        ret = link_stack_pop(&bucket->free);
+        if (ret) {
+            return ret;
+        }
+    }
+
+    return pool_carve(pool, size);
+}
+
+void mem_numa_free(int node, void *ptr, size_t size)
+{
+    MEM_NUMA_BUCKET *bucket = NULL;
+    MEM_NUMA_FREE *block = NULL;
+
+    if (!ptr || node < 0 || node >= numa_node_count) {
+        return;
+    }
+
+    size = MEM_NUMA_ALIGN_SIZE(size);
+    bucket = pool_bucket(numa_pool + node, size);
+
+    /* 空闲链表已用尽时，内存保留在内存区中直至 mem_numa_clear */
+    if (!bucket) {
+        return;
+    }
+
+    block = (MEM_NUMA_FREE *)ptr;
+    block->trimmed = 0;
+    block->size = size;
+    block->released = 0;
+
+    link_stack_push(&bucket->free, &block->node);
+}
+
+size_t mem_numa_trim()
+{
+    int i;
+    size_t ret = 0;
+
+    if (!numa_enabled) {
+        return 0;
+    }
+
+    for (i = 0; i < numa_node_count; i++) {
+        ret += pool_trim(numa_pool + i);
+    }
+
+    return ret;
+}
+
+/*===========================================================================*/
+
+int get_cpu_node()
+{
+#if defined(__linux__)
+    unsigned int cpu = 0;
+    unsigned int node = 0;
+
+    if (syscall(SYS_getcpu, &cpu, &node, NULL)) {
+        return 0;
+    }
+
+    return (int)node;
+#else
+    return 0;
+#endif /* __linux__ */
+}
+
+int bind_node(void *addr, size_t size, int node)
+{
+#if defined(__linux__)
+    unsigned long mask[MEM_NUMA_MASK_LONGS];
+    size_t bits = 8 * sizeof(unsigned long);
+
+    memset(mask, 0, sizeof(mask));
+    mask[node / bits] |= 1UL << (node % bits);
+
+    /* 使用 PREFERRED 策略，节点内存不足时允许回落到其他节点 */
+    if (syscall(SYS_mbind, addr, size, MEM_MPOL_PREFERRED,
+            mask, MEM_NUMA_MASK_BITS + 1, 0)) {
+        return MEM_FAILED;
+    }
+
+    return MEM_SUCCESS;
+#else
+    return MEM_FAILED;
+#endif /* __linux__ */
+}
+
+void *pool_carve(MEM_NUMA_POOL *pool, size_t size)
+{
+#if defined(__linux__)
+    size_t chunk_size = MEM_NUMA_CHUNK_SIZE;
+    MEM_NUMA_CHUNK *chunk = NULL;
+    unsigned char *ret = NULL;
+
+    MEM_NUMA_CHUNK **link = NULL;
+
+    if (pool->remain < size) {
+        if (size + MEM_NUMA_ALIGN > chunk_size) {
+            chunk_size = MEM_NUMA_ALIGN_SIZE(size + MEM_NUMA_ALIGN);
+        }
+
+        /* 优先复用已收缩的内存区，绑定策略在归还物理内存后仍然有效 */
+        for (link = &pool->empty; *link; link = &(*link)->next) {
+            if ((*link)->size >= size + MEM_NUMA_ALIGN) {
+                chunk = *link;
+                *link = chunk->next;
+                break;
+            }
+        }
+
+        if (!chunk) {
+            chunk = (MEM_NUMA_CHUNK *)mmap(NULL, chunk_size,
+                PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+            if (chunk == (MEM_NUMA_CHUNK *)MAP_FAILED) {
+                return NULL;
+            }
+
+            /* 绑定失败时内存仍然可用，只是不保证节点位置 */
+            bind_node(chunk, chunk_size, pool->node);
+            chunk->size = chunk_size;
+        }
+
+        chunk->carved = 0;
+        chunk->next = pool->chunk;
+        pool->chunk = chunk;
+
+        /* 内存区头部占用第一个对齐单元 */
+        pool->cursor = (unsigned char *)chunk + MEM_NUMA_ALIGN;
+        pool->remain = chunk->size - MEM_NUMA_ALIGN;
+    }
+
+    ret = pool->cursor;
+    pool->cursor += size;
+    pool->remain -= size;
+    pool->chunk->carved += size;
+
+    return ret;
+#else
+    return NULL;
+#endif /* __linux__ */
+}
+
+size_t free_trim(MEM_NUMA_FREE *block)
+{
+#if defined(__linux__)
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    size_t begin = (size_t)block + sizeof(MEM_NUMA_FREE);
+    size_t end = (size_t)block + block->size;
+
+    if (block->trimmed) {
+        return 0;
+    }
+
+    /* 空闲内存的头部保存着栈节点，只归还其后完整的系统页 */
+    begin = (begin + page - 1) & ~(page - 1);
+    end = end & ~(page - 1);
+
+    block->trimmed = 1;
+
+    if (begin >= end || madvise((void *)begin, end - begin, MADV_DONTNEED)) {
+        return 0;
+    }
+
+    block->released = end - begin;
+    return block->released;
+#else
+    (void)block;
+    return 0;
+#endif /* __linux__ */
+}
+
+size_t pool_trim(MEM_NUMA_POOL *pool)
+{
+    int i;
+    size_t j;
+    size_t count = 0;
+    size_t ret = 0;
+
+    LINK_STACK held;
+    LINK_STACK_NODE *node = NULL;
+    MEM_NUMA_FREE *block = NULL;
+    MEM_NUMA_BUCKET *bucket = NULL;
+    MEM_NUMA_CHUNK *chunk = NULL;
+    MEM_NUMA_CHUNK **chunks = NULL;
+    MEM_NUMA_CHUNK **link = NULL;
+
+    for (chunk = pool->chunk; chunk; chunk = chunk->next) {
+        chunk->free = 0;
+        chunk->released = 0;
+        count++;
+    }
+
+    if (!count) {
+        return 0;
+    }
+
+    /* 内存区数量可能很多，排序后按地址二分查找空闲内存所属的内存区 */
+    chunks = (MEM_NUMA_CHUNK **)malloc(count * sizeof(MEM_NUMA_CHUNK *));
+    if (chunks) {
+        for (j = 0, chunk = pool->chunk; chunk; chunk = chunk->next) {
+            chunks[j++] = chunk;
+        }
+
+        qsort(chunks, count, sizeof(MEM_NUMA_CHUNK *), compare_chunk);
+    }
+
+    /* 取出全部空闲内存，按内存区累计空闲字节数 */
+    link_stack_reset(&held);
+
+    for (i = 0; i < MEM_NUMA_BUCKET_COUNT && pool->bucket[i].size; i++) {
+        while ((node = link_stack_pop(&pool->bucket[i].free)) != NULL) {
+            block = (MEM_NUMA_FREE *)node;
+            chunk = chunks ? chunk_find(chunks, count, block) : NULL;
+
+            if (chunk) {
+                chunk->free += block->size;
+                chunk->released += block->released;
+            }
+
+            link_stack_push(&held, node);
+        }
+    }
+
+    /*
+     * 已切分的内存全部空闲的内存区整体归还，其中的空闲内存不再放回；
+     * 其余内存区只归还空闲内存中完整的系统页
+     */
+    while ((node = link_stack_pop(&held)) != NULL) {
+        block = (MEM_NUMA_FREE *)node;
+        chunk = chunks ? chunk_find(chunks, count, block) : NULL;
+
+        if (chunk && chunk->carved && chunk->free == chunk->carved) {
+            continue;
+        }
+
+        ret += free_trim(block);
+
+        bucket = pool_bucket(pool, block->size);
+        if (bucket) {
+            link_stack_push(&bucket->free, node);
+        }
+    }
+
+    for (link = &pool->chunk; *link;) {
+        chunk = *link;
+
+        if (!chunk->carved || chunk->free != chunk->carved) {
+            link = &chunk->next;
+            continue;
+        }
+
+        ret += chunk_trim(chunk);
+
+        /* 当前内存区从头重新切分，其余内存区移入待复用链表 */
+        if (chunk == pool->chunk) {
+            chunk->carved = 0;
+            pool->cursor = (unsigned char *)chunk + MEM_NUMA_ALIGN;
+            pool->remain = chunk->size - MEM_NUMA_ALIGN;
+
+            link = &chunk->next;
+        } else {
+            *link = chunk->next;
+
+            chunk->next = pool->empty;
+            pool->empty = chunk;
+        }
+    }
+
+    free(chunks);
+    return ret;
+}
+
+size_t chunk_trim(MEM_NUMA_CHUNK *chunk)
+{
+#if defined(__linux__)
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    size_t begin = (size_t)chunk + page;
+    size_t end = (size_t)chunk + MEM_NUMA_ALIGN + chunk->carved;
+
+    /* 只有切分过的部分被写入过，其中空闲内存已归还的系统页不重复计算 */
+    end = (end + page - 1) & ~(page - 1);
+    if (end <= begin || madvise((void *)begin, (size_t)chunk + chunk->size - begin, MADV_DONTNEED)) {
+        return 0;
+    }
+
+    return end - begin > chunk->released ? end - begin - chunk->released : 0;
+#else
+    (void)chunk;
+    return 0;
+#endif /* __linux__ */
+}
+
+MEM_NUMA_CHUNK *chunk_find(MEM_NUMA_CHUNK **chunks, size_t count, void *ptr)
+{
+    size_t low = 0;
+    size_t high = count;
+    size_t mid = 0;
+    unsigned char *addr = (unsigned char *)ptr;
+
+    while (low < high) {
+        mid = low + (high - low) / 2;
+
+        if (addr < (unsigned char *)chunks[mid]) {
+            high = mid;
+        } else if (addr >= (unsigned char *)chunks[mid] + chunks[mid]->size) {
+            low = mid + 1;
+        } else {
+            return chunks[mid];
+        }
+    }
+
+    return NULL;
+}
+
+int compare_chunk(const void *a, const void *b)
+{
+    const MEM_NUMA_CHUNK *ca = *(const MEM_NUMA_CHUNK **)a;
+    const MEM_NUMA_CHUNK *cb = *(const MEM_NUMA_CHUNK **)b;
+
+    if (ca == cb) {
+        return 0;
+    }
+
+    return ca < cb ? -1 : 1;
+}
+
+MEM_NUMA_BUCKET *pool_bucket(MEM_NUMA_POOL *pool, size_t size)
+{
+    int i;
+
+    for (i = 0; i < MEM_NUMA_BUCKET_COUNT; i++) {
+        if (pool->bucket[i].size == size) {
+            return pool->bucket + i;
+        }
+
+        if (!pool->bucket[i].size) {
+            pool->bucket[i].size = size;
+            return pool->bucket + i;
+        }
+    }
+
+    return NULL;
+}
+
+/*===========================================================================*/
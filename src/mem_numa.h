@@ -0,0 +1,45 @@
+#ifndef __MEM_NUMA_H__
+#define __MEM_NUMA_H__
+
+#include <stddef.h>
+
+/*===========================================================================*/
+/* NUMA 节点内存池 */
+/*===========================================================================*/
+
+#define MEM_NUMA_MAX_NODE 8             /* 支持的最大节点数量 */
+
+/*
+ * 初始化 NUMA 模式，通过 get_mempolicy 获取当前进程可用的节点，
+ * 可用节点不超过 1 个时返回 MEM_FAILED，分配器维持普通模式；编译时
+ * 定义 MEM_NUMA_FORCE_POOL=1 则单节点也进入内存池模式
+ */
+int mem_numa_init();
+
+/* 释放所有节点内存池并退出 NUMA 模式 */
+void mem_numa_clear();
+
+/* 是否处于 NUMA 模式 */
+int mem_numa_enabled();
+
+/* 获取可用节点数量，非 NUMA 模式下为 1 */
+int mem_numa_node_count();
+
+/* 获取当前线程所属节点，线程首次调用时确定，之后保持不变 */
+int mem_numa_current_node();
+
+/* 从节点内存池中分配一段内存，内存通过 mbind 绑定在该节点上 */
+void *mem_numa_alloc(int node, size_t size);
+
+/* 将内存归还给节点内存池，size 必须与分配时一致 */
+void mem_numa_free(int node, void *ptr, size_t size);
+
+/*
+ * 将内存池中空闲内存的物理页归还给系统，返回归还的字节数；已切分的
+ * 内存全部空闲的内存区整体归还，调用方需持有分配器锁
+ */
+size_t mem_numa_trim();
+
+/*===========================================================================*/
+
+#endif /* __MEM_NUMA_H__ */
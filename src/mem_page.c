@@ -12,6 +12,10 @@
 #include "mem.h"
 #include "link.h"
 #include "mem_page.h"
+#include "mem_numa.h"
+#include "mem_site.h"
+#include "mem_erase.h"
+#include "mem_probe.h"
 
 /*===========================================================================*/
 
@@ -36,12 +40,6 @@ typedef uintptr_t MEM_UINTPTR;
 typedef unsigned long MEM_UINTPTR;
 #endif /* WIN32 & Linux */
 
-#if defined(WIN32)
-#define CH_SEP  '\\'
-#else /* Linux */
-#define CH_SEP  '/'
-#endif /* WIN32 & Linux */
-
 /*===========================================================================*/
 
 /* 初始化内存块填充值 */
@@ -79,6 +77,21 @@ typedef unsigned long MEM_UINTPTR;
 #define ADDR_TO_MEM(ptr, addr) \
     *((unsigned long long *)(ptr)) = (unsigned long long)(MEM_UINTPTR)(addr)
 
+/* 是否开启缓存着色，关闭时所有内存页的第一个内存块紧跟在头部之后 */
+#ifndef MEM_PAGE_COLORING
+#define MEM_PAGE_COLORING 1
+#endif /* MEM_PAGE_COLORING */
+
+/* 缓存着色的步长，即缓存行大小 */
+#define MEM_PAGE_COLOR_SIZE 64
+
+/* L1 数据缓存一路的容量（缓存组数 × 缓存行大小），地址相差其整数倍时落在同一缓存组 */
+#define MEM_PAGE_COLOR_SPAN 4096
+
+/* 内存页中第一个内存块的地址，头部之后留有 color 个缓存行的着色偏移 */
+#define PAGE_FIRST_BLOCK(page) \
+    BYTE_OFFSET((page), sizeof(MEM_PAGE) + (page)->color * MEM_PAGE_COLOR_SIZE)
+
 /*===========================================================================*/
 
 /*
@@ -101,19 +114,22 @@ typedef unsigned long MEM_UINTPTR;
  *
  * 内存页面的管理遵循以下方式：
  *
- * 1.多个相同规格的内存页组成一个内存页链表，多个内存页链表组成一张
- * 内存页映射表，结构如下所示：
+ * 1.多个相同规格的内存页组成一个内存页链表组，每组按内存页状态分为
+ * 空闲、部分使用和已满三条链表，多个链表组组成一张内存页映射表，结构
+ * 如下所示：
  * 
- * MEM_PAGE_LINK1 --- PAGE0 -- PAGE1 -- PAGE2 -- ... -- TAIL
- *        |
- * MEM_PAGE_LINK2 --- PAGE0 -- PAGE1 -- PAGE2 -- ... -- TAIL
+ * MEM_PAGE_LINK1 -+- IDLE  --- PAGE0 -- PAGE1 -- ... -- TAIL
+ *        |        +- USING --- PAGE0 -- PAGE1 -- ... -- TAIL
+ *        |        +- FULL  --- PAGE0 -- PAGE1 -- ... -- TAIL
  *        |
- * MEM_PAGE_LINK3 --- PAGE0 -- PAGE1 -- PAGE2 -- ... -- TAIL
+ * MEM_PAGE_LINK2 -+- IDLE  --- PAGE0 -- PAGE1 -- ... -- TAIL
+ *        |        +- USING --- PAGE0 -- PAGE1 -- ... -- TAIL
+ *        |        +- FULL  --- PAGE0 -- PAGE1 -- ... -- TAIL
  *        |
  *        .
  *        .
  *        |
- * MEM_PAGE_LINKn --- PAGE0 -- PAGE1 -- PAGE2 -- ... -- TAIL
+ * MEM_PAGE_LINKn -+- ...
  *
  * 2.内存页链表的检索方式：
  *        主要通过内存页信息索引表 mem_page_info_index 来快速获取映射表
@@ -135,13 +151,16 @@ typedef unsigned long MEM_UINTPTR;
  *        2.5 在调整内存分页情况时应直接重新设计表结构，无需更改代码；
  *
  * 3.内存页链表的管理方式：
- *        链表的的尾指针总是指向填满数据（也就是 status = MEM_PAGE_STATUS_FULL）
- * 的内存页，头指针则指向最近操作的内存块所属的内存页，新申请的内存页
- * 节点优先放在当前链表的第二个节点，除非当前链表的头结点页处于 
- * MEM_PAGE_STATUS_FULL 状态或者当前链表没有任何内存页， 这样的话保证在
- * 申请内存时可以以 O(1) 的时间取到对应的内存页；同时，当释放内存时，
- * 如果处于空闲内存状态的内存页多于一定数量时，将之释放交还给系统以
- * 节约内存；
+ *        内存页所在的链表由其状态决定（链表下标即 status），只有状态
+ * 发生变化时（空闲 -> 部分使用 -> 已满，或者反过来）才会在链表之间
+ * 移动，在同一状态内的分配和释放不做任何链表操作；
+ *        申请内存时优先从部分使用链表的头结点分配，没有部分使用的内存
+ * 页时才启用空闲链表中的内存页，二者均为 O(1)。已满的内存页释放出一
+ * 个内存块后插入部分使用链表的头部，此时它是占用率最高的内存页；由空
+ * 闲转为部分使用的内存页则接在尾部，这样分配会集中在较满的内存页上，
+ * 较空的内存页得以逐渐排空并回收；
+ *        当释放内存时，如果处于空闲状态的内存页多于一定数量时，将之释
+ * 放交还给系统以节约内存；
  *
  * 4.内存页的管理方式：
  *        初始化内存页时，每个内存块会记录下一个空闲内存块的地址（通过
@@ -159,6 +178,8 @@ struct mem_page_st {
     unsigned char status;       /* 内存页状态 */
     unsigned char using_count;  /* 已分配的内存块数量 */
     unsigned char block_num;    /* 当前内存页内存块数量 */
+    unsigned char node;         /* 内存页所属的 NUMA 内存池 */
+    unsigned char color;        /* 第一个内存块的着色偏移，单位为缓存行 */
     int block_head;             /* 单位内存块头部大小 */
     int block_data;             /* 单位内存块数据大小 */
     int alloc_size;             /* 当前申请的数据空间大小 */
@@ -170,34 +191,67 @@ struct mem_page_st {
 /* 内存块 */
 struct mem_block_st {
     MEM_PAGE *page;             /* 所属 page */
-    int status;                 /* 内存块状态 */
+    unsigned short status;      /* 内存块状态 */
+    unsigned short flag;        /* 内存块标记 */
+    unsigned int size;          /* 申请的字节数，大内存以内存页中的记录为准 */
 };
 
 #define DATE_INFO_LENGTH 32
-#define FILE_INFO_LENGTH 64
-#define FUNC_INFO_LENGTH 64
 
-/* 调试内存块 */
+/*
+ * 调试内存块
+ *
+ * 文件、函数和行数登记为调用位置后只保存指针，分配时刻保存单调时钟
+ * 的原始值，打印时再格式化，见 mem_site.h。
+ */
 struct mem_block_dbg_st {
     MEM_PAGE *page;             /* 内存页的地址 */
-    int status;                 /* 内存块状态 */
-    int line;                   /* 调用 malloc 的行数 */
+    unsigned short status;      /* 内存块状态 */
+    unsigned short flag;        /* 内存块标记 */
+    unsigned int size;          /* 申请的字节数 */
+    const MEM_SITE *site;       /* 调用 malloc 的位置 */
+    unsigned long long time;    /* 调用时间，单位为纳秒的单调时钟 */
     unsigned long long thread;  /* 调用 malloc 的线程 */
-
-    char date[DATE_INFO_LENGTH]; /* 调用时间，格式为 yyyy-mm-dd hh:MM:ss */
-    char file[FILE_INFO_LENGTH]; /* 所属文件 */
-    char func[FUNC_INFO_LENGTH]; /* 所属函数 */
 };
 
 /* 内存页链表，继承自 LINK */
-struct mem_page_link_st {
+typedef struct {
     MEM_PAGE *head; /* 表头 */
     MEM_PAGE *tail; /* 表尾 */
 
     int count;      /* 节点总数 */
-    int idle_num;   /* 有空闲内存块的节点总数 */
+} MEM_PAGE_LIST;
+
+#define MEM_PAGE_LIST_COUNT 3   /* 每组链表数量，与内存页状态一一对应 */
+
+/* 同一规格的内存页链表组，list 以内存页状态 status 为下标 */
+struct mem_page_link_st {
+    MEM_PAGE_LIST list[MEM_PAGE_LIST_COUNT]; /* 空闲、部分使用、已满 */
+
+    int count;      /* 内存页总数 */
 };
 
+/* 获取内存页链表组中的链表 */
+#define GET_PAGE_LIST(link, status) ((LINK *)((link)->list + (status)))
+
+/* 内存分类统计信息 */
+typedef struct {
+    unsigned long long alloc_count; /* 累计分配次数 */
+    unsigned long long free_count;  /* 累计释放次数 */
+    unsigned long long live_bytes;  /* 正在使用的字节数 */
+    unsigned long long large_bytes; /* 正在使用的大内存字节数 */
+    unsigned long long requested_bytes; /* 正在使用的内存块申请的字节数 */
+} MEM_PAGE_STAT;
+
+/* 内存预算，字节数为内存页与大内存数据区向系统申请的总量 */
+typedef struct {
+    size_t used;        /* 已申请的字节数 */
+    size_t soft_limit;  /* 软限制，0 表示不限制 */
+    size_t hard_limit;  /* 硬限制，0 表示不限制 */
+    int over_soft;      /* 是否处于软限制之上 */
+    int crossed;        /* 越过软限制后尚未取走的通知 */
+} MEM_PAGE_BUDGET;
+
 /* 内存页信息 */
 typedef struct {
     int page_type;  /* 内存页类型 */
@@ -214,14 +268,18 @@ typedef struct {
 #define MEM_PAGE_MAX_BLOCK 512          /* 内存页可复用的最大内存块申请大小 */
 #define MEM_PAGE_MAX_IDLE 2             /* 每个链表最大空闲页数量 */
 
+/* 统计信息的分类数量需与内存页信息表一致 */
+typedef char mem_stats_class_check[
+    (MEM_STATS_CLASS_COUNT == MEM_PAGE_BLOCK_INFO_COUNT) ? 1 : -1];
+
 /*===========================================================================*/
 
 /*
  * 内存页信息索引表，用于快速查找对应的内存块分类信息，这个表的
  * 索引为：申请长度（对齐之后） / 8 ，值为 mem_page_info_list 表的
- * 索引。
+ * 索引；加载自定义分类表时重新生成。
  */
-static const unsigned char mem_page_info_index[MEM_PAGE_MAP_INDEX_COUNT] = {
+static unsigned char mem_page_info_index[MEM_PAGE_MAP_INDEX_COUNT] = {
      0,
      1,  2,  3,  3,  4,  4,  4,  4,    /*   1 ~ 8   */
      5,  5,  5,  5,  6,  6,  6,  6,    /*   9 ~ 16  */    
@@ -233,8 +291,8 @@ static const unsigned char mem_page_info_index[MEM_PAGE_MAP_INDEX_COUNT] = {
     13, 13, 13, 13, 13, 13, 13, 13    /*  57 ~ 64  */
 };
 
-/* 内存页分类信息表 */
-static const MEM_PAGE_INFO mem_page_info_list[MEM_PAGE_BLOCK_INFO_COUNT] = {
+/* 内存页分类信息表，1 ~ 13 项可由 page_class_load 替换 */
+static MEM_PAGE_INFO mem_page_info_list[MEM_PAGE_BLOCK_INFO_COUNT] = {
     /* 内存页类型        单位内存块尺寸        内存块总大小    内存块数量*/
     { MEM_PAGE_TYPE_ZERO,        8,                   8,              1    },    /* 0  */
     { MEM_PAGE_TYPE_1K,          8,                1024,            128    },    /* 1  */
@@ -253,8 +311,26 @@ static const MEM_PAGE_INFO mem_page_info_list[MEM_PAGE_BLOCK_INFO_COUNT] = {
     { MEM_PAGE_TYPE_LARGE,      8,                   8,               1    },    /* 14 */
 };
 
-/* 内存页映射表 */
-static MEM_PAGE_LINK mem_page_map[MEM_PAGE_BLOCK_INFO_COUNT] = { { 0 } };
+/* 内存页映射表，每个 NUMA 节点一张，非 NUMA 模式下只使用第一张 */
+static MEM_PAGE_LINK mem_page_map[MEM_NUMA_MAX_NODE][MEM_PAGE_BLOCK_INFO_COUNT];
+
+/* 获取节点对应的内存页链表 */
+#define GET_PAGE_LINK(node, index) (mem_page_map[(node)] + (index))
+
+/* 获取当前线程所属节点的内存页链表 */
+#define GET_LOCAL_PAGE_LINK(index) GET_PAGE_LINK(mem_numa_current_node(), (index))
+
+/* 内存分类统计表，与分配和释放在同一把锁内更新 */
+static MEM_PAGE_STAT mem_page_stat[MEM_PAGE_BLOCK_INFO_COUNT] = { { 0 } };
+
+/* 内存预算，与分配和释放在同一把锁内更新 */
+static MEM_PAGE_BUDGET mem_page_budget = { 0 };
+
+/* 申请尺寸直方图，索引与 mem_page_info_index 相同，值为累计申请次数 */
+static unsigned long long mem_page_hist[MEM_PAGE_MAP_INDEX_COUNT] = { 0 };
+
+/* 每个分类已着色的内存页数量，用于轮转颜色 */
+static unsigned int mem_page_color[MEM_PAGE_BLOCK_INFO_COUNT] = { 0 };
 
 /*===========================================================================*/
 
@@ -262,6 +338,24 @@ static MEM_PAGE_LINK mem_page_map[MEM_PAGE_BLOCK_INFO_COUNT] = { { 0 } };
 static void mem_page_initialize(int index, MEM_PAGE *page, int dbg);
 static void mem_page_terminate(MEM_PAGE *page);
 
+/* 向内存预算申请字节数，超过硬限制时返回 MEM_FAILED */
+static int budget_reserve(size_t size);
+
+/* 向内存预算归还字节数 */
+static void budget_release(size_t size);
+
+/* 内存页状态变化后将其移动到对应的链表，front 为真时插入表头 */
+static void page_move(MEM_PAGE_LINK *link, MEM_PAGE *page, unsigned char status, int front);
+
+/* 按链表顺序遍历链表组中的内存页，page 为 NULL 时返回第一页 */
+static MEM_PAGE *page_link_next(MEM_PAGE_LINK *link, MEM_PAGE *page);
+
+/* 计算内存页的总大小 */
+static int get_page_size(int index, int dbg);
+
+/* 按内存块尺寸填充分类信息，尺寸为 0 表示该分类不使用 */
+static void class_fill(MEM_PAGE_INFO *info, int block_size);
+
 /* 获取内存块 */
 static MEM_BLOCK *get_block(void *address, int dbg);
 
@@ -274,6 +368,9 @@ static const char *get_page_name(unsigned char type);
 static const char *get_status_name(unsigned char status);
 static const char *get_block_status_name(int status);
 
+/* 遍历内存页中正在使用的内存块 */
+static void walk_page_blocks(MEM_PAGE *page, MEM_BLOCK_VISIT visit, void *arg);
+
 /* 打印泄漏信息 */
 static int print_leak_info(MEM_PAGE *page, int dbg, char *buff);
 
@@ -287,8 +384,8 @@ static void print_page_info(MEM_PAGE *page, char *buff);
 /* 输出内存信息 */
 static void output_mem_info_std(const char *info);
 
-/* 获取当前格式化时间 */
-int get_curtime(const char *format, char *buf, int len);
+/* 格式化内存信息 */
+const char *format_mem_info(char *buff, int size, const char *info, ...);
 
 /*===========================================================================*/
 
@@ -325,27 +422,23 @@ int get_page_index_ex(MEM_PAGE *page)
 
 int usable_page_exist(int index)
 {
-    if (index > MEM_PAGE_BLOCK_INFO_COUNT - 1) {
-        return 0;
-    }
+    MEM_PAGE_LINK *link = NULL;
 
-    if (!mem_page_map[index].count || 
-        !mem_page_map[index].head) {
+    if (index > MEM_PAGE_BLOCK_INFO_COUNT - 1) {
         return 0;
     }
 
-    if ((mem_page_map[index].head)->status == MEM_PAGE_STATUS_FULL) {
-        return 0;
-    }
+    link = GET_LOCAL_PAGE_LINK(index);
 
-    return 1;
+    return link->list[MEM_PAGE_STATUS_USING].count > 0 ||
+           link->list[MEM_PAGE_STATUS_IDLE].count > 0;
 }
 
 int mem_page_malloc(int index, int dbg)
 {
     int ret = MEM_SUCCESS;
     int page_size = 0;
-    int block_size = 0;
+    int node = 0;
 
     MEM_PAGE_LINK *link = NULL;
     MEM_PAGE *idle_page = NULL;
@@ -354,45 +447,50 @@ int mem_page_malloc(int index, int dbg)
         return MEM_FAILED;
     }
 
-    block_size = dbg ? sizeof(MEM_BLOCK_DBG) : sizeof(MEM_BLOCK);
+    /* 获取当前线程所属节点的内存页链表 */
+    node = mem_numa_current_node();
+    link = GET_PAGE_LINK(node, index);
 
-    /* 获取对应的内存页链表 */
-    link = mem_page_map + index;
+    page_size = get_page_size(index, dbg);
 
-    /* 内存页大小 = 内存块总大小 + 每个内存块头部大小 + 内存页头部大小 */
-    page_size = 
-        mem_page_info_list[index].total_size + 
-        block_size * mem_page_info_list[index].block_num +
-        sizeof(MEM_PAGE);
+    /* 超过硬限制时直接失败，由调用方返回 NULL */
+    if (budget_reserve((size_t)page_size) != MEM_SUCCESS) {
+        return MEM_FAILED;
+    }
 
-    /* 创建内存页 */
-    idle_page = (MEM_PAGE *)malloc(page_size);
-    assert(idle_page);
+    /* 创建内存页，NUMA 模式下从节点内存池中分配 */
+    if (mem_numa_enabled()) {
+        idle_page = (MEM_PAGE *)mem_numa_alloc(node, page_size);
+    } else {
+        idle_page = (MEM_PAGE *)malloc(page_size);
+    }
+
+    if (!idle_page) {
+        budget_release((size_t)page_size);
+        return MEM_FAILED;
+    }
 
     memset(idle_page, 0, page_size);
     mem_page_initialize(index, idle_page, dbg);
+    idle_page->node = (unsigned char)node;
 
-    /* 
-     * 将新创建的内存页链接到头结点之后的位置，如果链表没有节点，
-     * 或者节点状态均为 FULL，则以新节点作为链表头结点。
-     */
-    if (!link->head || link->head->status == MEM_PAGE_STATUS_FULL) {
-        ret = link_insert((LINK *)link, 0, (LINK_NODE *)idle_page);
-    } else {
-        ret = link_insert_after(
-            (LINK *)link, (LINK_NODE *)link->head, (LINK_NODE *)idle_page);
-    }
+    /* 新创建的内存页放入空闲链表的头部 */
+    ret = link_push_front(
+        GET_PAGE_LIST(link, MEM_PAGE_STATUS_IDLE), (LINK_NODE *)idle_page);
 
     if (ret == MEM_SUCCESS) {
-        link->idle_num++;
+        link->count++;
     }
 
+    MEM_PROBE3(page_create, idle_page, index, node);
     return ret;
 }
 
 int mem_page_free(MEM_PAGE *page)
 {
     int index = 0;
+    int node = 0;
+    int dbg = 0;
     MEM_PAGE_LINK *link = NULL;
 
     if (!page) {
@@ -404,56 +502,91 @@ int mem_page_free(MEM_PAGE *page)
         return MEM_FAILED;
     }
 
-    link = mem_page_map + index;
+    node = page->node;
+    dbg = page->block_head != sizeof(MEM_BLOCK);
+
+    link = GET_PAGE_LINK(node, index);
     link_remove_force(
-            (LINK *)link, (LINK_NODE *)page);
+            GET_PAGE_LIST(link, page->status), (LINK_NODE *)page);
 
-    if (page->status == MEM_PAGE_STATUS_IDLE) {
-        link->idle_num--;
-    }
+    link->count--;
 
+    MEM_PROBE3(page_release, page, index, node);
     mem_page_terminate(page);
-    free(page);
+
+    budget_release((size_t)get_page_size(index, dbg));
+
+    /* NUMA 模式下内存页归还给所属节点的内存池 */
+    if (mem_numa_enabled()) {
+        mem_numa_free(node, page, get_page_size(index, dbg));
+    } else {
+        free(page);
+    }
 
     return MEM_SUCCESS;
 }
 
+int page_enable_numa()
+{
+    int i;
+
+    /* 已有内存页时不允许切换模式 */
+    for (i = 0; i < MEM_PAGE_BLOCK_INFO_COUNT; i++) {
+        if (GET_PAGE_LINK(0, i)->count > 0) {
+            return MEM_FAILED;
+        }
+    }
+
+    return mem_numa_init();
+}
+
 void clear_mem_pages()
 {
     int i;
+    int node;
 
     MEM_PAGE_LINK *link = NULL;
+    MEM_PAGE *page = NULL;
     unsigned char *tmp  = NULL;
 
-    for (i = 0; i < MEM_PAGE_BLOCK_INFO_COUNT; i++) {
-        link = mem_page_map + i;
-
-        while (link->count > 0) {
-            if (link->head->type == MEM_PAGE_TYPE_ZERO ||
-                link->head->type == MEM_PAGE_TYPE_LARGE) {
-                /* 指针偏移至内存块的数据区 */
-                tmp = BYTE_OFFSET(link->head, sizeof(MEM_PAGE) + link->head->block_head);
-
-                /* 获取大内存或 0 内存的地址 */
-                tmp = MEM_TO_ADDR(tmp);
-                if (tmp) {
-                    tmp = BYTE_OFFSET(tmp, link->head->block_head);
-                    free_block(tmp, link->head->block_head != sizeof(MEM_BLOCK));
-                } 
+    for (node = 0; node < mem_numa_node_count(); node++) {
+        for (i = 0; i < MEM_PAGE_BLOCK_INFO_COUNT; i++) {
+            link = GET_PAGE_LINK(node, i);
+
+            while ((page = page_link_next(link, NULL)) != NULL) {
+                if ((page->type == MEM_PAGE_TYPE_ZERO ||
+                     page->type == MEM_PAGE_TYPE_LARGE) && page->using_count) {
+                    /* 指针偏移至内存块的数据区 */
+                    tmp = BYTE_OFFSET(PAGE_FIRST_BLOCK(page), page->block_head);
+
+                    /* 
+                     * 获取大内存或 0 内存的地址并释放，释放后内存页可能
+                     * 已经归还，需要重新获取链表中的内存页
+                     */
+                    tmp = MEM_TO_ADDR(tmp);
+                    tmp = BYTE_OFFSET(tmp, page->block_head);
+                    free_block(tmp, page->block_head != sizeof(MEM_BLOCK));
+                    continue;
+                }
+
+                mem_page_free(page);
             }
 
-            mem_page_free(link->head);
+            memset(link, 0, sizeof(MEM_PAGE_LINK));
         }
-
-        link->idle_num = 0;
-        link_reset((LINK *)link);
     }
+
+    memset(mem_page_stat, 0, sizeof(mem_page_stat));
 }
 
 void *alloc_block(size_t len)
+{
+    return alloc_block_index(get_page_index(len), len);
+}
+
+void *alloc_block_index(int index, size_t len)
 {
     size_t size = 0;
-    int index = 0;
 
     unsigned char *ret  = NULL;
     MEM_PAGE *page = NULL;
@@ -461,41 +594,53 @@ void *alloc_block(size_t len)
 
     MEM_BLOCK_DBG *block_dbg  = NULL;
     MEM_BLOCK *block = NULL;
+    MEM_BLOCK *large = NULL;
 
-    index = get_page_index(len);
-    if (index > MEM_PAGE_BLOCK_INFO_COUNT - 1) {
+    if (index < 0 || index > MEM_PAGE_BLOCK_INFO_COUNT - 1) {
         return NULL;
     }
 
-    link = mem_page_map + index;
+    link = GET_LOCAL_PAGE_LINK(index);
 
-    if (!link->count || !link->head) {
-        return NULL;
+    /* 优先使用部分使用的内存页，没有时再启用空闲内存页 */
+    page = link->list[MEM_PAGE_STATUS_USING].head;
+    if (!page) {
+        page = link->list[MEM_PAGE_STATUS_IDLE].head;
     }
 
-    page = link->head;
-    if (page->status == MEM_PAGE_STATUS_FULL) {
+    if (!page) {
         return NULL;
     }
 
-    /*
-     * 如果当前页可用内存块达到上限，则将当前的内存页
-     * 调整至链表表尾
+    /* 
+     * 0 内存和大内存先申请数据区，超过硬限制或者申请失败时
+     * 内存页保持原状，直接返回 NULL
      */
-    if (page->using_count == (page->block_num - 1)) {
-        if (link->count > 1 && link->tail != page) {
-            link_remove_force((LINK *)link, (LINK_NODE *)page);
-            link_push((LINK *)link, (LINK_NODE *)page);
+    if (page->type == MEM_PAGE_TYPE_ZERO ||
+        page->type == MEM_PAGE_TYPE_LARGE) {
+        size = page->block_head + len;
+        if (budget_reserve(size) != MEM_SUCCESS) {
+            return NULL;
         }
 
-        page->status = MEM_PAGE_STATUS_FULL;
+        large = (MEM_BLOCK *)malloc(size);
+        if (!large) {
+            budget_release(size);
+            return NULL;
+        }
+
+        MEM_PROBE2(large_alloc, large, size);
     }
 
-    if (!page->using_count) {
-        link->idle_num--;
-        if (page->block_num > 1) {
-            page->status = MEM_PAGE_STATUS_USING;
-        }
+    /*
+     * 内存页状态变化时才调整所在链表：
+     * 可用内存块达到上限的内存页移入已满链表，空闲内存页
+     * 移入部分使用链表的尾部。
+     */
+    if (page->using_count == (page->block_num - 1)) {
+        page_move(link, page, MEM_PAGE_STATUS_FULL, 1);
+    } else if (!page->using_count) {
+        page_move(link, page, MEM_PAGE_STATUS_USING, 0);
     }
 
     page->using_count++;
@@ -510,6 +655,8 @@ void *alloc_block(size_t len)
     /* 修改内存块的状态 */
     block = (MEM_BLOCK *)ret;
     block->status = MEM_BLOCK_STATUS_USING;
+    block->flag = 0;
+    block->size = (unsigned int)len;
 
     /* 定位到数据区位置 */
     ret = BYTE_OFFSET(ret, page->block_head);
@@ -532,12 +679,11 @@ void *alloc_block(size_t len)
      */
     if (page->type == MEM_PAGE_TYPE_ZERO ||
         page->type == MEM_PAGE_TYPE_LARGE) {
-        size = page->block_head + len;
-        block = (MEM_BLOCK *)malloc(size);
-        assert(block);
-
+        block = large;
         block->page = page;
         block->status = MEM_BLOCK_STATUS_USING;
+        block->flag = 0;
+        block->size = (unsigned int)len;
 
         /* 填充 debug 内存块 */
         if (page->block_head == sizeof(MEM_BLOCK_DBG)) {
@@ -557,9 +703,21 @@ void *alloc_block(size_t len)
 
         /* 初始化空闲内存块 */
         memset(ret, INIT_BLOCK_PADDING, len);
+
+        mem_page_stat[index].live_bytes += len;
+        mem_page_stat[index].large_bytes += len;
     } else {
         /* 初始化空闲内存块 */
         memset(ret, INIT_BLOCK_PADDING, (size_t)page->block_data);
+
+        mem_page_stat[index].live_bytes += page->block_data;
+    }
+
+    mem_page_stat[index].requested_bytes += len;
+    mem_page_stat[index].alloc_count++;
+
+    if (len <= MEM_PAGE_MAX_BLOCK) {
+        mem_page_hist[INT_ALIGN(len) >> 3]++;
     }
 
     return ret;
@@ -567,6 +725,8 @@ void *alloc_block(size_t len)
 
 void *alloc_block_dbg(size_t len, const char *func, const char *file, int line)
 {
+    size_t size = 0;
+
     MEM_PAGE *page  = NULL;
     MEM_BLOCK_DBG *block = NULL;
     unsigned char *ret = alloc_block(len);
@@ -583,16 +743,22 @@ void *alloc_block_dbg(size_t len, const char *func, const char *file, int line)
 
     if (page->type == MEM_PAGE_TYPE_ZERO ||
         page->type == MEM_PAGE_TYPE_LARGE) {
-        block = (MEM_BLOCK_DBG *)BYTE_OFFSET(page, sizeof(MEM_PAGE));
+        block = (MEM_BLOCK_DBG *)PAGE_FIRST_BLOCK(page);
+        size = len;
+    } else {
+        size = (size_t)page->block_data;
     }
 
     pad_dbg_block(block, func, file, line);
+    mem_site_alloc(block->site, size);
+
     return ret;
 }
 
 void free_block(void *address, int dbg)
 {
     int index = 0;
+    int size = 0;
 
     MEM_UINTPTR idle = 0;
     MEM_PAGE *page = NULL;
@@ -622,15 +788,25 @@ void free_block(void *address, int dbg)
         return;
     }
 
-    link = mem_page_map + index;
+    /* 内存块归还到所属内存页的节点链表 */
+    link = GET_PAGE_LINK(page->node, index);
 
     /* 大内存或者 0 内存直接释放内存，同时覆写该内存页的内存块内容 */
     if (page->type == MEM_PAGE_TYPE_ZERO ||
         page->type == MEM_PAGE_TYPE_LARGE) {
-        free(cursor);
+        /* 大内存的实际尺寸 = 总申请大小 - 两个内存块头部 - 页内内存块 */
+        size = page->alloc_size - 2 * page->block_head - page->block_data;
+
+        /* 原地 realloc 后申请长度可能小于数据区，需在归还之前读取 */
+        mem_page_stat[index].requested_bytes -= block->size;
+        mem_scrub_free(cursor, (size_t)(page->block_head + size));
+
+        budget_release((size_t)(page->block_head + size));
+        mem_page_stat[index].live_bytes -= size;
+        mem_page_stat[index].large_bytes -= size;
 
         /* 重新定位 block 位置 */
-        block  = (MEM_BLOCK *)BYTE_OFFSET(page, sizeof(MEM_PAGE));
+        block  = (MEM_BLOCK *)PAGE_FIRST_BLOCK(page);
         cursor = (unsigned char *)block;
 
         /* 这种情况下，由于一个内存页只带有一个内存块，所以可以直接赋 0 */
@@ -657,15 +833,24 @@ void free_block(void *address, int dbg)
             ADDR_TO_MEM(cursor, idle);
         }
 
+        size = page->block_data;
+
         page->alloc_size -= (page->block_data + page->block_head);        
+        mem_page_stat[index].live_bytes -= page->block_data;
+        mem_page_stat[index].requested_bytes -= block->size;
     }
 
+    mem_page_stat[index].free_count++;
+
     /* 还原内存块状态 */
     block->status = MEM_BLOCK_STATUS_IDLE;
+    block->flag = 0;
+    block->size = 0;
 
     /* dbg 模式还原内存块头部信息区域 */
     if (dbg) {
         block_dbg = (MEM_BLOCK_DBG *)block;
+        mem_site_free(block_dbg->site, (size_t)size);
         pad_dbg_block(block_dbg, NULL, NULL, 0);
     }
 
@@ -674,34 +859,26 @@ void free_block(void *address, int dbg)
     page->using_count--;
 
     /*
-     * 不论当前内存页是什么状态，直接将当前内存页换到
-     * 内存链表的头结点。
+     * 内存页状态变化时才调整所在链表：
+     * 排空的内存页移入空闲链表，刚从已满状态释放出内存块的
+     * 内存页占用率最高，插入部分使用链表的头部优先分配。
      */
-    if (link->count > 1 && link->head != page) {
-        link_remove_force((LINK *)link, (LINK_NODE *)page);
-        link_insert((LINK *)link, 0, (LINK_NODE *)page);
-    }
-
-    /* 更改内存页的状态 */
-    if (page->using_count == (page->block_num - 1)) {
-        page->status = MEM_PAGE_STATUS_USING;
-    }
-
     if (!page->using_count) {
-        link->idle_num++;
-        page->status = MEM_PAGE_STATUS_IDLE;
+        page_move(link, page, MEM_PAGE_STATUS_IDLE, 1);
 
-        /* 超过一个空闲页面则释放本页面以节省空间 */
-        if (link->idle_num > MEM_PAGE_MAX_IDLE) {
+        /* 空闲页面超过上限则释放本页面以节省空间 */
+        if (link->list[MEM_PAGE_STATUS_IDLE].count > MEM_PAGE_MAX_IDLE) {
             mem_page_free(page);
         }
+    } else if (page->status == MEM_PAGE_STATUS_FULL) {
+        page_move(link, page, MEM_PAGE_STATUS_USING, 1);
     }
 }
 
 void page_print_basic_info(int dbg)
 {
     int i;
-    int j;
+    int node;
 
     char buff[128] = { 0 };
 
@@ -710,37 +887,31 @@ void page_print_basic_info(int dbg)
 
     output_mem_info_std("<============================basic check============================>\n");
 
-    for (i = 0; i < MEM_PAGE_BLOCK_INFO_COUNT; i++) {
-        link = mem_page_map + i;
+    for (node = 0; node < mem_numa_node_count(); node++) {
+        for (i = 0; i < MEM_PAGE_BLOCK_INFO_COUNT; i++) {
+            link = GET_PAGE_LINK(node, i);
 
-        if(link->count > 0) {
-            sprintf(buff, "<----------------------link %02d---------------------->\n", i);
-            output_mem_info_std(buff);
-
-            /* 打印链表信息 */
-            print_link_info(link, i, buff);
-            page = link->head;
+            if(link->count > 0) {
+                sprintf(buff, "<----------------------link %02d---------------------->\n", i);
+                output_mem_info_std(buff);
 
-            for (j = 0; j < link->count; j++) {
-                if (!page) {
-                    output_mem_info_std("page = null!!!\n");
-                    break;
-                }
+                /* 打印链表信息 */
+                print_link_info(link, i, buff);
 
-                /* 打印内存页信息 */
-                output_mem_info_std("---------------------- page -----------------------\n");
-                print_page_info(page, buff);
+                for (page = page_link_next(link, NULL); page; page = page_link_next(link, page)) {
+                    /* 打印内存页信息 */
+                    output_mem_info_std("---------------------- page -----------------------\n");
+                    print_page_info(page, buff);
 
-                /* 打印内存泄漏信息 */
-                if (page->using_count > 0) {
-                    print_leak_info(page, dbg, buff);
+                    /* 打印内存泄漏信息 */
+                    if (page->using_count > 0) {
+                        print_leak_info(page, dbg, buff);
+                    }
                 }
-                page = page->next;
-            }
 
-            page = NULL;
-            sprintf(buff, "<----------------------link %02d---------------------->\n", i);
-            output_mem_info_std(buff);
+                sprintf(buff, "<----------------------link %02d---------------------->\n", i);
+                output_mem_info_std(buff);
+            }
         }
     }
 
@@ -749,8 +920,8 @@ void page_print_basic_info(int dbg)
 
 void page_print_block_list(int index, int dbg)
 {
-    int i;
     int j;
+    int node;
 
     char buff[128] = { 0 };
 
@@ -765,66 +936,61 @@ void page_print_block_list(int index, int dbg)
         return;
     }
 
-    link = mem_page_map + index;
-    page = link->head;
+    for (node = 0; node < mem_numa_node_count(); node++) {
+        link = GET_PAGE_LINK(node, index);
 
-    /* 链表信息 */
-    sprintf(buff, "<----------------------link %02d---------------------->\n", index);
-    output_mem_info_std(buff);
+        /* 链表信息 */
+        sprintf(buff, "<----------------------link %02d---------------------->\n", index);
+        output_mem_info_std(buff);
 
-    print_link_info(link, index, buff);
+        print_link_info(link, index, buff);
 
-    for (i = 0; i < link->count; i++) {
-        if (!page) {
-            output_mem_info_std("page = null!!!\n");
-            break;
-        }
+        for (page = page_link_next(link, NULL); page; page = page_link_next(link, page)) {
+            output_mem_info_std("---------------------- page -----------------------\n");
+            print_page_info(page, buff);
 
-        output_mem_info_std("---------------------- page -----------------------\n");
-        print_page_info(page, buff);
+            block = (MEM_BLOCK *)PAGE_FIRST_BLOCK(page);
 
-        block = (MEM_BLOCK *)BYTE_OFFSET(page, sizeof(MEM_PAGE));
+            output_mem_info_std("---------------------- block -----------------------\n");
 
-        output_mem_info_std("---------------------- block -----------------------\n");
-
-        for (j = 0; j < page->block_num; j++) {
-            sprintf(buff, "(%d) [%p] -- status = %s size = %d\n", 
-                j, block, get_block_status_name(block->status), page->block_data);
-            output_mem_info_std(buff);
-
-            if (page->type == MEM_PAGE_TYPE_ZERO ||
-                page->type == MEM_PAGE_TYPE_LARGE) {
-                if (page->alloc_size) {
-                    size = 
-                        page->alloc_size -
-                        page->block_head -
-                        page->block_head -
-                        page->block_data;
-
-                    cursor = BYTE_OFFSET(block, page->block_head);
-                    block = (MEM_BLOCK *)MEM_TO_ADDR(cursor);
+            for (j = 0; j < page->block_num; j++) {
+                sprintf(buff, "(%d) [%p] -- status = %s size = %d\n", 
+                    j, block, get_block_status_name(block->status), page->block_data);
+                output_mem_info_std(buff);
 
-                    sprintf(buff, "(%d) [%p] -- status = %s size = %d\n", 
-                        j + 1, block, get_block_status_name(block->status), size);
-                    output_mem_info_std(buff);
+                if (page->type == MEM_PAGE_TYPE_ZERO ||
+                    page->type == MEM_PAGE_TYPE_LARGE) {
+                    if (page->alloc_size) {
+                        size = 
+                            page->alloc_size -
+                            page->block_head -
+                            page->block_head -
+                            page->block_data;
+
+                        cursor = BYTE_OFFSET(block, page->block_head);
+                        block = (MEM_BLOCK *)MEM_TO_ADDR(cursor);
+
+                        sprintf(buff, "(%d) [%p] -- status = %s size = %d\n", 
+                            j + 1, block, get_block_status_name(block->status), size);
+                        output_mem_info_std(buff);
+                    }
+                } else {
+                    block = (MEM_BLOCK *)BYTE_OFFSET(block, page->block_head + page->block_data);
                 }
-            } else {
-                block = (MEM_BLOCK *)BYTE_OFFSET(block, page->block_head + page->block_data);
             }
+
+            output_mem_info_std("---------------------- block -----------------------\n");
         }
 
-        output_mem_info_std("---------------------- block -----------------------\n");
-        page = page->next;
+        sprintf(buff, "<----------------------link %02d---------------------->\n", index);
+        output_mem_info_std(buff);
     }
-
-    sprintf(buff, "<----------------------link %02d---------------------->\n", index);
-    output_mem_info_std(buff);
 }
 
 void page_print_allocated_info(int dbg)
 {
     int i;
-    int j;
+    int node;
     int size = 0;
 
     char buff[128] = { 0 };
@@ -835,28 +1001,18 @@ void page_print_allocated_info(int dbg)
     output_mem_info_std("<============================alloc check============================>\n");
 
     /* 遍历内存链表 */
-    for (i = 0; i < MEM_PAGE_BLOCK_INFO_COUNT; i++) {
-        link = mem_page_map + i;
-
-        if(link->count > 0) {
-            page = link->head;
-
-            for (j = 0; j < link->count; j++) {
-                if (!page) {
-                    break;
-                }
+    for (node = 0; node < mem_numa_node_count(); node++) {
+        for (i = 0; i < MEM_PAGE_BLOCK_INFO_COUNT; i++) {
+            link = GET_PAGE_LINK(node, i);
 
+            for (page = page_link_next(link, NULL); page; page = page_link_next(link, page)) {
                 /* 打印内存泄漏信息 */
                 if (page->using_count > 0) {
                     /* 打印内存页信息 */
                     print_page_info(page, buff);
                     size += print_leak_info(page, dbg, buff);
                 }
-
-                page = page->next;
             }
-
-            page = NULL;
         }
     }
 
@@ -867,6 +1023,354 @@ void page_print_allocated_info(int dbg)
     output_mem_info_std("<============================alloc check============================>\n");
 }
 
+void page_get_stats(struct mem_stats *stats)
+{
+    int i;
+    int node;
+
+    MEM_PAGE_LINK *link = NULL;
+    MEM_PAGE_STAT *stat = NULL;
+    struct mem_class_stats *info = NULL;
+
+    if (!stats) {
+        return;
+    }
+
+    memset(stats, 0, sizeof(struct mem_stats));
+    stats->class_count = MEM_PAGE_BLOCK_INFO_COUNT;
+
+    for (i = 0; i < MEM_PAGE_BLOCK_INFO_COUNT; i++) {
+        stat = mem_page_stat + i;
+        info = stats->classes + i;
+
+        info->block_size  = mem_page_info_list[i].block_size;
+        info->alloc_count = stat->alloc_count;
+        info->free_count  = stat->free_count;
+        info->live_blocks = stat->alloc_count - stat->free_count;
+        info->live_bytes  = stat->live_bytes;
+        info->large_bytes = stat->large_bytes;
+        info->requested_bytes = stat->requested_bytes;
+
+        /* 内存页数量汇总所有节点 */
+        for (node = 0; node < mem_numa_node_count(); node++) {
+            link = GET_PAGE_LINK(node, i);
+
+            info->page_count += link->count;
+            info->idle_pages += link->list[MEM_PAGE_STATUS_IDLE].count;
+        }
+    }
+}
+
+int page_class_load(const size_t *sizes, int count)
+{
+    int i;
+    int node;
+    int index = 1;
+
+    if (!sizes || count <= 0 || count > MEM_PAGE_BLOCK_INFO_COUNT - 2 ||
+        sizes[count - 1] != MEM_PAGE_MAX_BLOCK) {
+        return MEM_FAILED;
+    }
+
+    /* 尺寸须为 8 的倍数且严格递增 */
+    for (i = 0; i < count; i++) {
+        if (!sizes[i] || sizes[i] != INT_ALIGN(sizes[i]) ||
+            (i > 0 && sizes[i] <= sizes[i - 1])) {
+            return MEM_FAILED;
+        }
+    }
+
+    /* 已有内存页时不允许替换分类表 */
+    for (node = 0; node < mem_numa_node_count(); node++) {
+        for (i = 0; i < MEM_PAGE_BLOCK_INFO_COUNT; i++) {
+            if (GET_PAGE_LINK(node, i)->count > 0) {
+                return MEM_FAILED;
+            }
+        }
+    }
+
+    for (i = 1; i < MEM_PAGE_BLOCK_INFO_COUNT - 1; i++) {
+        class_fill(mem_page_info_list + i, i <= count ? (int)sizes[i - 1] : 0);
+    }
+
+    /* 重新生成索引表，每个长度映射到不小于它的最小分类 */
+    for (i = 1; i < MEM_PAGE_MAP_INDEX_COUNT; i++) {
+        while (mem_page_info_list[index].block_size < (i << 3)) {
+            index++;
+        }
+
+        mem_page_info_index[i] = (unsigned char)index;
+    }
+
+    memset(mem_page_stat, 0, sizeof(mem_page_stat));
+
+    return MEM_SUCCESS;
+}
+
+int page_class_tune(size_t *sizes, int count)
+{
+    /* 以 8 字节为粒度，g 个粒度对应 g * 8 字节的申请 */
+    enum { GRAINS = MEM_PAGE_MAP_INDEX_COUNT - 1 };
+
+    int c, i, j;
+    int best = 0;
+
+    unsigned long long weight[GRAINS + 1] = { 0 }; /* 前缀和：申请次数 */
+    unsigned long long grain[GRAINS + 1]  = { 0 }; /* 前缀和：申请次数 * 粒度 */
+    unsigned long long cost = 0;
+
+    /* dp[c][j]：用 c 个分类覆盖 1 ~ j 且最大分类为 j 时的最小浪费 */
+    unsigned long long dp[MEM_PAGE_BLOCK_INFO_COUNT - 1][GRAINS + 1];
+    unsigned char from[MEM_PAGE_BLOCK_INFO_COUNT - 1][GRAINS + 1];
+
+    if (!sizes || count <= 0) {
+        return MEM_FAILED;
+    }
+
+    if (count > MEM_PAGE_BLOCK_INFO_COUNT - 2) {
+        count = MEM_PAGE_BLOCK_INFO_COUNT - 2;
+    }
+
+    for (j = 1; j <= GRAINS; j++) {
+        weight[j] = weight[j - 1] + mem_page_hist[j];
+        grain[j]  = grain[j - 1] + mem_page_hist[j] * (unsigned long long)j;
+    }
+
+    if (!weight[GRAINS]) {
+        return MEM_FAILED;
+    }
+
+    /* 区间 (i, j] 归入尺寸为 j 的分类时的浪费，单位为粒度 */
+#define CLASS_COST(i, j) \
+    ((weight[j] - weight[i]) * (unsigned long long)(j) - (grain[j] - grain[i]))
+
+    for (j = 1; j <= GRAINS; j++) {
+        dp[1][j] = CLASS_COST(0, j);
+        from[1][j] = 0;
+    }
+
+    for (c = 2; c <= count; c++) {
+        for (j = c; j <= GRAINS; j++) {
+            dp[c][j] = ~0ULL;
+
+            for (i = c - 1; i < j; i++) {
+                cost = dp[c - 1][i] + CLASS_COST(i, j);
+                if (cost < dp[c][j]) {
+                    dp[c][j] = cost;
+                    from[c][j] = (unsigned char)i;
+                }
+            }
+        }
+    }
+
+#undef CLASS_COST
+
+    /* 最大分类固定为 512，浪费相同时取分类数量最少的方案 */
+    best = 1;
+    for (c = 2; c <= count; c++) {
+        if (dp[c][GRAINS] < dp[best][GRAINS]) {
+            best = c;
+        }
+    }
+
+    for (c = best, j = GRAINS; c > 0; c--) {
+        sizes[c - 1] = (size_t)j << 3;
+        j = from[c][j];
+    }
+
+    return best;
+}
+
+int page_class_get(size_t *sizes, int count)
+{
+    int i;
+    int ret = 0;
+
+    for (i = 1; i < MEM_PAGE_BLOCK_INFO_COUNT - 1 && ret < count; i++) {
+        if (mem_page_info_list[i].block_size) {
+            sizes[ret++] = (size_t)mem_page_info_list[i].block_size;
+        }
+    }
+
+    return ret;
+}
+
+size_t page_trim(size_t keep_bytes)
+{
+    int i;
+    int node;
+    size_t size = 0;
+    size_t idle = 0;
+    size_t ret = 0;
+
+    MEM_PAGE_LINK *link = NULL;
+    MEM_PAGE *page = NULL;
+
+    /* 统计所有空闲内存页的大小 */
+    for (node = 0; node < mem_numa_node_count(); node++) {
+        for (i = 0; i < MEM_PAGE_BLOCK_INFO_COUNT; i++) {
+            link = GET_PAGE_LINK(node, i);
+            page = link->list[MEM_PAGE_STATUS_IDLE].head;
+
+            while (page) {
+                idle += get_page_size(i, page->block_head != sizeof(MEM_BLOCK));
+                page = (page == link->list[MEM_PAGE_STATUS_IDLE].tail) ? NULL : page->next;
+            }
+        }
+    }
+
+    /* 从每个链表的表尾（最久未使用）开始释放，直至不超过保留的字节数 */
+    for (node = 0; node < mem_numa_node_count() && idle > keep_bytes; node++) {
+        for (i = 0; i < MEM_PAGE_BLOCK_INFO_COUNT && idle > keep_bytes; i++) {
+            link = GET_PAGE_LINK(node, i);
+
+            while (idle > keep_bytes && link->list[MEM_PAGE_STATUS_IDLE].tail) {
+                page = link->list[MEM_PAGE_STATUS_IDLE].tail;
+                size = get_page_size(i, page->block_head != sizeof(MEM_BLOCK));
+
+                mem_page_free(page);
+
+                idle -= size;
+                ret += size;
+            }
+        }
+    }
+
+    return ret;
+}
+
+void page_budget_set(size_t soft_limit, size_t hard_limit)
+{
+    MEM_PAGE_BUDGET *budget = &mem_page_budget;
+
+    budget->soft_limit = soft_limit;
+    budget->hard_limit = hard_limit;
+
+    /* 设置时已经处于软限制之上，视为一次越过 */
+    budget->over_soft = soft_limit && budget->used > soft_limit;
+    budget->crossed = budget->over_soft;
+}
+
+size_t page_budget_used()
+{
+    return mem_page_budget.used;
+}
+
+int page_budget_crossed(size_t *used)
+{
+    if (!mem_page_budget.crossed) {
+        return 0;
+    }
+
+    mem_page_budget.crossed = 0;
+
+    if (used) {
+        *used = mem_page_budget.used;
+    }
+
+    return 1;
+}
+
+void page_walk_blocks(MEM_BLOCK_VISIT visit, void *arg)
+{
+    int i;
+    int node;
+
+    MEM_PAGE_LINK *link = NULL;
+    MEM_PAGE *page = NULL;
+
+    if (!visit) {
+        return;
+    }
+
+    for (node = 0; node < mem_numa_node_count(); node++) {
+        for (i = 0; i < MEM_PAGE_BLOCK_INFO_COUNT; i++) {
+            link = GET_PAGE_LINK(node, i);
+
+            for (page = page_link_next(link, NULL); page; page = page_link_next(link, page)) {
+                if (page->using_count > 0) {
+                    walk_page_blocks(page, visit, arg);
+                }
+            }
+        }
+    }
+}
+
+void page_walk_pages(MEM_PAGE_VISIT visit, void *arg)
+{
+    int i;
+    int node;
+
+    MEM_PAGE_LINK *link = NULL;
+    MEM_PAGE *page = NULL;
+    MEM_PAGE_STATE state;
+
+    if (!visit) {
+        return;
+    }
+
+    for (node = 0; node < mem_numa_node_count(); node++) {
+        for (i = 0; i < MEM_PAGE_BLOCK_INFO_COUNT; i++) {
+            link = GET_PAGE_LINK(node, i);
+
+            for (page = page_link_next(link, NULL); page; page = page_link_next(link, page)) {
+                state.addr        = page;
+                state.index       = i;
+                state.node        = node;
+                state.type        = page->type;
+                state.status      = page->status;
+                state.using_count = page->using_count;
+                state.block_num   = page->block_num;
+                state.block_head  = page->block_head;
+                state.block_data  = page->block_data;
+                state.alloc_size  = page->alloc_size;
+                state.page_size   = get_page_size(i, page->block_head != sizeof(MEM_BLOCK));
+
+                visit(&state, arg);
+            }
+        }
+    }
+}
+
+int get_addr_block_flag(void *ptr, int dbg)
+{
+    MEM_BLOCK *block = get_block(ptr, dbg);
+    return block ? block->flag : 0;
+}
+
+void set_addr_block_flag(void *ptr, int dbg, int flag)
+{
+    MEM_BLOCK *block = get_block(ptr, dbg);
+
+    if (block) {
+        block->flag = (unsigned short)flag;
+    }
+}
+
+void set_addr_block_size(void *ptr, int dbg, size_t len)
+{
+    MEM_BLOCK *block = get_block(ptr, dbg);
+    int index = 0;
+
+    if (!block) {
+        return;
+    }
+
+    index = get_page_index_ex(block->page);
+    if (index > MEM_PAGE_BLOCK_INFO_COUNT - 1) {
+        return;
+    }
+
+    mem_page_stat[index].requested_bytes -= block->size;
+    mem_page_stat[index].requested_bytes += len;
+    block->size = (unsigned int)len;
+
+    /* 原地调整的长度同样是一次申请，计入分类调整用的直方图 */
+    if (len <= MEM_PAGE_MAX_BLOCK) {
+        mem_page_hist[INT_ALIGN(len) >> 3]++;
+    }
+}
+
 int get_addr_block_len(void *ptr, int dbg)
 {
     MEM_BLOCK *block = NULL;
@@ -905,6 +1409,33 @@ int get_addr_block_len(void *ptr, int dbg)
 
 /*===========================================================================*/
 
+int get_page_size(int index, int dbg)
+{
+    int block_size = dbg ? sizeof(MEM_BLOCK_DBG) : sizeof(MEM_BLOCK);
+
+    /* 内存页大小 = 内存块总大小 + 每个内存块头部大小 + 内存页头部大小 */
+    return
+        mem_page_info_list[index].total_size + 
+        block_size * mem_page_info_list[index].block_num +
+        sizeof(MEM_PAGE);
+}
+
+void class_fill(MEM_PAGE_INFO *info, int block_size)
+{
+    /* 与默认分类表一致：128 字节以内用 1K 页，256 字节以内用 2K 页，其余用 4K 页 */
+    if (block_size <= 128) {
+        info->page_type = MEM_PAGE_TYPE_1K;
+    } else if (block_size <= 256) {
+        info->page_type = MEM_PAGE_TYPE_2K;
+    } else {
+        info->page_type = MEM_PAGE_TYPE_4K;
+    }
+
+    info->block_size = block_size;
+    info->total_size = 512 << info->page_type;
+    info->block_num  = block_size ? info->total_size / block_size : 0;
+}
+
 void mem_page_initialize(int index, MEM_PAGE *page, int dbg)
 {
     MEM_PAGE *head = NULL;
@@ -912,8 +1443,8 @@ void mem_page_initialize(int index, MEM_PAGE *page, int dbg)
     unsigned char *cursor = NULL;
 
     int block_size = dbg ? sizeof(MEM_BLOCK_DBG) : sizeof(MEM_BLOCK);
-    int page_size = sizeof(MEM_PAGE);
     int block_offset = 0;
+    int colors = 0;
 
     unsigned char i;
 
@@ -933,10 +1464,33 @@ void mem_page_initialize(int index, MEM_PAGE *page, int dbg)
     head->block_head = block_size;
     head->block_data = mem_page_info_list[index].block_size;
     head->alloc_size = 0;
-    head->idle = (MEM_BLOCK *)BYTE_OFFSET(head, page_size);
     head->head_addr = head;
 
-    cursor = BYTE_OFFSET(head, page_size);
+    /*
+     * 缓存着色：内存块总大小不是内存块尺寸整数倍的分类，页尾有剩余的
+     * 空间，将第一个内存块后移 0 ~ n 个缓存行，使不同内存页中相同序号
+     * 的内存块落在不同的缓存组上；0 内存和大内存不着色。
+     *
+     * 颜色由轮转计数加上内存页地址中缓存组索引之上的位决定：从内存池中
+     * 按固定间隔切分的内存页，落在同一缓存组上的页这部分位必然不同，
+     * 只用轮转计数时颜色与间隔的周期相关，无法错开。
+     *
+     * 只对 NUMA 内存池中的内存页着色：普通模式下内存页由 malloc 分配，
+     * 页尺寸不是 4K 的整数倍，各页起始地址本身已经错开，再叠加偏移反而
+     * 会使更多内存块落在同一缓存组上。
+     */
+    colors = (mem_page_info_list[index].total_size -
+        head->block_num * head->block_data) / MEM_PAGE_COLOR_SIZE + 1;
+
+    if (MEM_PAGE_COLORING && colors > 1 && mem_numa_enabled()) {
+        head->color = (unsigned char)((mem_page_color[index]++ +
+            (MEM_UINTPTR)page / MEM_PAGE_COLOR_SPAN) % (MEM_UINTPTR)colors);
+    } else {
+        head->color = 0;
+    }
+
+    head->idle = (MEM_BLOCK *)PAGE_FIRST_BLOCK(head);
+    cursor = PAGE_FIRST_BLOCK(head);
     block_offset = head->block_head + head->block_data;
 
     /* 
@@ -966,7 +1520,7 @@ void mem_page_terminate(MEM_PAGE *page)
 
     /* 计算内存页除头部以外的总大小（字节） */
     size = page->block_num * (page->block_data + page->block_head);
-    pt = BYTE_OFFSET(page, sizeof(MEM_PAGE));
+    pt = PAGE_FIRST_BLOCK(page);
 
     /* 清除内存块 */
     memset(pt, 0, size);
@@ -975,6 +1529,71 @@ void mem_page_terminate(MEM_PAGE *page)
     memset(page, 0, sizeof(MEM_PAGE));
 }
 
+int budget_reserve(size_t size)
+{
+    MEM_PAGE_BUDGET *budget = &mem_page_budget;
+
+    if (budget->hard_limit && budget->used + size > budget->hard_limit) {
+        return MEM_FAILED;
+    }
+
+    budget->used += size;
+
+    /* 只在由下向上越过软限制时通知一次 */
+    if (budget->soft_limit && !budget->over_soft && budget->used > budget->soft_limit) {
+        budget->over_soft = 1;
+        budget->crossed = 1;
+    }
+
+    return MEM_SUCCESS;
+}
+
+void budget_release(size_t size)
+{
+    MEM_PAGE_BUDGET *budget = &mem_page_budget;
+
+    budget->used -= size;
+
+    if (budget->over_soft && budget->used <= budget->soft_limit) {
+        budget->over_soft = 0;
+    }
+}
+
+void page_move(MEM_PAGE_LINK *link, MEM_PAGE *page, unsigned char status, int front)
+{
+    link_remove_force(GET_PAGE_LIST(link, page->status), (LINK_NODE *)page);
+
+    if (front) {
+        link_push_front(GET_PAGE_LIST(link, status), (LINK_NODE *)page);
+    } else {
+        link_push(GET_PAGE_LIST(link, status), (LINK_NODE *)page);
+    }
+
+    page->status = status;
+}
+
+MEM_PAGE *page_link_next(MEM_PAGE_LINK *link, MEM_PAGE *page)
+{
+    int i = 0;
+
+    /* 链表为环形，到达表尾后转到下一条链表 */
+    if (page) {
+        if (page != link->list[page->status].tail) {
+            return page->next;
+        }
+
+        i = page->status + 1;
+    }
+
+    for (; i < MEM_PAGE_LIST_COUNT; i++) {
+        if (link->list[i].head) {
+            return link->list[i].head;
+        }
+    }
+
+    return NULL;
+}
+
 MEM_BLOCK *get_block(void *address, int dbg)
 {
     unsigned char *pt = NULL;
@@ -995,39 +1614,60 @@ MEM_BLOCK *get_block(void *address, int dbg)
 
 void pad_dbg_block(MEM_BLOCK_DBG *block, const char *func, const char *file, int line)
 {
-    const char *str = NULL;
-
     if (!block) {
         return;
     }
 
     if (!func && !file && !line) {
-        block->line = 0;
+        block->site = NULL;
+        block->time = 0;
         block->thread = 0;
-
-        memset(block->date, INIT_BLOCK_PADDING, DATE_INFO_LENGTH);
-        memset(block->file, INIT_BLOCK_PADDING, FILE_INFO_LENGTH);
-        memset(block->func, INIT_BLOCK_PADDING, FUNC_INFO_LENGTH);
     } else {
-        block->line = line;
+        block->site = mem_site_intern(func, file, line);
+        block->time = mem_site_now();
         block->thread = (unsigned long long)THREAD_SELF;
+    }
+}
+
+void walk_page_blocks(MEM_PAGE *page, MEM_BLOCK_VISIT visit, void *arg)
+{
+    int i;
+    int offset = page->block_head + page->block_data;
+    int dbg = page->block_head == sizeof(MEM_BLOCK_DBG);
 
-        get_curtime("%Y-%m-%d %H:%M:%S", block->date, DATE_INFO_LENGTH);
+    unsigned char *cursor = PAGE_FIRST_BLOCK(page);
+    MEM_BLOCK_DBG *block_dbg = NULL;
+    MEM_BLOCK_INFO info;
+
+    for (i = 0; i < page->block_num; i++, cursor += offset) {
+        if (((MEM_BLOCK *)cursor)->status != MEM_BLOCK_STATUS_USING) {
+            continue;
+        }
+
+        memset(&info, 0, sizeof(MEM_BLOCK_INFO));
 
-        if (file[0]) {
-            str = strrchr(file, CH_SEP);
-            str = str ? (str + 1) : file;
+        info.index = get_page_index_ex(page);
+        info.node  = page->node;
+        info.ptr   = BYTE_OFFSET(cursor, page->block_head);
+        info.size  = page->block_data;
 
-            strncpy(block->file, str, FILE_INFO_LENGTH);
+        /* 0 内存和大内存的数据区保存在单独申请的内存块中 */
+        if (page->type == MEM_PAGE_TYPE_ZERO ||
+            page->type == MEM_PAGE_TYPE_LARGE) {
+            info.ptr  = BYTE_OFFSET(MEM_TO_ADDR(info.ptr), page->block_head);
+            info.size = page->alloc_size - 2 * page->block_head - page->block_data;
         }
 
-        if (func[0]) {
-            strncpy(block->func, func, FUNC_INFO_LENGTH);
+        /* 调试信息记录在内存页中的内存块上 */
+        if (dbg) {
+            block_dbg = (MEM_BLOCK_DBG *)cursor;
+
+            info.site   = block_dbg->site;
+            info.time   = block_dbg->time;
+            info.thread = block_dbg->thread;
         }
 
-        block->date[DATE_INFO_LENGTH - 1] = '\0';
-        block->file[FILE_INFO_LENGTH - 1] = '\0';
-        block->func[FUNC_INFO_LENGTH - 1] = '\0';
+        visit(&info, arg);
     }
 }
 
@@ -1078,15 +1718,18 @@ int print_leak_info(MEM_PAGE *page, int dbg, char *buff)
     unsigned char *cursor = NULL;
     MEM_BLOCK *block = NULL;
     MEM_BLOCK_DBG *block_dbg = NULL;
+    const MEM_SITE *site = NULL;
     int offset = 0;
     int count = 0;
 
+    char date[DATE_INFO_LENGTH] = { 0 };
+
     if (!page || !buff) {
         return 0;
     }
 
     count = page->block_num;
-    block = (MEM_BLOCK *)((unsigned char *)page + sizeof(MEM_PAGE));
+    block = (MEM_BLOCK *)PAGE_FIRST_BLOCK(page);
     offset = page->block_head + page->block_data; 
     cursor = (unsigned char *)block;
 
@@ -1101,16 +1744,20 @@ int print_leak_info(MEM_PAGE *page, int dbg, char *buff)
                 sprintf(buff, "--- block[%d] block size = %d ---\n", i, offset);
                 output_mem_info_std(buff);
 
-                sprintf(buff, "    time = %s\n",   block_dbg->date);
+                /* 时间和调用位置在打印时才格式化 */
+                site = block_dbg->site;
+                mem_site_format_time(block_dbg->time, date, DATE_INFO_LENGTH);
+
+                sprintf(buff, "    time = %s\n",   date);
                 output_mem_info_std(buff);
 
-                sprintf(buff, "    file = %s\n",   block_dbg->file);
+                format_mem_info(buff, 128, "    file = %s\n", site ? site->file : "");
                 output_mem_info_std(buff);
 
-                sprintf(buff, "    line = %d\n",   block_dbg->line);
+                sprintf(buff, "    line = %d\n",   site ? site->line : 0);
                 output_mem_info_std(buff);
 
-                sprintf(buff, "    func = %s\n",   block_dbg->func);
+                format_mem_info(buff, 128, "    func = %s\n", site ? site->func : "");
                 output_mem_info_std(buff);
 
                 sprintf(buff, "    tid  = 0x%llX\n", block_dbg->thread);
@@ -1154,13 +1801,13 @@ void print_link_info(MEM_PAGE_LINK *link, int index, char *buff)
     sprintf(buff, "count      = %d\n", link->count);
     output_mem_info_std(buff);
 
-    sprintf(buff, "ilde_num   = %d\n", link->idle_num);
+    sprintf(buff, "ilde_num   = %d\n", link->list[MEM_PAGE_STATUS_IDLE].count);
     output_mem_info_std(buff);
 
-    sprintf(buff, "heade      = %p\n", link->head);
+    sprintf(buff, "using_num  = %d\n", link->list[MEM_PAGE_STATUS_USING].count);
     output_mem_info_std(buff);
 
-    sprintf(buff, "tail       = %p\n", link->tail);
+    sprintf(buff, "full_num   = %d\n", link->list[MEM_PAGE_STATUS_FULL].count);
     output_mem_info_std(buff);
 }
 
@@ -1212,36 +1859,4 @@ const char *format_mem_info(char *buff, int size, const char *info, ...)
     return buff;
 }
 
-int get_curtime(const char *format, char *buf, int len)
-{
-    time_t lc_time = 0;
-    size_t ret = 0;
-    struct tm *lctm = NULL;
-
-    if (!format || !format[0]) {
-        return MEM_FAILED;
-    }
-
-    if (!buf) {
-        return MEM_FAILED;
-    }
-
-    if (len <= 0) {
-        return MEM_FAILED;
-    }
-
-    memset(buf, 0, len);
-
-    /* 获取本地时间 */
-    lc_time = time(NULL);
-    lctm = localtime(&lc_time);
-
-    if (!lctm) {
-        return MEM_FAILED;
-    }
-
-    /* 转换时间信息为字符串 */
-    ret = strftime(buf, len, format, lctm);
-    return !ret ? MEM_FAILED : MEM_SUCCESS;
-}
 /*===========================================================================*/
@@ -24,11 +24,51 @@
 #define MEM_BLOCK_STATUS_IDLE       0    /* 内存块空闲 */
 #define MEM_BLOCK_STATUS_USING      1    /* 内存块被占用 */
 
+/* 内存块标记 */
+#define MEM_BLOCK_FLAG_SAMPLED      0x01 /* 内存块已被采样分析器记录 */
+
 typedef struct mem_page_st          MEM_PAGE;
 typedef struct mem_block_st         MEM_BLOCK;
 typedef struct mem_block_dbg_st     MEM_BLOCK_DBG;
 typedef struct mem_page_link_st     MEM_PAGE_LINK;
 
+struct mem_stats;
+struct mem_site_st;
+
+/* 遍历内存页时提供的内存块信息 */
+typedef struct {
+    void *ptr;                          /* 数据区地址 */
+    size_t size;                        /* 数据区大小，大内存为实际申请的大小 */
+    int index;                          /* 内存分类索引 */
+    int node;                           /* 所属 NUMA 内存池 */
+
+    /* 以下信息只在 dbg 模式下有效 */
+    const struct mem_site_st *site;     /* 调用位置 */
+    unsigned long long time;            /* 分配时刻，见 mem_site_now */
+    unsigned long long thread;          /* 分配线程 */
+} MEM_BLOCK_INFO;
+
+/* 内存块遍历回调 */
+typedef void (*MEM_BLOCK_VISIT)(const MEM_BLOCK_INFO *info, void *arg);
+
+/* 遍历内存页时提供的内存页信息 */
+typedef struct {
+    const void *addr;                   /* 内存页地址 */
+    int index;                          /* 内存分类索引 */
+    int node;                           /* 所属 NUMA 内存池 */
+    int type;                           /* 内存页类型 */
+    int status;                         /* 内存页状态 */
+    int using_count;                    /* 已分配的内存块数量 */
+    int block_num;                      /* 内存块数量 */
+    int block_head;                     /* 单位内存块头部大小 */
+    int block_data;                     /* 单位内存块数据大小 */
+    int alloc_size;                     /* 当前申请的数据空间大小 */
+    int page_size;                      /* 内存页总大小 */
+} MEM_PAGE_STATE;
+
+/* 内存页遍历回调 */
+typedef void (*MEM_PAGE_VISIT)(const MEM_PAGE_STATE *state, void *arg);
+
 /*-------------------------------------------------------*/
 
 /* 获取分页索引 */
@@ -46,11 +86,17 @@ int mem_page_malloc(int index, int dbg);
 /* 释放一个内存页，如果内存链表没有 idle 状态的内存页，返回相应的错误码 */
 int mem_page_free(MEM_PAGE *page);
 
+/* 开启 NUMA 模式，只能在创建内存页之前调用 */
+int page_enable_numa();
+
 /* 清理内存页 */
 void clear_mem_pages();
 
 /* 从内存页分配一个空闲内存块 */
 void *alloc_block(size_t len);
+
+/* 从指定分类的内存页分配一个空闲内存块，index 由调用方预先求得 */
+void *alloc_block_index(int index, size_t len);
 void *alloc_block_dbg(size_t len, const char *func, const char *file, int line);
 
 /* 释放内存块 */
@@ -65,12 +111,52 @@ void page_print_block_list(int index, int dbg);
 /* 打印已分配的内存信息 */
 void page_print_allocated_info(int dbg);
 
+/* 获取内存分类统计信息 */
+void page_get_stats(struct mem_stats *stats);
+
+/*
+ * 加载自定义分类表，sizes 为升序排列、8 的倍数的内存块尺寸，最后一项须为
+ * 512，数量不超过 13；已有内存页时返回 MEM_FAILED
+ */
+int page_class_load(const size_t *sizes, int count);
+
+/* 根据申请尺寸直方图计算内部碎片最小的分类表，返回分类数量 */
+int page_class_tune(size_t *sizes, int count);
+
+/* 获取当前分类表，返回分类数量 */
+int page_class_get(size_t *sizes, int count);
+
+/* 释放空闲内存页，直至空闲内存页的总大小不超过 keep_bytes，返回释放的字节数 */
+size_t page_trim(size_t keep_bytes);
+
+/* 设置内存预算的软限制和硬限制，0 表示不限制 */
+void page_budget_set(size_t soft_limit, size_t hard_limit);
+
+/* 获取当前向系统申请的字节数 */
+size_t page_budget_used();
+
+/* 是否刚越过软限制，返回 1 时同时清除该标记，used 返回当前字节数 */
+int page_budget_crossed(size_t *used);
+
+/* 遍历所有正在使用的内存块，调用方需持有分配器锁 */
+void page_walk_blocks(MEM_BLOCK_VISIT visit, void *arg);
+
+/* 遍历所有内存页，调用方需持有分配器锁 */
+void page_walk_pages(MEM_PAGE_VISIT visit, void *arg);
+
 /*-------------------------------------------------------*/
 /* 内存结构信息 */
 
 /* 获取所属地址内存块的长度, 不含头部 */
 int get_addr_block_len(void *ptr, int dbg);
 
+/* 原地 realloc 后更新内存块的申请长度及统计，调用方需持有分配器锁 */
+void set_addr_block_size(void *ptr, int dbg, size_t len);
+
+/* 获取和设置所属地址内存块的标记 */
+int  get_addr_block_flag(void *ptr, int dbg);
+void set_addr_block_flag(void *ptr, int dbg, int flag);
+
 /*===========================================================================*/
 
 #endif /* __MEM_PAGE_H__ */
@@ -0,0 +1,227 @@
+#if defined(WIN32)
+#define _CRT_SECURE_NO_WARNINGS
+#else
+#define _GNU_SOURCE
+#endif
+
+#include <stdio.h>
+#include <string.h>
+
+#include "mem.h"
+#include "mem_page.h"
+#include "mem_pressure.h"
+
+/*===========================================================================*/
+
+#if defined(WIN32)
+#include <windows.h>
+#else /* Linux */
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <pthread.h>
+#endif /* WIN32 & Linux */
+
+/*===========================================================================*/
+
+/* 是否正在监听 */
+static int pressure_running = 0;
+
+/* 收缩时保留的空闲内存页字节数 */
+static size_t pressure_keep = 0;
+
+#if defined(WIN32)
+static HANDLE pressure_notify = NULL;   /* 低内存资源通知 */
+static HANDLE pressure_stop = NULL;     /* 停止监听事件 */
+static HANDLE pressure_thread = NULL;
+#else /* Linux */
+static int pressure_fd = -1;            /* 压力文件 */
+static int pressure_pipe[2] = { -1, -1 }; /* 用于唤醒监听线程停止 */
+static pthread_t pressure_thread;
+#endif /* WIN32 & Linux */
+
+/*===========================================================================*/
+
+/* 监听线程，收到压力通知时收缩内存 */
+#if defined(WIN32)
+static DWORD WINAPI pressure_run(LPVOID arg);
+#else /* Linux */
+static void *pressure_run(void *arg);
+#endif /* WIN32 & Linux */
+
+/* 释放监听资源 */
+static void pressure_close();
+
+/*===========================================================================*/
+
+int mem_pressure_start(const char *path, size_t keep_bytes)
+{
+#if !defined(WIN32)
+    char trigger[64] = { 0 };
+    int len = 0;
+#endif /* Linux */
+
+    if (pressure_running) {
+        return MEM_FAILED;
+    }
+
+    pressure_keep = keep_bytes;
+
+#if defined(WIN32)
+    (void)path;
+
+    pressure_notify = CreateMemoryResourceNotification(LowMemoryResourceNotification);
+    pressure_stop = CreateEvent(NULL, TRUE, FALSE, NULL);
+
+    if (!pressure_notify || !pressure_stop) {
+        pressure_close();
+        return MEM_FAILED;
+    }
+
+    pressure_thread = CreateThread(NULL, 0, pressure_run, NULL, 0, NULL);
+    if (!pressure_thread) {
+        pressure_close();
+        return MEM_FAILED;
+    }
+#else /* Linux */
+    pressure_fd = open(path ? path : MEM_PRESSURE_PATH, O_RDWR | O_NONBLOCK | O_CLOEXEC);
+    if (pressure_fd < 0) {
+        return MEM_FAILED;
+    }
+
+    /* 触发条件需要连同结尾的 '\0' 一起写入 */
+    len = snprintf(trigger, sizeof(trigger), "some %d %d",
+        MEM_PRESSURE_STALL_US, MEM_PRESSURE_WINDOW_US);
+
+    if (write(pressure_fd, trigger, (size_t)len + 1) < 0 || pipe(pressure_pipe)) {
+        pressure_close();
+        return MEM_FAILED;
+    }
+
+    if (pthread_create(&pressure_thread, NULL, pressure_run, NULL)) {
+        pressure_close();
+        return MEM_FAILED;
+    }
+#endif /* WIN32 & Linux */
+
+    pressure_running = 1;
+    return MEM_SUCCESS;
+}
+
+void mem_pressure_stop()
+{
+    if (!pressure_running) {
+        return;
+    }
+
+#if defined(WIN32)
+    SetEvent(pressure_stop);
+    WaitForSingleObject(pressure_thread, INFINITE);
+#else /* Linux */
+    while (write(pressure_pipe[1], "", 1) < 0 && errno == EINTR) {
+    }
+
+    pthread_join(pressure_thread, NULL);
+#endif /* WIN32 & Linux */
+
+    pressure_close();
+    pressure_running = 0;
+}
+
+/*===========================================================================*/
+
+#if defined(WIN32)
+DWORD WINAPI pressure_run(LPVOID arg)
+{
+    HANDLE handles[2] = { pressure_stop, pressure_notify };
+
+    (void)arg;
+
+    /* 低内存状态会一直保持有信号，两次收缩之间至少间隔 MEM_PRESSURE_INTERVAL */
+    while (WaitForMultipleObjects(2, handles, FALSE, INFINITE) == WAIT_OBJECT_0 + 1) {
+        mem_trim(pressure_keep);
+
+        if (WaitForSingleObject(pressure_stop, MEM_PRESSURE_INTERVAL) == WAIT_OBJECT_0) {
+            break;
+        }
+    }
+
+    return 0;
+}
+#else /* Linux */
+void *pressure_run(void *arg)
+{
+    struct pollfd fds[2];
+
+    (void)arg;
+
+    for (;;) {
+        fds[0].fd = pressure_fd;
+        fds[0].events = POLLPRI;
+        fds[0].revents = 0;
+
+        fds[1].fd = pressure_pipe[0];
+        fds[1].events = POLLIN;
+        fds[1].revents = 0;
+
+        if (poll(fds, 2, -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+
+            break;
+        }
+
+        /* 收到停止通知，或者监听的 cgroup 已被删除 */
+        if (fds[1].revents || (fds[0].revents & POLLERR)) {
+            break;
+        }
+
+        if (fds[0].revents & POLLPRI) {
+            mem_trim(pressure_keep);
+
+            /* 两次收缩之间至少间隔 MEM_PRESSURE_INTERVAL，期间仍可响应停止 */
+            if (poll(fds + 1, 1, MEM_PRESSURE_INTERVAL) > 0) {
+                break;
+            }
+        }
+    }
+
+    return NULL;
+}
+#endif /* WIN32 & Linux */
+
+void pressure_close()
+{
+#if defined(WIN32)
+    if (pressure_thread) {
+        CloseHandle(pressure_thread);
+        pressure_thread = NULL;
+    }
+
+    if (pressure_stop) {
+        CloseHandle(pressure_stop);
+        pressure_stop = NULL;
+    }
+
+    if (pressure_notify) {
+        CloseHandle(pressure_notify);
+        pressure_notify = NULL;
+    }
+#else /* Linux */
+    if (pressure_pipe[0] >= 0) {
+        close(pressure_pipe[0]);
+        close(pressure_pipe[1]);
+        pressure_pipe[0] = -1;
+        pressure_pipe[1] = -1;
+    }
+
+    if (pressure_fd >= 0) {
+        close(pressure_fd);
+        pressure_fd = -1;
+    }
+#endif /* WIN32 & Linux */
+}
+
+/*===========================================================================*/
@@ -0,0 +1,28 @@
+#ifndef __MEM_PRESSURE_H__
+#define __MEM_PRESSURE_H__
+
+/*===========================================================================*/
+/* 内存压力监听 */
+/*===========================================================================*/
+
+/*
+ * Linux 下使用 PSI（Pressure Stall Information）触发器：向压力文件写入
+ * 触发条件后，在文件描述符上等待 POLLPRI 事件；压力文件可以是系统级的
+ * /proc/pressure/memory，也可以是 cgroup v2 的 memory.pressure，后者
+ * 在容器内存受限时触发。
+ *
+ * 触发条件的含义为：在 MEM_PRESSURE_WINDOW_US 的窗口内，部分任务因
+ * 等待内存而停顿的总时长超过 MEM_PRESSURE_STALL_US；非特权进程要求
+ * 窗口为 2 秒的整数倍。
+ *
+ * Windows 下使用系统的低内存资源通知，忽略压力文件路径。
+ */
+
+#define MEM_PRESSURE_PATH       "/proc/pressure/memory"
+#define MEM_PRESSURE_STALL_US   150000      /* 窗口内的停顿时长阈值，单位微秒 */
+#define MEM_PRESSURE_WINDOW_US  2000000     /* 统计窗口，单位微秒 */
+#define MEM_PRESSURE_INTERVAL   1000        /* 两次收缩之间的最短间隔，单位毫秒 */
+
+/*===========================================================================*/
+
+#endif /* __MEM_PRESSURE_H__ */
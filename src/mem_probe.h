@@ -0,0 +1,58 @@
+#ifndef __MEM_PROBE_H__
+#define __MEM_PROBE_H__
+
+/*===========================================================================*/
+/* USDT 静态探针 */
+/*===========================================================================*/
+
+/*
+ * 探针使用 systemtap 的 sys/sdt.h 定义，每个探针在代码中只是一条 nop
+ * 指令，位置和参数记录在 ELF 的 .note.stapsdt 节中；未被 bpftrace、
+ * perf 等工具挂接时没有额外开销，挂接后工具把 nop 替换为断点。
+ *
+ * 编译环境中没有 sys/sdt.h 时探针为空，也可以用 -DMEM_PROBE_SDT=0
+ * 显式关闭。提供者名称为 mem，探针及其参数：
+ *
+ *   malloc(ptr, len)                   分配完成，失败时 ptr 为 NULL
+ *   free(ptr)                          开始释放
+ *   realloc(old, ptr, len)             重新分配完成
+ *   page_create(page, index, node)     创建内存页，见 mem_page_malloc
+ *   page_release(page, index, node)    释放内存页，见 mem_page_free
+ *   large_alloc(ptr, size)             大内存向系统申请数据区，size 含内存块头部
+ *   lock_wait(lock)                    分配器中的锁被占用，开始等待
+ *   lock_acquire(lock)                 等待后获得锁，未发生竞争时不触发
+ *
+ * 例如统计锁等待时长的分布：
+ *
+ *   bpftrace -e 'usdt:./main:mem:lock_wait { @s[tid] = nsecs; }
+ *       usdt:./main:mem:lock_acquire /@s[tid]/ {
+ *           @ns = hist(nsecs - @s[tid]); delete(@s[tid]); }'
+ */
+
+#ifndef MEM_PROBE_SDT
+#if defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#define MEM_PROBE_SDT 1
+#endif
+#endif /* __has_include */
+#endif /* MEM_PROBE_SDT */
+
+#ifndef MEM_PROBE_SDT
+#define MEM_PROBE_SDT 0
+#endif
+
+#if MEM_PROBE_SDT
+#include <sys/sdt.h>
+
+#define MEM_PROBE1(name, a) DTRACE_PROBE1(mem, name, a)
+#define MEM_PROBE2(name, a, b) DTRACE_PROBE2(mem, name, a, b)
+#define MEM_PROBE3(name, a, b, c) DTRACE_PROBE3(mem, name, a, b, c)
+#else
+#define MEM_PROBE1(name, a) ((void)0)
+#define MEM_PROBE2(name, a, b) ((void)0)
+#define MEM_PROBE3(name, a, b, c) ((void)0)
+#endif /* MEM_PROBE_SDT */
+
+/*===========================================================================*/
+
+#endif /* __MEM_PROBE_H__ */
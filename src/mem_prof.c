@@ -0,0 +1,424 @@
+#if defined(WIN32)
+#define _CRT_SECURE_NO_WARNINGS
+#else
+#define _GNU_SOURCE
+#endif
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "mem.h"
+#include "mem_page.h"
+#include "mem_lockstat.h"
+#include "mem_prof.h"
+
+/*===========================================================================*/
+
+#if defined(WIN32)
+#include <windows.h>
+#else /* Linux */
+#include <pthread.h>
+#endif /* WIN32 & Linux */
+
+#if defined(__GLIBC__)
+#include <execinfo.h>
+#endif /* __GLIBC__ */
+
+#if defined(WIN32)
+typedef SRWLOCK PROF_LOCK_HANDLE;
+#define PROF_LOCK_INITIALIZER SRWLOCK_INIT
+#define PROF_LOCK(lock, path) \
+    MEM_LOCKSTAT_LOCK(&(lock), MEM_LOCK_ID_PROF, (path), \
+        TryAcquireSRWLockExclusive(&(lock)), AcquireSRWLockExclusive(&(lock)))
+#define PROF_UNLOCK(lock) MEM_LOCKSTAT_UNLOCK(MEM_LOCK_ID_PROF, ReleaseSRWLockExclusive(&(lock)))
+#else /* Linux */
+typedef pthread_mutex_t PROF_LOCK_HANDLE;
+#define PROF_LOCK_INITIALIZER PTHREAD_MUTEX_INITIALIZER
+#define PROF_LOCK(lock, path) \
+    MEM_LOCKSTAT_LOCK(&(lock), MEM_LOCK_ID_PROF, (path), \
+        !pthread_mutex_trylock(&(lock)), pthread_mutex_lock(&(lock)))
+#define PROF_UNLOCK(lock) MEM_LOCKSTAT_UNLOCK(MEM_LOCK_ID_PROF, pthread_mutex_unlock(&(lock)))
+#endif /* WIN32 & Linux */
+
+/*===========================================================================*/
+
+#define MEM_PROF_MAX_DEPTH      32      /* 调用栈最大深度 */
+#define MEM_PROF_SKIP_FRAMES    2       /* 跳过 mem_prof_record 和分配函数本身 */
+#define MEM_PROF_STACK_BUCKETS  1024    /* 调用栈哈希表桶数量 */
+#define MEM_PROF_RECORD_BUCKETS 4096    /* 采样记录哈希表桶数量 */
+
+/* 采样调用栈，相同调用栈的采样合并统计 */
+typedef struct mem_prof_stack_st MEM_PROF_STACK;
+struct mem_prof_stack_st {
+    MEM_PROF_STACK *next;
+
+    unsigned long hash;             /* 调用栈哈希值 */
+    int depth;                      /* 调用栈深度 */
+
+    unsigned long long live_count;  /* 存活的采样数量 */
+    unsigned long long live_bytes;  /* 存活采样的实际字节数 */
+    double est_bytes;               /* 存活采样代表的估算字节数 */
+
+    void *frames[MEM_PROF_MAX_DEPTH];
+};
+
+/* 采样记录，以内存地址为键 */
+typedef struct mem_prof_record_st MEM_PROF_RECORD;
+struct mem_prof_record_st {
+    MEM_PROF_RECORD *next;
+
+    void *ptr;                      /* 被采样的内存地址 */
+    size_t len;                     /* 申请的字节数 */
+    double weight;                  /* 本次采样代表的估算字节数 */
+    MEM_PROF_STACK *stack;          /* 所属调用栈 */
+};
+
+/*===========================================================================*/
+
+size_t mem_prof_rate = 0;
+MEM_PROF_TLS long long mem_prof_countdown = 0;
+
+/* 线程是否已经初始化过采样间隔 */
+static MEM_PROF_TLS int prof_thread_ready = 0;
+
+/* 线程随机数状态 */
+static MEM_PROF_TLS unsigned long long prof_thread_seed = 0;
+
+static PROF_LOCK_HANDLE prof_lock = PROF_LOCK_INITIALIZER;
+
+static MEM_PROF_STACK *prof_stacks[MEM_PROF_STACK_BUCKETS];
+static MEM_PROF_RECORD *prof_records[MEM_PROF_RECORD_BUCKETS];
+
+/* 累计采样次数 */
+static unsigned long long prof_sample_total = 0;
+
+/*===========================================================================*/
+
+/* 生成下一次采样间隔，服从均值为 rate 的指数分布 */
+static long long next_interval();
+
+/* 计算一次采样代表的估算字节数 */
+static double sample_weight(size_t len);
+
+/* 查找或创建调用栈 */
+static MEM_PROF_STACK *find_stack(void **frames, int depth);
+
+/* 清除所有采样记录 */
+static void clear_records();
+
+/* 按估算字节数由大到小排序 */
+static int compare_stack(const void *a, const void *b);
+
+/*===========================================================================*/
+
+int mem_prof_sample()
+{
+    int ret = prof_thread_ready;
+
+    /* 线程首次进入时只初始化采样间隔，不做记录 */
+    prof_thread_ready = 1;
+    mem_prof_countdown = next_interval();
+
+    return ret;
+}
+
+int mem_prof_start(size_t rate)
+{
+    if (!rate) {
+        return MEM_FAILED;
+    }
+
+    PROF_LOCK(prof_lock, MEM_LOCK_PATH_OTHER);
+    clear_records();
+    mem_prof_rate = rate;
+    PROF_UNLOCK(prof_lock);
+
+    return MEM_SUCCESS;
+}
+
+void mem_prof_stop()
+{
+    PROF_LOCK(prof_lock, MEM_LOCK_PATH_OTHER);
+    mem_prof_rate = 0;
+    clear_records();
+    PROF_UNLOCK(prof_lock);
+}
+
+int mem_prof_record(void *ptr, size_t len)
+{
+    int depth = 0;
+    unsigned long slot = 0;
+
+    void *frames[MEM_PROF_MAX_DEPTH + MEM_PROF_SKIP_FRAMES];
+    MEM_PROF_RECORD *record = NULL;
+
+    if (!ptr) {
+        return MEM_FAILED;
+    }
+
+    /* 获取调用栈在锁外进行 */
+#if defined(__GLIBC__)
+    depth = backtrace(frames, MEM_PROF_MAX_DEPTH + MEM_PROF_SKIP_FRAMES);
+#endif /* __GLIBC__ */
+    depth = depth > MEM_PROF_SKIP_FRAMES ? depth - MEM_PROF_SKIP_FRAMES : 0;
+
+    record = (MEM_PROF_RECORD *)malloc(sizeof(MEM_PROF_RECORD));
+    if (!record) {
+        return MEM_FAILED;
+    }
+
+    record->ptr = ptr;
+    record->len = len;
+
+    PROF_LOCK(prof_lock, MEM_LOCK_PATH_MALLOC);
+
+    if (!mem_prof_rate) {
+        PROF_UNLOCK(prof_lock);
+        free(record);
+        return MEM_FAILED;
+    }
+
+    record->weight = sample_weight(len);
+    record->stack = find_stack(frames + MEM_PROF_SKIP_FRAMES, depth);
+
+    if (!record->stack) {
+        PROF_UNLOCK(prof_lock);
+        free(record);
+        return MEM_FAILED;
+    }
+
+    record->stack->live_count++;
+    record->stack->live_bytes += len;
+    record->stack->est_bytes += record->weight;
+
+    slot = (unsigned long)(((size_t)ptr >> 4) % MEM_PROF_RECORD_BUCKETS);
+    record->next = prof_records[slot];
+    prof_records[slot] = record;
+
+    prof_sample_total++;
+
+    PROF_UNLOCK(prof_lock);
+    return MEM_SUCCESS;
+}
+
+void mem_prof_remove(void *ptr)
+{
+    unsigned long slot = 0;
+
+    MEM_PROF_RECORD *record = NULL;
+    MEM_PROF_RECORD **prev = NULL;
+
+    if (!ptr) {
+        return;
+    }
+
+    slot = (unsigned long)(((size_t)ptr >> 4) % MEM_PROF_RECORD_BUCKETS);
+
+    PROF_LOCK(prof_lock, MEM_LOCK_PATH_FREE);
+
+    prev = prof_records + slot;
+    record = *prev;
+
+    while (record && record->ptr != ptr) {
+        prev = &record->next;
+        record = record->next;
+    }
+
+    if (record) {
+        *prev = record->next;
+
+        record->stack->live_count--;
+        record->stack->live_bytes -= record->len;
+        record->stack->est_bytes -= record->weight;
+    }
+
+    PROF_UNLOCK(prof_lock);
+
+    free(record);
+}
+
+void mem_prof_print()
+{
+    int i;
+    int j;
+    int count = 0;
+
+    char **symbols = NULL;
+    MEM_PROF_STACK *stack = NULL;
+    MEM_PROF_STACK **list = NULL;
+
+    PROF_LOCK(prof_lock, MEM_LOCK_PATH_PRINT);
+
+    for (i = 0; i < MEM_PROF_STACK_BUCKETS; i++) {
+        for (stack = prof_stacks[i]; stack; stack = stack->next) {
+            if (stack->live_count) {
+                count++;
+            }
+        }
+    }
+
+    list = (MEM_PROF_STACK **)malloc(sizeof(MEM_PROF_STACK *) * (count + 1));
+    if (!list) {
+        PROF_UNLOCK(prof_lock);
+        return;
+    }
+
+    count = 0;
+    for (i = 0; i < MEM_PROF_STACK_BUCKETS; i++) {
+        for (stack = prof_stacks[i]; stack; stack = stack->next) {
+            if (stack->live_count) {
+                list[count++] = stack;
+            }
+        }
+    }
+
+    qsort(list, count, sizeof(MEM_PROF_STACK *), compare_stack);
+
+    printf("<============================heap profile===========================>\n");
+    printf("rate = %lu byte, samples = %llu, live stacks = %d\n",
+        (unsigned long)mem_prof_rate, prof_sample_total, count);
+
+    for (i = 0; i < count; i++) {
+        stack = list[i];
+
+        printf("--- stack[%d] est bytes = %.0f, samples = %llu, live bytes = %llu ---\n",
+            i, stack->est_bytes, stack->live_count, stack->live_bytes);
+
+#if defined(__GLIBC__)
+        symbols = backtrace_symbols(stack->frames, stack->depth);
+#endif /* __GLIBC__ */
+
+        for (j = 0; j < stack->depth; j++) {
+            if (symbols) {
+                printf("    #%d %s\n", j, symbols[j]);
+            } else {
+                printf("    #%d %p\n", j, stack->frames[j]);
+            }
+        }
+
+        free(symbols);
+        symbols = NULL;
+    }
+
+    printf("<============================heap profile===========================>\n");
+
+    PROF_UNLOCK(prof_lock);
+    free(list);
+}
+
+/*===========================================================================*/
+
+long long next_interval()
+{
+    unsigned long long x = prof_thread_seed;
+    double u = 0.0;
+
+    if (!x) {
+        x = (unsigned long long)(size_t)&prof_thread_seed ^ 0x9E3779B97F4A7C15ULL;
+    }
+
+    /* xorshift64 */
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    prof_thread_seed = x;
+
+    /* 取 53 位生成 (0, 1] 之间的均匀分布 */
+    u = ((double)(x >> 11) + 1.0) / 9007199254740992.0;
+
+    return (long long)(-log(u) * (double)mem_prof_rate) + 1;
+}
+
+double sample_weight(size_t len)
+{
+    double rate = (double)mem_prof_rate;
+
+    /*
+     * 大小为 len 的分配被采样的概率为 1 - exp(-len / rate)，
+     * 用其倒数放大实际字节数得到无偏估计
+     */
+    if (!len) {
+        return rate;
+    }
+
+    return (double)len / (1.0 - exp(-(double)len / rate));
+}
+
+MEM_PROF_STACK *find_stack(void **frames, int depth)
+{
+    int i;
+    unsigned long hash = 5381;
+    MEM_PROF_STACK *stack = NULL;
+
+    for (i = 0; i < depth; i++) {
+        hash = hash * 33 + (unsigned long)(size_t)frames[i];
+    }
+
+    for (stack = prof_stacks[hash % MEM_PROF_STACK_BUCKETS]; stack; stack = stack->next) {
+        if (stack->hash == hash && stack->depth == depth &&
+            !memcmp(stack->frames, frames, sizeof(void *) * depth)) {
+            return stack;
+        }
+    }
+
+    stack = (MEM_PROF_STACK *)malloc(sizeof(MEM_PROF_STACK));
+    if (!stack) {
+        return NULL;
+    }
+
+    memset(stack, 0, sizeof(MEM_PROF_STACK));
+    memcpy(stack->frames, frames, sizeof(void *) * depth);
+
+    stack->hash = hash;
+    stack->depth = depth;
+    stack->next = prof_stacks[hash % MEM_PROF_STACK_BUCKETS];
+    prof_stacks[hash % MEM_PROF_STACK_BUCKETS] = stack;
+
+    return stack;
+}
+
+void clear_records()
+{
+    int i;
+
+    MEM_PROF_STACK *stack = NULL;
+    MEM_PROF_RECORD *record = NULL;
+
+    for (i = 0; i < MEM_PROF_RECORD_BUCKETS; i++) {
+        while (prof_records[i]) {
+            record = prof_records[i];
+            prof_records[i] = record->next;
+            free(record);
+        }
+    }
+
+    for (i = 0; i < MEM_PROF_STACK_BUCKETS; i++) {
+        while (prof_stacks[i]) {
+            stack = prof_stacks[i];
+            prof_stacks[i] = stack->next;
+            free(stack);
+        }
+    }
+
+    prof_sample_total = 0;
+}
+
+int compare_stack(const void *a, const void *b)
+{
+    const MEM_PROF_STACK *sa = *(const MEM_PROF_STACK **)a;
+    const MEM_PROF_STACK *sb = *(const MEM_PROF_STACK **)b;
+
+    if (sa->est_bytes < sb->est_bytes) {
+        return 1;
+    }
+
+    if (sa->est_bytes > sb->est_bytes) {
+        return -1;
+    }
+
+    return 0;
+}
+
+/*===========================================================================*/
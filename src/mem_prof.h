@@ -0,0 +1,42 @@
+#ifndef __MEM_PROF_H__
+#define __MEM_PROF_H__
+
+#include <stddef.h>
+
+/*===========================================================================*/
+/* 采样堆分析器 */
+/*===========================================================================*/
+
+#if defined(WIN32)
+#define MEM_PROF_TLS __declspec(thread)
+#else /* Linux */
+#define MEM_PROF_TLS __thread
+#endif /* WIN32 & Linux */
+
+/* 平均采样间隔字节数，为 0 时表示未开启采样 */
+extern size_t mem_prof_rate;
+
+/* 当前线程距离下一次采样剩余的字节数 */
+extern MEM_PROF_TLS long long mem_prof_countdown;
+
+/*
+ * 采样判定：未开启采样时只有一次比较，开启后每次分配只做一次线程
+ * 局部的减法，计数耗尽时才进入 mem_prof_sample 重新计算采样间隔
+ */
+#define MEM_PROF_SAMPLE(len) \
+    (mem_prof_rate && \
+     (mem_prof_countdown -= (long long)(len)) < 0 && \
+     mem_prof_sample())
+
+/* 重置当前线程的采样间隔，返回非 0 表示本次分配需要记录 */
+int mem_prof_sample();
+
+/* 记录一次采样分配，保存当前调用栈 */
+int mem_prof_record(void *ptr, size_t len);
+
+/* 移除采样记录，在被采样的内存块释放之前调用 */
+void mem_prof_remove(void *ptr);
+
+/*===========================================================================*/
+
+#endif /* __MEM_PROF_H__ */
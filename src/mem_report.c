@@ -0,0 +1,249 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "mem_page.h"
+#include "mem_site.h"
+#include "mem_report.h"
+
+/*===========================================================================*/
+
+#define MEM_REPORT_INIT_SIZE 256        /* 哈希表初始容量，必须为 2 的幂 */
+
+/* 同一调用位置的汇总信息 */
+typedef struct {
+    const MEM_SITE *site;               /* 调用位置，非 dbg 模式为 NULL */
+    int index;                          /* 非 dbg 模式下的内存分类索引 */
+    int used;                           /* 哈希表槽位是否被占用 */
+
+    unsigned long long count;           /* 内存块数量 */
+    unsigned long long bytes;           /* 内存块字节数 */
+    unsigned long long oldest;          /* 最早的分配时刻 */
+    unsigned long long newest;          /* 最近的分配时刻 */
+} MEM_REPORT_ENTRY;
+
+/* 汇总结果，使用开放寻址哈希表 */
+struct mem_report_st {
+    MEM_REPORT_ENTRY *entry;
+    size_t capacity;                    /* 哈希表容量 */
+    size_t used;                        /* 已占用的槽位 */
+
+    unsigned long long now;             /* 汇总时刻 */
+    unsigned long long blocks;          /* 内存块总数 */
+    unsigned long long bytes;           /* 字节总数 */
+    int failed;                         /* 汇总过程中内存不足 */
+};
+
+/*===========================================================================*/
+
+/* 遍历回调，将内存块汇总到哈希表 */
+static void report_visit(const MEM_BLOCK_INFO *info, void *arg);
+
+/* 查找或插入汇总项 */
+static MEM_REPORT_ENTRY *report_find(
+    MEM_REPORT *report, const MEM_SITE *site, int index);
+
+/* 哈希表扩容 */
+static int report_grow(MEM_REPORT *report);
+
+/* 按字节数由大到小排序 */
+static int compare_entry(const void *a, const void *b);
+
+/*===========================================================================*/
+
+MEM_REPORT *mem_report_build()
+{
+    MEM_REPORT *report = (MEM_REPORT *)malloc(sizeof(MEM_REPORT));
+
+    if (!report) {
+        return NULL;
+    }
+
+    memset(report, 0, sizeof(MEM_REPORT));
+
+    report->capacity = MEM_REPORT_INIT_SIZE;
+    report->entry = (MEM_REPORT_ENTRY *)calloc(
+        report->capacity, sizeof(MEM_REPORT_ENTRY));
+
+    if (!report->entry) {
+        free(report);
+        return NULL;
+    }
+
+    report->now = mem_site_now();
+    page_walk_blocks(report_visit, report);
+
+    return report;
+}
+
+void mem_report_print(MEM_REPORT *report)
+{
+    size_t i;
+    size_t count = 0;
+
+    MEM_REPORT_ENTRY *entry = NULL;
+    MEM_REPORT_ENTRY *list = NULL;
+
+    if (!report) {
+        return;
+    }
+
+    /* 将占用的槽位压缩到数组头部后排序 */
+    list = report->entry;
+    for (i = 0; i < report->capacity; i++) {
+        if (list[i].used) {
+            list[count++] = list[i];
+        }
+    }
+
+    /* 压缩后哈希表不再可用 */
+    report->used = 0;
+    memset(list + count, 0, sizeof(MEM_REPORT_ENTRY) * (report->capacity - count));
+    qsort(list, count, sizeof(MEM_REPORT_ENTRY), compare_entry);
+
+    printf("<============================leak report============================>\n");
+    printf("sites = %lu, blocks = %llu, bytes = %llu\n",
+        (unsigned long)count, report->blocks, report->bytes);
+
+    if (report->failed) {
+        printf("out of memory, report is incomplete!\n");
+    }
+
+    for (i = 0; i < count; i++) {
+        entry = list + i;
+
+        if (entry->site) {
+            printf("[%lu] bytes = %llu count = %llu oldest = %.3fs newest = %.3fs at %s:%d (%s)\n",
+                (unsigned long)i, entry->bytes, entry->count,
+                (double)(report->now - entry->oldest) / 1e9,
+                (double)(report->now - entry->newest) / 1e9,
+                entry->site->file, entry->site->line, entry->site->func);
+        } else {
+            printf("[%lu] bytes = %llu count = %llu link %02d\n",
+                (unsigned long)i, entry->bytes, entry->count, entry->index);
+        }
+    }
+
+    if (!count) {
+        printf("No leak!\n");
+    }
+
+    printf("<============================leak report============================>\n");
+}
+
+void mem_report_free(MEM_REPORT *report)
+{
+    if (report) {
+        free(report->entry);
+        free(report);
+    }
+}
+
+/*===========================================================================*/
+
+void report_visit(const MEM_BLOCK_INFO *info, void *arg)
+{
+    MEM_REPORT *report = (MEM_REPORT *)arg;
+    MEM_REPORT_ENTRY *entry = NULL;
+
+    /* dbg 模式按调用位置汇总，否则按内存分类汇总 */
+    entry = report_find(report, info->site, info->site ? -1 : info->index);
+    if (!entry) {
+        report->failed = 1;
+        return;
+    }
+
+    if (!entry->count || info->time < entry->oldest) {
+        entry->oldest = info->time;
+    }
+
+    if (!entry->count || info->time > entry->newest) {
+        entry->newest = info->time;
+    }
+
+    entry->count++;
+    entry->bytes += info->size;
+
+    report->blocks++;
+    report->bytes += info->size;
+}
+
+MEM_REPORT_ENTRY *report_find(MEM_REPORT *report, const MEM_SITE *site, int index)
+{
+    size_t mask = 0;
+    size_t slot = 0;
+    MEM_REPORT_ENTRY *entry = NULL;
+
+    /* 负载超过 3/4 时扩容 */
+    if ((report->used + 1) * 4 > report->capacity * 3) {
+        if (report_grow(report) != MEM_SUCCESS) {
+            return NULL;
+        }
+    }
+
+    mask = report->capacity - 1;
+    slot = (((size_t)site >> 4) ^ (size_t)(index + 1)) * 0x9E3779B1UL;
+
+    for (slot &= mask; ; slot = (slot + 1) & mask) {
+        entry = report->entry + slot;
+
+        if (!entry->used) {
+            entry->used = 1;
+            entry->site = site;
+            entry->index = index;
+
+            report->used++;
+            return entry;
+        }
+
+        if (entry->site == site && entry->index == index) {
+            return entry;
+        }
+    }
+}
+
+int report_grow(MEM_REPORT *report)
+{
+    size_t i;
+    size_t capacity = report->capacity;
+
+    MEM_REPORT_ENTRY *old = report->entry;
+    MEM_REPORT_ENTRY *entry = NULL;
+
+    report->entry = (MEM_REPORT_ENTRY *)calloc(capacity * 2, sizeof(MEM_REPORT_ENTRY));
+    if (!report->entry) {
+        report->entry = old;
+        return MEM_FAILED;
+    }
+
+    report->capacity = capacity * 2;
+    report->used = 0;
+
+    for (i = 0; i < capacity; i++) {
+        if (old[i].used) {
+            entry = report_find(report, old[i].site, old[i].index);
+            *entry = old[i];
+        }
+    }
+
+    free(old);
+    return MEM_SUCCESS;
+}
+
+int compare_entry(const void *a, const void *b)
+{
+    const MEM_REPORT_ENTRY *ea = (const MEM_REPORT_ENTRY *)a;
+    const MEM_REPORT_ENTRY *eb = (const MEM_REPORT_ENTRY *)b;
+
+    if (ea->bytes < eb->bytes) {
+        return 1;
+    }
+
+    if (ea->bytes > eb->bytes) {
+        return -1;
+    }
+
+    return 0;
+}
+
+/*===========================================================================*/
@@ -0,0 +1,24 @@
+#ifndef __MEM_REPORT_H__
+#define __MEM_REPORT_H__
+
+/*===========================================================================*/
+/* 按调用位置汇总的内存报告 */
+/*===========================================================================*/
+
+typedef struct mem_report_st MEM_REPORT;
+
+/*
+ * 遍历一次内存页，按调用位置汇总正在使用的内存块，调用方需持有
+ * 分配器锁；非 dbg 模式的内存块没有调用位置，按内存分类汇总
+ */
+MEM_REPORT *mem_report_build();
+
+/* 按字节数由大到小打印汇总结果，不需要持有分配器锁 */
+void mem_report_print(MEM_REPORT *report);
+
+/* 释放汇总结果 */
+void mem_report_free(MEM_REPORT *report);
+
+/*===========================================================================*/
+
+#endif /* __MEM_REPORT_H__ */
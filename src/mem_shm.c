@@ -0,0 +1,853 @@
+#if defined(WIN32)
+#define _CRT_SECURE_NO_WARNINGS
+#else
+#define _GNU_SOURCE
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "mem.h"
+#include "mem_page.h"
+#include "mem_shm.h"
+
+/*===========================================================================*/
+
+#if defined(__linux__)
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif /* __linux__ */
+
+/*===========================================================================*/
+
+/* 偏移与本进程地址的转换 */
+#define SHM_PTR(shm, off) ((void *)((shm)->base + (off)))
+#define SHM_OFF(shm, ptr) ((size_t)((unsigned char *)(ptr) - (shm)->base))
+
+#define SHM_HEAD(shm) ((MEM_SHM_HEAD *)(shm)->base)
+#define SHM_SPAN(shm, off) ((MEM_SHM_SPAN *)SHM_PTR((shm), (off)))
+
+#define DATA_ALIGN(size, align) (((size) + (align) - 1) & ~((size_t)(align) - 1))
+
+/* 页段中第一个内存块的偏移 */
+#define SHM_BLOCK_START DATA_ALIGN(sizeof(MEM_SHM_SPAN), 8)
+
+/*===========================================================================*/
+
+#if defined(__linux__)
+/* 映射共享内存文件并生成句柄，fd 的所有权交给句柄 */
+static MEM_SHM *shm_map(int fd, size_t size);
+
+/* 初始化区域头部 */
+static int shm_init(MEM_SHM *shm);
+
+/* 初始化头部中的互斥量 */
+static int shm_init_lock(MEM_SHM_HEAD *head);
+
+/* 文件模式下在修改堆之前将文件标记为未落盘，并同步到文件 */
+static void shm_dirty(MEM_SHM *shm);
+
+/* 校验区域头部 */
+static int shm_check(MEM_SHM *shm);
+
+/* 加锁，持锁进程异常退出时恢复锁的一致性 */
+static int shm_lock(MEM_SHM_HEAD *head);
+static void shm_unlock(MEM_SHM_HEAD *head);
+#endif /* __linux__ */
+
+/* 分配 pages 页的页段，失败时返回 0 */
+static size_t span_alloc(MEM_SHM *shm, int pages);
+
+/* 释放页段，与相邻的空闲页段合并 */
+static void span_free(MEM_SHM *shm, size_t off);
+
+/* 创建小内存页段并切分为内存块 */
+static size_t span_create(MEM_SHM *shm, int index);
+
+/* 将页段加入或移出分类链表 */
+static void span_link(MEM_SHM *shm, size_t off);
+static void span_unlink(MEM_SHM *shm, size_t off);
+
+/* 分类的页段页数 */
+static int class_pages(int block_size);
+
+/*===========================================================================*/
+
+MEM_SHM *mem_shm_create(const char *name, size_t size)
+{
+#if defined(__linux__)
+    int fd = -1;
+    MEM_SHM *shm = NULL;
+
+    /* 至少包含头部和一页页区 */
+    size = DATA_ALIGN(size, MEM_SHM_PAGE);
+    if (size < 2 * MEM_SHM_PAGE) {
+        size = 2 * MEM_SHM_PAGE;
+    }
+
+    if (name) {
+        fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+    } else {
+        fd = memfd_create("mem_shm", 0);
+    }
+
+    if (fd < 0) {
+        return NULL;
+    }
+
+    if (ftruncate(fd, (off_t)size) || (shm = shm_map(fd, size)) == NULL) {
+        close(fd);
+
+        if (name) {
+            shm_unlink(name);
+        }
+
+        return NULL;
+    }
+
+    if (shm_init(shm) != MEM_SUCCESS) {
+        mem_shm_detach(shm);
+
+        if (name) {
+            shm_unlink(name);
+        }
+
+        return NULL;
+    }
+
+    return shm;
+#else
+    (void)name;
+    (void)size;
+    return NULL;
+#endif /* __linux__ */
+}
+
+MEM_SHM *mem_shm_attach(const char *name)
+{
+#if defined(__linux__)
+    int fd = -1;
+    MEM_SHM *shm = NULL;
+
+    if (!name) {
+        return NULL;
+    }
+
+    fd = shm_open(name, O_RDWR, 0);
+    if (fd < 0) {
+        return NULL;
+    }
+
+    shm = mem_shm_attach_fd(fd);
+    close(fd);
+
+    return shm;
+#else
+    (void)name;
+    return NULL;
+#endif /* __linux__ */
+}
+
+MEM_SHM *mem_shm_attach_fd(int fd)
+{
+#if defined(__linux__)
+    int dup_fd = -1;
+    struct stat st;
+    MEM_SHM *shm = NULL;
+
+    if (fstat(fd, &st) || (size_t)st.st_size < 2 * MEM_SHM_PAGE) {
+        return NULL;
+    }
+
+    /* 句柄持有独立的描述符，调用方可以自行关闭 fd */
+    dup_fd = fcntl(fd, F_DUPFD_CLOEXEC, 0);
+    if (dup_fd < 0) {
+        return NULL;
+    }
+
+    shm = shm_map(dup_fd, (size_t)st.st_size);
+    if (!shm) {
+        close(dup_fd);
+        return NULL;
+    }
+
+    if (shm_check(shm) != MEM_SUCCESS) {
+        mem_shm_detach(shm);
+        return NULL;
+    }
+
+    return shm;
+#else
+    (void)fd;
+    return NULL;
+#endif /* __linux__ */
+}
+
+MEM_SHM *mem_shm_open_file(const char *path, size_t size)
+{
+#if defined(__linux__)
+    int fd = -1;
+    int created = 0;
+    struct stat st;
+    MEM_SHM *shm = NULL;
+
+    if (!path) {
+        return NULL;
+    }
+
+    fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    if (fd < 0) {
+        return NULL;
+    }
+
+    /* 同一时刻只允许一个进程打开持久化堆 */
+    if (flock(fd, LOCK_EX | LOCK_NB) || fstat(fd, &st)) {
+        close(fd);
+        return NULL;
+    }
+
+    /* 空文件为新建，否则沿用文件的大小 */
+    if (!st.st_size) {
+        size = DATA_ALIGN(size, MEM_SHM_PAGE);
+        if (size < 2 * MEM_SHM_PAGE) {
+            size = 2 * MEM_SHM_PAGE;
+        }
+
+        if (ftruncate(fd, (off_t)size)) {
+            close(fd);
+            return NULL;
+        }
+
+        created = 1;
+    } else {
+        size = (size_t)st.st_size;
+    }
+
+    shm = shm_map(fd, size);
+    if (!shm) {
+        close(fd);
+        return NULL;
+    }
+
+    if (created) {
+        if (shm_init(shm) != MEM_SUCCESS) {
+            mem_shm_detach(shm);
+            return NULL;
+        }
+    } else {
+        /* 上次未调用 mem_shm_flush 的文件不保证一致，拒绝打开 */
+        if (shm_check(shm) != MEM_SUCCESS || !SHM_HEAD(shm)->clean) {
+            mem_shm_detach(shm);
+            return NULL;
+        }
+
+        /* 文件中的互斥量属于上一个进程，重新初始化 */
+        if (shm_init_lock(SHM_HEAD(shm)) != MEM_SUCCESS) {
+            mem_shm_detach(shm);
+            return NULL;
+        }
+    }
+
+    shm->persistent = 1;
+    SHM_HEAD(shm)->clean = 1;
+    shm_dirty(shm);
+
+    return shm;
+#else
+    (void)path;
+    (void)size;
+    return NULL;
+#endif /* __linux__ */
+}
+
+int mem_shm_flush(MEM_SHM *shm)
+{
+#if defined(__linux__)
+    int ret = MEM_SUCCESS;
+    MEM_SHM_HEAD *head = NULL;
+
+    if (!shm || !shm->persistent) {
+        return MEM_FAILED;
+    }
+
+    head = SHM_HEAD(shm);
+
+    if (shm_lock(head)) {
+        return MEM_FAILED;
+    }
+
+    /* 先落盘全部数据，再写入一致标记 */
+    if (msync(shm->base, shm->size, MS_SYNC) || fsync(shm->fd)) {
+        ret = MEM_FAILED;
+    } else {
+        head->clean = 1;
+
+        if (msync(shm->base, MEM_SHM_PAGE, MS_SYNC)) {
+            ret = MEM_FAILED;
+        }
+    }
+
+    shm_unlock(head);
+    return ret;
+#else
+    (void)shm;
+    return MEM_FAILED;
+#endif /* __linux__ */
+}
+
+int mem_shm_fd(MEM_SHM *shm)
+{
+    return shm ? shm->fd : MEM_FAILED;
+}
+
+void mem_shm_detach(MEM_SHM *shm)
+{
+#if defined(__linux__)
+    if (!shm) {
+        return;
+    }
+
+    munmap(shm->base, shm->size);
+    close(shm->fd);
+    free(shm);
+#else
+    (void)shm;
+#endif /* __linux__ */
+}
+
+int mem_shm_unlink(const char *name)
+{
+#if defined(__linux__)
+    return name && !shm_unlink(name) ? MEM_SUCCESS : MEM_FAILED;
+#else
+    (void)name;
+    return MEM_FAILED;
+#endif /* __linux__ */
+}
+
+void *mem_shm_malloc(MEM_SHM *shm, size_t len)
+{
+#if defined(__linux__)
+    int index = 0;
+    int pages = 0;
+    size_t off = 0;
+    size_t block = 0;
+
+    MEM_SHM_HEAD *head = NULL;
+    MEM_SHM_SPAN *span = NULL;
+
+    if (!shm || len > shm->size) {
+        return NULL;
+    }
+
+    head = SHM_HEAD(shm);
+
+    /* 0 内存按最小的分类分配 */
+    index = len > MEM_SHM_MAX_BLOCK ?
+        MEM_SHM_LARGE : head->class_index[DATA_ALIGN(len ? len : 1, 8) >> 3];
+
+    if (shm_lock(head)) {
+        return NULL;
+    }
+
+    shm_dirty(shm);
+
+    if (index == MEM_SHM_LARGE) {
+        pages = (int)(DATA_ALIGN(SHM_BLOCK_START + sizeof(MEM_SHM_BLOCK) + len,
+            MEM_SHM_PAGE) / MEM_SHM_PAGE);
+
+        off = span_alloc(shm, pages);
+        if (!off) {
+            shm_unlock(head);
+            return NULL;
+        }
+
+        span = SHM_SPAN(shm, off);
+        span->index = MEM_SHM_LARGE;
+        span->using_count = 1;
+        span->block_num = 1;
+        span->idle = 0;
+        span->prev = 0;
+        span->next = 0;
+
+        block = off + SHM_BLOCK_START;
+    } else {
+        off = head->partial[index];
+        if (!off && (off = span_create(shm, index)) == 0) {
+            shm_unlock(head);
+            return NULL;
+        }
+
+        /* 取出空闲内存块，页段填满后移出分类链表 */
+        span = SHM_SPAN(shm, off);
+        block = span->idle;
+        span->idle = *(size_t *)SHM_PTR(shm, block + sizeof(MEM_SHM_BLOCK));
+        span->using_count++;
+
+        if (!span->idle) {
+            span_unlink(shm, off);
+        }
+    }
+
+    ((MEM_SHM_BLOCK *)SHM_PTR(shm, block))->span = off;
+    head->alloc_count++;
+
+    shm_unlock(head);
+    return SHM_PTR(shm, block + sizeof(MEM_SHM_BLOCK));
+#else
+    (void)shm;
+    (void)len;
+    return NULL;
+#endif /* __linux__ */
+}
+
+void mem_shm_free(MEM_SHM *shm, void *ptr)
+{
+#if defined(__linux__)
+    size_t off = 0;
+    size_t block = 0;
+
+    MEM_SHM_HEAD *head = NULL;
+    MEM_SHM_SPAN *span = NULL;
+
+    if (!shm || !ptr) {
+        return;
+    }
+
+    block = SHM_OFF(shm, ptr) - sizeof(MEM_SHM_BLOCK);
+    if (block < MEM_SHM_PAGE + SHM_BLOCK_START || block >= shm->size) {
+        return;
+    }
+
+    head = SHM_HEAD(shm);
+
+    if (shm_lock(head)) {
+        return;
+    }
+
+    /* 页段须按页对齐且位于页区内，重复释放时头部已被清零 */
+    off = ((MEM_SHM_BLOCK *)SHM_PTR(shm, block))->span;
+    if (off < MEM_SHM_PAGE || off >= head->brk || off % MEM_SHM_PAGE) {
+        shm_unlock(head);
+        return;
+    }
+
+    span = SHM_SPAN(shm, off);
+    if (span->index <= 0 || span->index > MEM_SHM_LARGE || !span->using_count) {
+        shm_unlock(head);
+        return;
+    }
+
+    shm_dirty(shm);
+
+    ((MEM_SHM_BLOCK *)SHM_PTR(shm, block))->span = 0;
+    head->free_count++;
+
+    if (span->index == MEM_SHM_LARGE) {
+        span_free(shm, off);
+        shm_unlock(head);
+        return;
+    }
+
+    /* 已满的页段重新加入分类链表 */
+    if (!span->idle) {
+        span_link(shm, off);
+    }
+
+    *(size_t *)ptr = span->idle;
+    span->idle = block;
+    span->using_count--;
+
+    /* 完全空闲的页段归还页区 */
+    if (!span->using_count) {
+        span_unlink(shm, off);
+        span_free(shm, off);
+    }
+
+    shm_unlock(head);
+#else
+    (void)shm;
+    (void)ptr;
+#endif /* __linux__ */
+}
+
+size_t mem_shm_offset(MEM_SHM *shm, const void *ptr)
+{
+    return shm && ptr ? SHM_OFF(shm, ptr) : 0;
+}
+
+void *mem_shm_ptr(MEM_SHM *shm, size_t offset)
+{
+    return shm && offset && offset < shm->size ? SHM_PTR(shm, offset) : NULL;
+}
+
+void mem_shm_set_root(MEM_SHM *shm, void *ptr)
+{
+#if defined(__linux__)
+    if (shm && !shm_lock(SHM_HEAD(shm))) {
+        shm_dirty(shm);
+        __atomic_store_n(&SHM_HEAD(shm)->root, mem_shm_offset(shm, ptr), __ATOMIC_RELEASE);
+        shm_unlock(SHM_HEAD(shm));
+    }
+#else
+    (void)shm;
+    (void)ptr;
+#endif /* __linux__ */
+}
+
+void *mem_shm_get_root(MEM_SHM *shm)
+{
+#if defined(__linux__)
+    return shm ? mem_shm_ptr(shm,
+        __atomic_load_n(&SHM_HEAD(shm)->root, __ATOMIC_ACQUIRE)) : NULL;
+#else
+    (void)shm;
+    return NULL;
+#endif /* __linux__ */
+}
+
+size_t mem_shm_used(MEM_SHM *shm)
+{
+    size_t ret = 0;
+
+#if defined(__linux__)
+    if (shm && !shm_lock(SHM_HEAD(shm))) {
+        ret = SHM_HEAD(shm)->used;
+        shm_unlock(SHM_HEAD(shm));
+    }
+#else
+    (void)shm;
+#endif /* __linux__ */
+
+    return ret;
+}
+
+/*===========================================================================*/
+
+#if defined(__linux__)
+MEM_SHM *shm_map(int fd, size_t size)
+{
+    void *base = NULL;
+    MEM_SHM *shm = NULL;
+
+    base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (base == MAP_FAILED) {
+        return NULL;
+    }
+
+    shm = (MEM_SHM *)malloc(sizeof(MEM_SHM));
+    if (!shm) {
+        munmap(base, size);
+        return NULL;
+    }
+
+    shm->base = (unsigned char *)base;
+    shm->size = size;
+    shm->fd = fd;
+    shm->persistent = 0;
+
+    return shm;
+}
+
+int shm_init(MEM_SHM *shm)
+{
+    int i;
+    int index = 1;
+    int count = 0;
+    size_t sizes[MEM_CLASS_MAX] = { 0 };
+
+    MEM_SHM_HEAD *head = SHM_HEAD(shm);
+
+    /* 使用与内存页相同的分类表，创建后不再随本进程的分类表变化 */
+    count = page_class_get(sizes, MEM_CLASS_MAX);
+
+    for (i = 0; i < count; i++) {
+        head->block_size[i + 1] = (int)sizes[i];
+    }
+
+    for (i = 1; i < MEM_SHM_INDEX_COUNT; i++) {
+        while (head->block_size[index] < (i << 3)) {
+            index++;
+        }
+
+        head->class_index[i] = (unsigned char)index;
+    }
+
+    if (shm_init_lock(head) != MEM_SUCCESS) {
+        return MEM_FAILED;
+    }
+
+    head->version = MEM_SHM_VERSION;
+    head->size = shm->size;
+    head->brk = MEM_SHM_PAGE;
+
+    /* 其余进程以 magic 判断初始化是否完成 */
+    __atomic_store_n(&head->magic, MEM_SHM_MAGIC, __ATOMIC_RELEASE);
+    return MEM_SUCCESS;
+}
+
+int shm_init_lock(MEM_SHM_HEAD *head)
+{
+    pthread_mutexattr_t attr;
+
+    if (pthread_mutexattr_init(&attr)) {
+        return MEM_FAILED;
+    }
+
+    if (pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED) ||
+        pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST) ||
+        pthread_mutex_init(&head->lock, &attr)) {
+        pthread_mutexattr_destroy(&attr);
+        return MEM_FAILED;
+    }
+
+    pthread_mutexattr_destroy(&attr);
+    return MEM_SUCCESS;
+}
+
+void shm_dirty(MEM_SHM *shm)
+{
+    MEM_SHM_HEAD *head = SHM_HEAD(shm);
+
+    if (!shm->persistent || !head->clean) {
+        return;
+    }
+
+    /* 标记须先于堆的任何修改到达文件 */
+    head->clean = 0;
+    msync(shm->base, MEM_SHM_PAGE, MS_SYNC);
+}
+
+int shm_check(MEM_SHM *shm)
+{
+    MEM_SHM_HEAD *head = SHM_HEAD(shm);
+
+    if (__atomic_load_n(&head->magic, __ATOMIC_ACQUIRE) != MEM_SHM_MAGIC ||
+        head->version != MEM_SHM_VERSION || head->size != shm->size) {
+        return MEM_FAILED;
+    }
+
+    return MEM_SUCCESS;
+}
+
+int shm_lock(MEM_SHM_HEAD *head)
+{
+    int ret = pthread_mutex_lock(&head->lock);
+
+    if (ret == EOWNERDEAD) {
+        ret = pthread_mutex_consistent(&head->lock);
+    }
+
+    return ret ? MEM_FAILED : MEM_SUCCESS;
+}
+
+void shm_unlock(MEM_SHM_HEAD *head)
+{
+    pthread_mutex_unlock(&head->lock);
+}
+#endif /* __linux__ */
+
+size_t span_alloc(MEM_SHM *shm, int pages)
+{
+    size_t off = 0;
+    size_t rest = 0;
+    size_t size = (size_t)pages * MEM_SHM_PAGE;
+
+    MEM_SHM_HEAD *head = SHM_HEAD(shm);
+    MEM_SHM_SPAN *span = NULL;
+    MEM_SHM_SPAN *left = NULL;
+
+    /* 首次适配，从空闲页段的头部切下所需的页数 */
+    for (off = head->runs; off; off = span->next) {
+        span = SHM_SPAN(shm, off);
+
+        if (span->pages < pages) {
+            continue;
+        }
+
+        /* 剩余部分原位替换该空闲页段，正好用完时将其移出链表 */
+        if (span->pages > pages) {
+            rest = off + size;
+            left = SHM_SPAN(shm, rest);
+
+            left->index = MEM_SHM_SPAN_FREE;
+            left->pages = span->pages - pages;
+            left->prev  = span->prev;
+            left->next  = span->next;
+        } else {
+            rest = span->next;
+        }
+
+        if (span->prev) {
+            SHM_SPAN(shm, span->prev)->next = rest;
+        } else {
+            head->runs = rest;
+        }
+
+        if (span->next) {
+            SHM_SPAN(shm, span->next)->prev = left ? rest : span->prev;
+        }
+
+        break;
+    }
+
+    /* 没有合适的空闲页段时从页区末尾分配 */
+    if (!off) {
+        if (head->brk + size > head->size) {
+            return 0;
+        }
+
+        off = head->brk;
+        head->brk += size;
+        span = SHM_SPAN(shm, off);
+    }
+
+    span->pages = pages;
+    head->used += size;
+
+    return off;
+}
+
+void span_free(MEM_SHM *shm, size_t off)
+{
+    size_t prev = 0;
+    size_t next = 0;
+
+    MEM_SHM_HEAD *head = SHM_HEAD(shm);
+    MEM_SHM_SPAN *span = SHM_SPAN(shm, off);
+    MEM_SHM_SPAN *node = NULL;
+
+    head->used -= (size_t)span->pages * MEM_SHM_PAGE;
+    span->index = MEM_SHM_SPAN_FREE;
+
+    /* 按偏移升序定位插入位置 */
+    for (next = head->runs; next && next < off; next = node->next) {
+        node = SHM_SPAN(shm, next);
+        prev = next;
+    }
+
+    /* 与后一个空闲页段合并 */
+    if (next && off + (size_t)span->pages * MEM_SHM_PAGE == next) {
+        node = SHM_SPAN(shm, next);
+        span->pages += node->pages;
+        next = node->next;
+    }
+
+    /* 与前一个空闲页段合并 */
+    if (prev && prev + (size_t)SHM_SPAN(shm, prev)->pages * MEM_SHM_PAGE == off) {
+        SHM_SPAN(shm, prev)->pages += span->pages;
+        off  = prev;
+        span = SHM_SPAN(shm, prev);
+        prev = span->prev;
+    }
+
+    span->prev = prev;
+    span->next = next;
+
+    if (prev) {
+        SHM_SPAN(shm, prev)->next = off;
+    } else {
+        head->runs = off;
+    }
+
+    if (next) {
+        SHM_SPAN(shm, next)->prev = off;
+    }
+
+    /* 位于页区末尾的空闲页段退回 brk */
+    if (!next && off + (size_t)span->pages * MEM_SHM_PAGE == head->brk) {
+        head->brk = off;
+
+        if (prev) {
+            SHM_SPAN(shm, prev)->next = 0;
+        } else {
+            head->runs = 0;
+        }
+    }
+}
+
+size_t span_create(MEM_SHM *shm, int index)
+{
+    int i;
+    int stride = 0;
+    size_t off = 0;
+    size_t block = 0;
+
+    MEM_SHM_HEAD *head = SHM_HEAD(shm);
+    MEM_SHM_SPAN *span = NULL;
+
+    off = span_alloc(shm, class_pages(head->block_size[index]));
+    if (!off) {
+        return 0;
+    }
+
+    span = SHM_SPAN(shm, off);
+    stride = (int)sizeof(MEM_SHM_BLOCK) + head->block_size[index];
+
+    span->index = index;
+    span->using_count = 0;
+    span->block_num = (int)(((size_t)span->pages * MEM_SHM_PAGE - SHM_BLOCK_START) / stride);
+    span->idle = off + SHM_BLOCK_START;
+
+    /* 串起空闲内存块 */
+    for (i = 0, block = span->idle; i < span->block_num; i++, block += stride) {
+        *(size_t *)SHM_PTR(shm, block + sizeof(MEM_SHM_BLOCK)) =
+            i + 1 < span->block_num ? block + stride : 0;
+    }
+
+    span_link(shm, off);
+    return off;
+}
+
+void span_link(MEM_SHM *shm, size_t off)
+{
+    MEM_SHM_HEAD *head = SHM_HEAD(shm);
+    MEM_SHM_SPAN *span = SHM_SPAN(shm, off);
+
+    span->prev = 0;
+    span->next = head->partial[span->index];
+
+    if (span->next) {
+        SHM_SPAN(shm, span->next)->prev = off;
+    }
+
+    head->partial[span->index] = off;
+}
+
+void span_unlink(MEM_SHM *shm, size_t off)
+{
+    MEM_SHM_HEAD *head = SHM_HEAD(shm);
+    MEM_SHM_SPAN *span = SHM_SPAN(shm, off);
+
+    if (span->prev) {
+        SHM_SPAN(shm, span->prev)->next = span->next;
+    } else {
+        head->partial[span->index] = span->next;
+    }
+
+    if (span->next) {
+        SHM_SPAN(shm, span->next)->prev = span->prev;
+    }
+
+    span->prev = 0;
+    span->next = 0;
+}
+
+int class_pages(int block_size)
+{
+    /* 与内存页的 1K、2K、4K 规格保持相同的比例 */
+    if (block_size <= 128) {
+        return 1;
+    } else if (block_size <= 256) {
+        return 2;
+    }
+
+    return 4;
+}
+
+/*===========================================================================*/
@@ -0,0 +1,105 @@
+#ifndef __MEM_SHM_H__
+#define __MEM_SHM_H__
+
+#include <stddef.h>
+
+#if !defined(WIN32)
+#include <pthread.h>
+#endif /* Linux */
+
+#include "mem.h"
+
+/*===========================================================================*/
+/* 跨进程共享内存堆 */
+/*===========================================================================*/
+
+/*
+ * 共享内存区的布局，第 0 页为头部，其后为页区：
+ *
+ * | head | span | span | ... | brk -> 未使用 |
+ *
+ * 1.区域内的所有链接都保存为相对区域起点的偏移，0 表示空，因此各个进程
+ * 可以把区域映射在不同的地址上；
+ *
+ * 2.页区以页段（span，若干连续的页）为单位分配，页段头部记录所属分类；
+ * 小内存页段按与内存页相同的分类表切分为等长的内存块，尺寸不超过 128
+ * 字节的分类每段 1 页，256 字节以内 2 页，其余 4 页；大内存独占一个页段；
+ *
+ * 3.每个内存块前有一个记录所属页段偏移的头部，空闲内存块的数据区保存
+ * 下一个空闲内存块的偏移；
+ *
+ * 4.释放的页段按偏移升序挂在空闲页段链表上，与相邻的空闲页段合并，
+ * 位于页区末尾时直接退回 brk；
+ *
+ * 5.所有分配和释放由头部中的进程共享互斥量保护，互斥量为 robust 类型，
+ * 持锁进程异常退出后其余进程仍可获得锁，但被中断的那次操作涉及的结构
+ * 不保证一致；
+ *
+ * 6.文件模式下头部的 clean 标记记录文件是否一致：打开时清除并同步到
+ * 文件，mem_shm_flush 同步全部数据后再置位；此后的首次分配、释放或
+ * 设置根对象会先同步地清除标记，因此异常退出后的文件不会被误认为一致。
+ *
+ * 只在 Linux 下支持。
+ */
+
+#define MEM_SHM_MAGIC       0x4D53484D  /* "MSHM" */
+#define MEM_SHM_VERSION     1
+#define MEM_SHM_PAGE        4096        /* 页大小 */
+#define MEM_SHM_INDEX_COUNT 65          /* 分类索引表数量，与内存页映射表一致 */
+#define MEM_SHM_MAX_BLOCK   512         /* 按分类分配的最大申请长度 */
+#define MEM_SHM_LARGE       (MEM_STATS_CLASS_COUNT - 1) /* 大内存分类 */
+#define MEM_SHM_SPAN_FREE   -1          /* 空闲页段的分类 */
+
+/* 页段头部 */
+typedef struct {
+    int index;                          /* 分类索引，空闲页段为 MEM_SHM_SPAN_FREE */
+    int pages;                          /* 页数 */
+    int using_count;                    /* 已分配的内存块数量 */
+    int block_num;                      /* 内存块数量 */
+    size_t idle;                        /* 空闲内存块链表 */
+    size_t prev;                        /* 分类链表或空闲页段链表中的上一段 */
+    size_t next;                        /* 分类链表或空闲页段链表中的下一段 */
+} MEM_SHM_SPAN;
+
+/* 内存块头部 */
+typedef struct {
+    size_t span;                        /* 所属页段，释放后清零 */
+} MEM_SHM_BLOCK;
+
+/* 共享内存区头部 */
+typedef struct {
+    volatile unsigned int magic;        /* 初始化完成后才写入 */
+    unsigned int version;
+    size_t size;                        /* 区域总大小 */
+    size_t brk;                         /* 从未使用过的页区起点 */
+    size_t runs;                        /* 空闲页段链表，按偏移升序 */
+    size_t root;                        /* 根对象，供各进程找到共享的数据结构 */
+    size_t used;                        /* 已分配给页段的字节数 */
+    int clean;                          /* 文件模式下是否已一致地落盘 */
+
+    unsigned long long alloc_count;     /* 累计分配次数 */
+    unsigned long long free_count;      /* 累计释放次数 */
+
+    size_t partial[MEM_STATS_CLASS_COUNT];              /* 有空闲内存块的页段链表 */
+    int block_size[MEM_STATS_CLASS_COUNT];              /* 分类的内存块尺寸 */
+    unsigned char class_index[MEM_SHM_INDEX_COUNT];     /* 申请长度 / 8 到分类的索引 */
+
+#if !defined(WIN32)
+    pthread_mutex_t lock;               /* 进程共享互斥量 */
+#endif /* Linux */
+} MEM_SHM_HEAD;
+
+/* 头部须放在第 0 页内 */
+typedef char mem_shm_head_check[(sizeof(MEM_SHM_HEAD) <= MEM_SHM_PAGE) ? 1 : -1];
+
+/* 进程内的共享内存堆句柄 */
+struct mem_shm_st {
+    unsigned char *base;                /* 本进程中的映射地址 */
+    size_t size;                        /* 映射大小 */
+    int fd;                             /* 共享内存文件描述符 */
+    int persistent;                     /* 是否为文件模式 */
+};
+
+/*===========================================================================*/
+
+#endif /* __MEM_SHM_H__ */
@@ -0,0 +1,193 @@
+#if defined(WIN32)
+#define _CRT_SECURE_NO_WARNINGS
+#else
+#define _GNU_SOURCE
+#endif
+
+#include <time.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "mem_page.h"
+#include "mem_site.h"
+
+/*===========================================================================*/
+
+#if defined(WIN32)
+#include <windows.h>
+#endif /* WIN32 */
+
+#if defined(WIN32)
+#define CH_SEP  '\\'
+#else /* Linux */
+#define CH_SEP  '/'
+#endif /* WIN32 & Linux */
+
+/* 优先使用粗粒度单调时钟，读取开销远小于精确时钟 */
+#if defined(CLOCK_MONOTONIC_COARSE)
+#define MEM_SITE_CLOCK CLOCK_MONOTONIC_COARSE
+#elif !defined(WIN32)
+#define MEM_SITE_CLOCK CLOCK_MONOTONIC
+#endif
+
+/*===========================================================================*/
+
+#define MEM_SITE_BUCKETS 1024       /* 调用位置哈希表桶数量 */
+
+/* 调用位置哈希表 */
+static MEM_SITE *site_table[MEM_SITE_BUCKETS];
+
+/* 已登记的调用位置数量 */
+static unsigned int site_count = 0;
+
+/*===========================================================================*/
+
+/* 调用位置哈希值 */
+static unsigned long site_hash(const char *func, const char *file, int line);
+
+/*===========================================================================*/
+
+const MEM_SITE *mem_site_intern(const char *func, const char *file, int line)
+{
+    unsigned long slot = site_hash(func, file, line) % MEM_SITE_BUCKETS;
+    const char *str = NULL;
+    MEM_SITE *site = NULL;
+
+    /* 调用方传入的均为静态字符串，直接比较指针 */
+    for (site = site_table[slot]; site; site = site->next) {
+        if (site->line == line && site->func == func && site->path == file) {
+            return site;
+        }
+    }
+
+    site = (MEM_SITE *)malloc(sizeof(MEM_SITE));
+    if (!site) {
+        return NULL;
+    }
+
+    str = file ? strrchr(file, CH_SEP) : NULL;
+
+    site->id   = ++site_count;
+    site->line = line;
+    site->path = file;
+    site->file = str ? (str + 1) : file;
+    site->func = func;
+
+    site->live_blocks = 0;
+    site->live_bytes  = 0;
+
+    site->next = site_table[slot];
+    site_table[slot] = site;
+
+    return site;
+}
+
+void mem_site_alloc(const MEM_SITE *site, size_t bytes)
+{
+    MEM_SITE *info = (MEM_SITE *)site;
+
+    if (info) {
+        info->live_blocks++;
+        info->live_bytes += bytes;
+    }
+}
+
+void mem_site_free(const MEM_SITE *site, size_t bytes)
+{
+    MEM_SITE *info = (MEM_SITE *)site;
+
+    if (info) {
+        info->live_blocks--;
+        info->live_bytes -= bytes;
+    }
+}
+
+void mem_site_walk(MEM_SITE_VISIT visit, void *arg)
+{
+    int i;
+    MEM_SITE *site = NULL;
+
+    if (!visit) {
+        return;
+    }
+
+    for (i = 0; i < MEM_SITE_BUCKETS; i++) {
+        for (site = site_table[i]; site; site = site->next) {
+            visit(site, arg);
+        }
+    }
+}
+
+void mem_site_clear()
+{
+    int i;
+    MEM_SITE *site = NULL;
+
+    for (i = 0; i < MEM_SITE_BUCKETS; i++) {
+        while (site_table[i]) {
+            site = site_table[i];
+            site_table[i] = site->next;
+            free(site);
+        }
+    }
+
+    site_count = 0;
+}
+
+unsigned long long mem_site_now()
+{
+#if defined(WIN32)
+    return (unsigned long long)GetTickCount64() * 1000000ULL;
+#else /* Linux */
+    struct timespec ts;
+
+    if (clock_gettime(MEM_SITE_CLOCK, &ts)) {
+        return 0;
+    }
+
+    return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+#endif /* WIN32 & Linux */
+}
+
+int mem_site_format_time(unsigned long long stamp, char *buf, int len)
+{
+    time_t lc_time = 0;
+    size_t ret = 0;
+    struct tm *lctm = NULL;
+
+    unsigned long long now = mem_site_now();
+
+    if (!buf || len <= 0) {
+        return MEM_FAILED;
+    }
+
+    memset(buf, 0, len);
+
+    /* 由单调时钟的差值推算分配时的本地时间 */
+    lc_time = now > stamp ?
+        (time_t)((now - stamp) / 1000000000ULL) : 0;
+    lc_time = (time_t)(time(NULL) - lc_time);
+
+    lctm = localtime(&lc_time);
+    if (!lctm) {
+        return MEM_FAILED;
+    }
+
+    /* 转换时间信息为字符串 */
+    ret = strftime(buf, len, "%Y-%m-%d %H:%M:%S", lctm);
+    return !ret ? MEM_FAILED : MEM_SUCCESS;
+}
+
+/*===========================================================================*/
+
+unsigned long site_hash(const char *func, const char *file, int line)
+{
+    unsigned long hash = (unsigned long)(size_t)file;
+
+    hash = hash * 31 + (unsigned long)(size_t)func;
+    hash = hash * 31 + (unsigned long)line;
+
+    return hash ^ (hash >> 16);
+}
+
+/*===========================================================================*/
@@ -0,0 +1,54 @@
+#ifndef __MEM_SITE_H__
+#define __MEM_SITE_H__
+
+#include <stddef.h>
+
+/*===========================================================================*/
+/* 调试信息：调用位置与时间戳 */
+/*===========================================================================*/
+
+typedef struct mem_site_st MEM_SITE;
+
+/*
+ * 调用位置，相同的 (file, func, line) 只保存一份，调试内存块中
+ * 只记录指向调用位置的指针；file 和 func 直接引用调用方传入的静态
+ * 字符串，不做拷贝
+ */
+struct mem_site_st {
+    MEM_SITE *next;             /* 哈希表中的下一个调用位置 */
+
+    unsigned int id;            /* 调用位置编号，从 1 开始 */
+    int line;                   /* 调用 malloc 的行数 */
+    const char *path;           /* 调用方传入的文件路径 */
+    const char *file;           /* 所属文件，不含目录 */
+    const char *func;           /* 所属函数 */
+
+    unsigned long long live_blocks;     /* 正在使用的内存块数量 */
+    unsigned long long live_bytes;      /* 正在使用的字节数 */
+};
+
+/* 调用位置遍历回调 */
+typedef void (*MEM_SITE_VISIT)(const MEM_SITE *site, void *arg);
+
+/* 查找或登记调用位置，调用方需持有分配器锁 */
+const MEM_SITE *mem_site_intern(const char *func, const char *file, int line);
+
+/* 登记或注销调用位置上的一个内存块，调用方需持有分配器锁 */
+void mem_site_alloc(const MEM_SITE *site, size_t bytes);
+void mem_site_free(const MEM_SITE *site, size_t bytes);
+
+/* 遍历所有调用位置，调用方需持有分配器锁 */
+void mem_site_walk(MEM_SITE_VISIT visit, void *arg);
+
+/* 清除所有调用位置，调用后之前返回的指针全部失效 */
+void mem_site_clear();
+
+/* 获取当前单调时钟，单位为纳秒，精度为系统粗粒度时钟的精度 */
+unsigned long long mem_site_now();
+
+/* 将 mem_site_now 的返回值格式化为 yyyy-mm-dd hh:MM:ss 形式的本地时间 */
+int mem_site_format_time(unsigned long long stamp, char *buf, int len);
+
+/*===========================================================================*/
+
+#endif /* __MEM_SITE_H__ */
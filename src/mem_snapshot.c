@@ -0,0 +1,252 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "mem.h"
+#include "mem_page.h"
+#include "mem_site.h"
+#include "mem_snapshot.h"
+
+/*===========================================================================*/
+
+/* 调用位置遍历参数 */
+typedef struct {
+    struct mem_snapshot *snapshot;
+    size_t capacity;
+} SNAPSHOT_FILL;
+
+/*===========================================================================*/
+
+/* 遍历回调，按编号拷贝调用位置 */
+static void snapshot_visit(const MEM_SITE *site, void *arg);
+
+/* 按字节数增量由大到小排序 */
+static int compare_site(const void *a, const void *b);
+
+/*===========================================================================*/
+
+struct mem_snapshot *mem_snapshot_alloc(size_t capacity)
+{
+    struct mem_snapshot *snapshot =
+        (struct mem_snapshot *)malloc(sizeof(struct mem_snapshot));
+
+    if (!snapshot) {
+        return NULL;
+    }
+
+    memset(snapshot, 0, sizeof(struct mem_snapshot));
+
+    if (capacity) {
+        snapshot->sites = (struct mem_site_stats *)malloc(
+            capacity * sizeof(struct mem_site_stats));
+
+        if (!snapshot->sites) {
+            free(snapshot);
+            return NULL;
+        }
+    }
+
+    return snapshot;
+}
+
+int mem_snapshot_fill(struct mem_snapshot *snapshot, size_t capacity)
+{
+    SNAPSHOT_FILL fill;
+
+    snapshot->time = mem_site_now();
+    snapshot->site_count = 0;
+    page_get_stats(&snapshot->stats);
+
+    fill.snapshot = snapshot;
+    fill.capacity = capacity;
+    mem_site_walk(snapshot_visit, &fill);
+
+    return snapshot->site_count > capacity ? MEM_FAILED : MEM_SUCCESS;
+}
+
+void mem_snapshot_free(struct mem_snapshot *snapshot)
+{
+    if (snapshot) {
+        free(snapshot->sites);
+        free(snapshot);
+    }
+}
+
+struct mem_snapshot_diff *mem_snapshot_diff(
+    const struct mem_snapshot *older, const struct mem_snapshot *newer)
+{
+    int i;
+    size_t j;
+
+    const struct mem_site_stats *now = NULL;
+    const struct mem_site_stats *old = NULL;
+    const struct mem_class_stats *info_now = NULL;
+    const struct mem_class_stats *info_old = NULL;
+
+    struct mem_site_stats *site = NULL;
+    struct mem_snapshot_diff *diff = NULL;
+
+    if (!older || !newer) {
+        return NULL;
+    }
+
+    diff = (struct mem_snapshot_diff *)malloc(sizeof(struct mem_snapshot_diff));
+    if (!diff) {
+        return NULL;
+    }
+
+    memset(diff, 0, sizeof(struct mem_snapshot_diff));
+
+    diff->interval = newer->time > older->time ? newer->time - older->time : 0;
+
+    for (i = 0; i < MEM_STATS_CLASS_COUNT; i++) {
+        info_now = newer->stats.classes + i;
+        info_old = older->stats.classes + i;
+
+        diff->classes[i].block_size  = info_now->block_size;
+        diff->classes[i].live_blocks =
+            (long long)info_now->live_blocks - (long long)info_old->live_blocks;
+        diff->classes[i].live_bytes  =
+            (long long)info_now->live_bytes - (long long)info_old->live_bytes;
+        diff->classes[i].page_count  =
+            (long long)info_now->page_count - (long long)info_old->page_count;
+    }
+
+    if (!newer->site_count) {
+        return diff;
+    }
+
+    diff->sites = (struct mem_site_stats *)malloc(
+        newer->site_count * sizeof(struct mem_site_stats));
+
+    if (!diff->sites) {
+        free(diff);
+        return NULL;
+    }
+
+    /*
+     * 调用位置编号只增不减，快照中按编号排列，同一编号在两次快照中
+     * 位于相同下标；文件或函数不同说明期间调用过 clear_res，视为新增
+     */
+    for (j = 0; j < newer->site_count; j++) {
+        now = newer->sites + j;
+        old = j < older->site_count ? older->sites + j : NULL;
+
+        if (old && (old->id != now->id || old->line != now->line ||
+            old->file != now->file || old->func != now->func)) {
+            old = NULL;
+        }
+
+        if (old && old->live_blocks == now->live_blocks &&
+            old->live_bytes == now->live_bytes) {
+            continue;
+        }
+
+        site = diff->sites + diff->site_count++;
+        *site = *now;
+
+        if (old) {
+            site->live_blocks -= old->live_blocks;
+            site->live_bytes  -= old->live_bytes;
+        }
+
+        if (!site->live_blocks && !site->live_bytes) {
+            diff->site_count--;
+        }
+    }
+
+    qsort(diff->sites, diff->site_count, sizeof(struct mem_site_stats), compare_site);
+    return diff;
+}
+
+void mem_snapshot_print_diff(const struct mem_snapshot_diff *diff)
+{
+    int i;
+    size_t j;
+
+    const struct mem_class_delta *info = NULL;
+    const struct mem_site_stats *site = NULL;
+
+    if (!diff) {
+        return;
+    }
+
+    printf("<============================heap growth============================>\n");
+    printf("interval = %.3fs, sites = %lu\n",
+        (double)diff->interval / 1e9, (unsigned long)diff->site_count);
+
+    for (i = 0; i < MEM_STATS_CLASS_COUNT; i++) {
+        info = diff->classes + i;
+
+        if (!info->live_blocks && !info->live_bytes && !info->page_count) {
+            continue;
+        }
+
+        printf("link %02d block_size = %lu blocks = %+lld bytes = %+lld pages = %+lld\n",
+            i, (unsigned long)info->block_size, info->live_blocks,
+            info->live_bytes, info->page_count);
+    }
+
+    for (j = 0; j < diff->site_count; j++) {
+        site = diff->sites + j;
+
+        printf("[%lu] bytes = %+lld count = %+lld at %s:%d (%s)\n",
+            (unsigned long)j, site->live_bytes, site->live_blocks,
+            site->file, site->line, site->func);
+    }
+
+    printf("<============================heap growth============================>\n");
+}
+
+void mem_snapshot_diff_free(struct mem_snapshot_diff *diff)
+{
+    if (diff) {
+        free(diff->sites);
+        free(diff);
+    }
+}
+
+/*===========================================================================*/
+
+void snapshot_visit(const MEM_SITE *site, void *arg)
+{
+    SNAPSHOT_FILL *fill = (SNAPSHOT_FILL *)arg;
+    struct mem_snapshot *snapshot = fill->snapshot;
+    struct mem_site_stats *info = NULL;
+
+    /* 编号连续，直接作为下标，拷贝后即按编号有序 */
+    if (site->id > snapshot->site_count) {
+        snapshot->site_count = site->id;
+    }
+
+    if (site->id > fill->capacity) {
+        return;
+    }
+
+    info = snapshot->sites + (site->id - 1);
+
+    info->id   = site->id;
+    info->line = site->line;
+    info->file = site->file;
+    info->func = site->func;
+    info->live_blocks = (long long)site->live_blocks;
+    info->live_bytes  = (long long)site->live_bytes;
+}
+
+int compare_site(const void *a, const void *b)
+{
+    const struct mem_site_stats *sa = (const struct mem_site_stats *)a;
+    const struct mem_site_stats *sb = (const struct mem_site_stats *)b;
+
+    if (sa->live_bytes < sb->live_bytes) {
+        return 1;
+    }
+
+    if (sa->live_bytes > sb->live_bytes) {
+        return -1;
+    }
+
+    return 0;
+}
+
+/*===========================================================================*/
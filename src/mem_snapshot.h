@@ -0,0 +1,23 @@
+#ifndef __MEM_SNAPSHOT_H__
+#define __MEM_SNAPSHOT_H__
+
+#include <stddef.h>
+
+/*===========================================================================*/
+/* 堆快照，见 mem.h - mem_snapshot_take */
+/*===========================================================================*/
+
+struct mem_snapshot;
+
+/* 申请可容纳 capacity 个调用位置的空快照，不需要持有分配器锁 */
+struct mem_snapshot *mem_snapshot_alloc(size_t capacity);
+
+/*
+ * 拷贝各内存分类和调用位置的计数器，调用方需持有分配器锁；调用位置
+ * 数量超过 capacity 时返回 -1，并在 site_count 中给出所需容量
+ */
+int mem_snapshot_fill(struct mem_snapshot *snapshot, size_t capacity);
+
+/*===========================================================================*/
+
+#endif /* __MEM_SNAPSHOT_H__ */
@@ -0,0 +1,867 @@
+#if defined(WIN32)
+#define _CRT_SECURE_NO_WARNINGS
+#else
+#define _GNU_SOURCE
+#endif
+
+#include <time.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "mem.h"
+#include "link.h"
+#include "mem_page.h"
+#include "mem_lockstat.h"
+#include "mem_trace.h"
+
+/*===========================================================================*/
+
+#if defined(WIN32)
+#include <windows.h>
+typedef SRWLOCK TRACE_LOCK_HANDLE;
+typedef CONDITION_VARIABLE TRACE_COND_HANDLE;
+#define TRACE_LOCK_INITIALIZER SRWLOCK_INIT
+#define TRACE_COND_INITIALIZER CONDITION_VARIABLE_INIT
+#define TRACE_LOCK(lock, path) \
+    MEM_LOCKSTAT_LOCK(&(lock), MEM_LOCK_ID_TRACE, (path), \
+        TryAcquireSRWLockExclusive(&(lock)), AcquireSRWLockExclusive(&(lock)))
+#define TRACE_UNLOCK(lock) MEM_LOCKSTAT_UNLOCK(MEM_LOCK_ID_TRACE, ReleaseSRWLockExclusive(&(lock)))
+#define TRACE_WAIT(cond, lock) \
+    do { \
+        TRACE_WAIT_RELEASE(); \
+        SleepConditionVariableSRW(&(cond), &(lock), INFINITE, 0); \
+        TRACE_WAIT_ACQUIRED(); \
+    } while (0)
+#define TRACE_SIGNAL(cond) WakeAllConditionVariable(&(cond))
+#define TRACE_STRIPE_INIT(lock) InitializeSRWLock(&(lock))
+#define TRACE_STRIPE_DESTROY(lock) ((void)0)
+#define TRACE_STRIPE_LOCK(lock) AcquireSRWLockExclusive(&(lock))
+#define TRACE_STRIPE_UNLOCK(lock) ReleaseSRWLockExclusive(&(lock))
+#define TRACE_STORE(ptr, val) InterlockedExchange((volatile LONG *)(ptr), (LONG)(val))
+#define TRACE_RELEASE(ptr, val) (*(ptr) = (val))
+#define TRACE_LOAD(ptr) (*(ptr))
+#define TRACE_FETCH_ADD(ptr, val) \
+    ((unsigned long long)InterlockedExchangeAdd64((volatile LONGLONG *)(ptr), (LONGLONG)(val)))
+#define TRACE_YIELD() SwitchToThread()
+#define TRACE_TLS __declspec(thread)
+#else /* Linux */
+#include <sched.h>
+#include <pthread.h>
+typedef pthread_mutex_t TRACE_LOCK_HANDLE;
+typedef pthread_cond_t TRACE_COND_HANDLE;
+#define TRACE_LOCK_INITIALIZER PTHREAD_MUTEX_INITIALIZER
+#define TRACE_COND_INITIALIZER PTHREAD_COND_INITIALIZER
+#define TRACE_LOCK(lock, path) \
+    MEM_LOCKSTAT_LOCK(&(lock), MEM_LOCK_ID_TRACE, (path), \
+        !pthread_mutex_trylock(&(lock)), pthread_mutex_lock(&(lock)))
+#define TRACE_UNLOCK(lock) MEM_LOCKSTAT_UNLOCK(MEM_LOCK_ID_TRACE, pthread_mutex_unlock(&(lock)))
+#define TRACE_WAIT(cond, lock) \
+    do { \
+        TRACE_WAIT_RELEASE(); \
+        pthread_cond_wait(&(cond), &(lock)); \
+        TRACE_WAIT_ACQUIRED(); \
+    } while (0)
+#define TRACE_SIGNAL(cond) pthread_cond_broadcast(&(cond))
+#define TRACE_STRIPE_INIT(lock) pthread_mutex_init(&(lock), NULL)
+#define TRACE_STRIPE_DESTROY(lock) pthread_mutex_destroy(&(lock))
+#define TRACE_STRIPE_LOCK(lock) pthread_mutex_lock(&(lock))
+#define TRACE_STRIPE_UNLOCK(lock) pthread_mutex_unlock(&(lock))
+#define TRACE_STORE(ptr, val) __atomic_store_n((ptr), (val), __ATOMIC_SEQ_CST)
+#define TRACE_RELEASE(ptr, val) __atomic_store_n((ptr), (val), __ATOMIC_RELEASE)
+#define TRACE_LOAD(ptr) __atomic_load_n((ptr), __ATOMIC_SEQ_CST)
+#define TRACE_FETCH_ADD(ptr, val) __atomic_fetch_add((ptr), (val), __ATOMIC_RELAXED)
+#define TRACE_YIELD() sched_yield()
+#define TRACE_TLS __thread
+#endif /* WIN32 & Linux */
+
+/* 条件变量等待期间锁被释放，等待前后分别计入锁竞争统计 */
+#define TRACE_WAIT_RELEASE() \
+    do { \
+        if (mem_lockstat_on) { \
+            mem_lockstat_release(MEM_LOCK_ID_TRACE); \
+        } \
+    } while (0)
+#define TRACE_WAIT_ACQUIRED() \
+    do { \
+        if (mem_lockstat_on) { \
+            mem_lockstat_acquired(MEM_LOCK_ID_TRACE, MEM_LOCK_PATH_OTHER, 0); \
+        } \
+    } while (0)
+
+/*===========================================================================*/
+
+#define MEM_TRACE_BUFFER_EVENTS 2048    /* 线程缓冲区可容纳的事件数量 */
+#define MEM_TRACE_MAX_PENDING   64      /* 等待写线程写出的缓冲区数量上限 */
+#define MEM_TRACE_ID_BATCH      1024    /* 线程每次预留的对象编号数量 */
+
+#define MEM_TRACE_STRIPE_BITS   6       /* 对象编号哈希表按地址分为 2^n 段 */
+#define MEM_TRACE_STRIPES       (1 << MEM_TRACE_STRIPE_BITS)
+#define MEM_TRACE_INIT_BUCKETS  256     /* 每段哈希表初始桶数量，必须为 2 的幂 */
+#define MEM_TRACE_SLAB_OBJECTS  512     /* 每段每次预分配的映射节点数量 */
+
+/* 地址的哈希值，高位选择分段，中间的位选择段内的桶 */
+#define TRACE_HASH(ptr) \
+    (((unsigned long long)(size_t)(ptr) >> 3) * 0x9E3779B97F4A7C15ULL)
+#define TRACE_STRIPE_OF(hash) ((size_t)((hash) >> (64 - MEM_TRACE_STRIPE_BITS)))
+#define TRACE_SLOT_OF(hash, buckets) ((size_t)((hash) >> 16) & ((buckets) - 1))
+
+/* 线程缓冲区，写满或停止记录时交给写线程，以一个数据块写入文件 */
+typedef struct {
+    LINK_NODE node;
+
+    unsigned int thread;            /* 线程编号，从 1 开始 */
+    unsigned int count;             /* 已缓冲的事件数量 */
+    unsigned char data[MEM_TRACE_BUFFER_EVENTS * MEM_TRACE_EVENT_SIZE];
+} TRACE_BUFFER;
+
+/*
+ * 线程的记录状态，线程首次记录时创建，之后每次开始记录时重新登记；
+ * 线程持有的指针在停止记录后仍可能被读取，因此不会释放
+ */
+typedef struct trace_thread_st TRACE_THREAD;
+struct trace_thread_st {
+    TRACE_THREAD *next;
+
+    volatile int busy;              /* 正在记录事件，停止记录时等待其清零 */
+    volatile unsigned int generation; /* 登记时的记录代数 */
+    unsigned int thread;            /* 本次记录中的线程编号 */
+
+    unsigned long long next_id;     /* 预留的对象编号区间 [next_id, last_id) */
+    unsigned long long last_id;
+
+    TRACE_BUFFER *buffer;           /* 当前缓冲区，为 NULL 时丢弃事件 */
+    char pad[64];
+};
+
+/* 内存地址到对象编号的映射 */
+typedef struct trace_object_st TRACE_OBJECT;
+struct trace_object_st {
+    TRACE_OBJECT *next;
+
+    void *ptr;
+    unsigned long long id;
+};
+
+/* 预分配的映射节点 */
+typedef struct trace_slab_st TRACE_SLAB;
+struct trace_slab_st {
+    TRACE_SLAB *next;
+    TRACE_OBJECT objects[MEM_TRACE_SLAB_OBJECTS];
+};
+
+/*
+ * 对象编号哈希表的一段，各段有独立的锁、桶数组和映射节点；分段锁
+ * 不计入锁竞争统计，统计按锁编号记录且只在持有该锁时修改
+ */
+typedef struct {
+    TRACE_LOCK_HANDLE lock;
+
+    TRACE_OBJECT **table;
+    size_t buckets;
+    size_t count;
+
+    TRACE_OBJECT *idle;             /* 空闲映射节点 */
+    TRACE_SLAB *slabs;              /* 已分配的映射节点，停止记录时释放 */
+
+    char pad[64];
+} TRACE_STRIPE;
+
+/*===========================================================================*/
+
+volatile int mem_trace_on = 0;
+
+/* 保护文件、缓冲区队列和线程登记，事件记录本身不持有 */
+static TRACE_LOCK_HANDLE trace_lock = TRACE_LOCK_INITIALIZER;
+static TRACE_COND_HANDLE trace_cond = TRACE_COND_INITIALIZER;
+
+static FILE *trace_file = NULL;
+
+/* 每次开始记录时递增，使线程的旧登记失效 */
+static volatile unsigned int trace_generation = 0;
+
+/* 所有登记过的线程，只增不减 */
+static TRACE_THREAD *trace_thread_list = NULL;
+static unsigned int trace_threads = 0;
+
+/* 当前线程的记录状态 */
+static TRACE_TLS TRACE_THREAD *trace_thread = NULL;
+
+/* 等待写出的缓冲区和已写出可复用的缓冲区 */
+static LINK trace_full;
+static LINK trace_spare;
+static int trace_stopping = 0;      /* 通知写线程写完队列后退出 */
+
+#if defined(WIN32)
+static HANDLE trace_writer = NULL;
+#else /* Linux */
+static pthread_t trace_writer;
+#endif /* WIN32 & Linux */
+
+/* 对象编号哈希表 */
+static TRACE_STRIPE trace_stripes[MEM_TRACE_STRIPES];
+
+/* 已预留的最大对象编号 */
+static volatile unsigned long long trace_next_id = 0;
+
+/* 开始记录的时刻 */
+static unsigned long long trace_start_time = 0;
+
+/*===========================================================================*/
+
+/* 单调时钟，单位为纳秒 */
+static unsigned long long trace_now();
+
+/* 开始记录一个事件，未在记录时返回 NULL，否则需调用 trace_leave */
+static TRACE_THREAD *trace_enter();
+static void trace_leave(TRACE_THREAD *thread);
+
+/* 为当前线程登记本次记录 */
+static TRACE_THREAD *register_thread();
+
+/* 分配对象编号，线程按批从全局预留 */
+static unsigned long long next_id(TRACE_THREAD *thread);
+
+/* 追加一个事件到线程缓冲区 */
+static void put_event(TRACE_THREAD *thread, int op, size_t len, unsigned long long id);
+
+/* 取一个空缓冲区，优先复用已写出的缓冲区 */
+static TRACE_BUFFER *take_buffer(unsigned int thread);
+
+/* 将写满的缓冲区交给写线程，返回新的空缓冲区 */
+static TRACE_BUFFER *submit_buffer(TRACE_BUFFER *buffer);
+
+/* 写线程，逐个写出队列中的缓冲区 */
+#if defined(WIN32)
+static DWORD WINAPI trace_run(LPVOID arg);
+#else /* Linux */
+static void *trace_run(void *arg);
+#endif /* WIN32 & Linux */
+
+/* 释放所有缓冲区，调用方需确保写线程已退出 */
+static void free_buffers();
+
+/* 对象编号哈希表操作，持有所属分段的锁 */
+static int init_objects();
+static int insert_object(void *ptr, unsigned long long id);
+static unsigned long long remove_object(void *ptr);
+static void clear_objects();
+
+/* 扩容分段的桶数组，调用方需持有分段锁 */
+static void grow_stripe(TRACE_STRIPE *stripe);
+
+/* 为分段预分配一批映射节点，调用方需持有分段锁或确保没有并发 */
+static int fill_stripe(TRACE_STRIPE *stripe);
+
+/* 小端序写入 */
+static void put_u32(unsigned char *cursor, unsigned long long value);
+static void put_u64(unsigned char *cursor, unsigned long long value);
+
+/*===========================================================================*/
+
+int mem_trace_start(const char *path)
+{
+    int ret = MEM_SUCCESS;
+    unsigned char header[MEM_TRACE_HEADER_SIZE];
+
+    if (!path) {
+        return MEM_FAILED;
+    }
+
+    mem_trace_stop();
+
+    TRACE_LOCK(trace_lock, MEM_LOCK_PATH_OTHER);
+
+    trace_file = fopen(path, "wb");
+    if (!trace_file) {
+        TRACE_UNLOCK(trace_lock);
+        return MEM_FAILED;
+    }
+
+    memset(header, 0, sizeof(header));
+    memcpy(header, MEM_TRACE_MAGIC, MEM_TRACE_MAGIC_SIZE);
+    put_u32(header + MEM_TRACE_MAGIC_SIZE, MEM_TRACE_VERSION);
+
+    if (fwrite(header, 1, sizeof(header), trace_file) != sizeof(header) ||
+        init_objects() != MEM_SUCCESS) {
+        ret = MEM_FAILED;
+    }
+
+    if (ret == MEM_SUCCESS) {
+        link_reset(&trace_full);
+        link_reset(&trace_spare);
+        trace_stopping = 0;
+
+#if defined(WIN32)
+        trace_writer = CreateThread(NULL, 0, trace_run, NULL, 0, NULL);
+        ret = trace_writer ? MEM_SUCCESS : MEM_FAILED;
+#else /* Linux */
+        ret = pthread_create(&trace_writer, NULL, trace_run, NULL) ? MEM_FAILED : MEM_SUCCESS;
+#endif /* WIN32 & Linux */
+    }
+
+    if (ret != MEM_SUCCESS) {
+        clear_objects();
+        fclose(trace_file);
+        trace_file = NULL;
+
+        TRACE_UNLOCK(trace_lock);
+        return MEM_FAILED;
+    }
+
+    TRACE_STORE(&trace_generation, trace_generation + 1);
+    trace_threads = 0;
+    trace_next_id = 0;
+    trace_start_time = trace_now();
+
+    TRACE_STORE(&mem_trace_on, 1);
+
+    TRACE_UNLOCK(trace_lock);
+    return MEM_SUCCESS;
+}
+
+void mem_trace_stop()
+{
+    TRACE_THREAD *list = NULL;
+    TRACE_THREAD *thread = NULL;
+
+    TRACE_LOCK(trace_lock, MEM_LOCK_PATH_OTHER);
+
+    if (!trace_file) {
+        TRACE_UNLOCK(trace_lock);
+        return;
+    }
+
+    /* 关闭之后不再有线程登记，已登记的线程见 trace_enter */
+    TRACE_STORE(&mem_trace_on, 0);
+    list = trace_thread_list;
+
+    TRACE_UNLOCK(trace_lock);
+
+    /* 等待正在记录事件的线程完成，之后缓冲区和哈希表不再被访问 */
+    for (thread = list; thread; thread = thread->next) {
+        while (TRACE_LOAD(&thread->busy)) {
+            TRACE_YIELD();
+        }
+    }
+
+    TRACE_LOCK(trace_lock, MEM_LOCK_PATH_OTHER);
+
+    /* 交出所有线程未写满的缓冲区，由写线程写完后退出 */
+    for (thread = list; thread; thread = thread->next) {
+        if (thread->generation == trace_generation && thread->buffer) {
+            link_push(thread->buffer->count ? &trace_full : &trace_spare,
+                &thread->buffer->node);
+            thread->buffer = NULL;
+        }
+    }
+
+    trace_stopping = 1;
+    TRACE_SIGNAL(trace_cond);
+
+    TRACE_UNLOCK(trace_lock);
+
+#if defined(WIN32)
+    WaitForSingleObject(trace_writer, INFINITE);
+    CloseHandle(trace_writer);
+    trace_writer = NULL;
+#else /* Linux */
+    pthread_join(trace_writer, NULL);
+#endif /* WIN32 & Linux */
+
+    TRACE_LOCK(trace_lock, MEM_LOCK_PATH_OTHER);
+
+    free_buffers();
+    clear_objects();
+
+    fclose(trace_file);
+    trace_file = NULL;
+
+    TRACE_UNLOCK(trace_lock);
+}
+
+void mem_trace_malloc(void *ptr, size_t len)
+{
+    unsigned long long id = 0;
+    TRACE_THREAD *thread = NULL;
+
+    if (!ptr || (thread = trace_enter()) == NULL) {
+        return;
+    }
+
+    id = next_id(thread);
+
+    if (insert_object(ptr, id) == MEM_SUCCESS) {
+        put_event(thread, MEM_TRACE_MALLOC, len, id);
+    }
+
+    trace_leave(thread);
+}
+
+void mem_trace_free(void *ptr)
+{
+    unsigned long long id = 0;
+    TRACE_THREAD *thread = NULL;
+
+    if (!ptr || (thread = trace_enter()) == NULL) {
+        return;
+    }
+
+    id = remove_object(ptr);
+    if (id) {
+        put_event(thread, MEM_TRACE_FREE, 0, id);
+    }
+
+    trace_leave(thread);
+}
+
+unsigned long long mem_trace_realloc_begin(void *ptr)
+{
+    unsigned long long id = 0;
+    TRACE_THREAD *thread = NULL;
+
+    if (!ptr || (thread = trace_enter()) == NULL) {
+        return 0;
+    }
+
+    /*
+     * 先移除原地址的映射：realloc 释放原内存块后，其他线程可能在
+     * realloc_end 之前重新分配到同一地址
+     */
+    id = remove_object(ptr);
+
+    trace_leave(thread);
+    return id;
+}
+
+void mem_trace_realloc_end(unsigned long long id, void *ptr, void *ret, size_t len)
+{
+    TRACE_THREAD *thread = NULL;
+
+    if (!id || (thread = trace_enter()) == NULL) {
+        return;
+    }
+
+    if (ret) {
+        if (insert_object(ret, id) == MEM_SUCCESS) {
+            put_event(thread, MEM_TRACE_REALLOC, len, id);
+        }
+    } else {
+        insert_object(ptr, id);
+    }
+
+    trace_leave(thread);
+}
+
+/*===========================================================================*/
+
+unsigned long long trace_now()
+{
+#if defined(WIN32)
+    LARGE_INTEGER count;
+    LARGE_INTEGER freq;
+
+    QueryPerformanceCounter(&count);
+    QueryPerformanceFrequency(&freq);
+
+    return (unsigned long long)((double)count.QuadPart * 1e9 / (double)freq.QuadPart);
+#else /* Linux */
+    struct timespec ts;
+
+    if (clock_gettime(CLOCK_MONOTONIC, &ts)) {
+        return 0;
+    }
+
+    return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+#endif /* WIN32 & Linux */
+}
+
+TRACE_THREAD *trace_enter()
+{
+    TRACE_THREAD *thread = trace_thread;
+
+    if (!thread || thread->generation != TRACE_LOAD(&trace_generation)) {
+        thread = register_thread();
+        if (!thread) {
+            return NULL;
+        }
+    }
+
+    /*
+     * 先置忙再检查开关，与 mem_trace_stop 先关闭开关再等待忙标志相对：
+     * 两者都使用顺序一致的原子操作，停止记录时要么看到本线程正忙，
+     * 要么本线程看到开关已关闭
+     */
+    TRACE_STORE(&thread->busy, 1);
+
+    if (!TRACE_LOAD(&mem_trace_on) || thread->generation != TRACE_LOAD(&trace_generation)) {
+        TRACE_RELEASE(&thread->busy, 0);
+        return NULL;
+    }
+
+    return thread;
+}
+
+void trace_leave(TRACE_THREAD *thread)
+{
+    TRACE_RELEASE(&thread->busy, 0);
+}
+
+TRACE_THREAD *register_thread()
+{
+    TRACE_THREAD *thread = trace_thread;
+
+    TRACE_LOCK(trace_lock, MEM_LOCK_PATH_OTHER);
+
+    if (!mem_trace_on) {
+        TRACE_UNLOCK(trace_lock);
+        return NULL;
+    }
+
+    if (!thread) {
+        thread = (TRACE_THREAD *)calloc(1, sizeof(TRACE_THREAD));
+        if (!thread) {
+            TRACE_UNLOCK(trace_lock);
+            return NULL;
+        }
+
+        thread->next = trace_thread_list;
+        trace_thread_list = thread;
+        trace_thread = thread;
+    }
+
+    thread->thread = ++trace_threads;
+    thread->next_id = 0;
+    thread->last_id = 0;
+    thread->generation = trace_generation;
+
+    /* 没有可复用的缓冲区时在首次记录事件时于锁外申请，见 put_event */
+    thread->buffer = (TRACE_BUFFER *)link_pop(&trace_spare);
+    if (thread->buffer) {
+        thread->buffer->thread = thread->thread;
+        thread->buffer->count = 0;
+    }
+
+    TRACE_UNLOCK(trace_lock);
+    return thread;
+}
+
+unsigned long long next_id(TRACE_THREAD *thread)
+{
+    if (thread->next_id == thread->last_id) {
+        thread->next_id = TRACE_FETCH_ADD(&trace_next_id, MEM_TRACE_ID_BATCH) + 1;
+        thread->last_id = thread->next_id + MEM_TRACE_ID_BATCH;
+    }
+
+    return thread->next_id++;
+}
+
+void put_event(TRACE_THREAD *thread, int op, size_t len, unsigned long long id)
+{
+    unsigned char *cursor = NULL;
+    TRACE_BUFFER *buffer = thread->buffer;
+
+    if (!buffer) {
+        buffer = thread->buffer = take_buffer(thread->thread);
+        if (!buffer) {
+            return;
+        }
+    }
+
+    cursor = buffer->data + buffer->count * MEM_TRACE_EVENT_SIZE;
+
+    cursor[0] = (unsigned char)op;
+    cursor[1] = cursor[2] = cursor[3] = 0;
+    put_u32(cursor + 4, (unsigned long long)len);
+    put_u64(cursor + 8, id);
+    put_u64(cursor + 16, trace_now() - trace_start_time);
+
+    if (++buffer->count == MEM_TRACE_BUFFER_EVENTS) {
+        thread->buffer = submit_buffer(buffer);
+    }
+}
+
+TRACE_BUFFER *take_buffer(unsigned int thread)
+{
+    TRACE_BUFFER *buffer = NULL;
+
+    TRACE_LOCK(trace_lock, MEM_LOCK_PATH_OTHER);
+    buffer = (TRACE_BUFFER *)link_pop(&trace_spare);
+    TRACE_UNLOCK(trace_lock);
+
+    if (!buffer) {
+        buffer = (TRACE_BUFFER *)malloc(sizeof(TRACE_BUFFER));
+        if (!buffer) {
+            return NULL;
+        }
+    }
+
+    buffer->thread = thread;
+    buffer->count = 0;
+
+    return buffer;
+}
+
+TRACE_BUFFER *submit_buffer(TRACE_BUFFER *buffer)
+{
+    unsigned int thread = buffer->thread;
+    TRACE_BUFFER *spare = NULL;
+
+    TRACE_LOCK(trace_lock, MEM_LOCK_PATH_OTHER);
+
+    /* 写线程跟不上时等待，积压的缓冲区不超过上限 */
+    while (trace_full.count >= MEM_TRACE_MAX_PENDING) {
+        TRACE_WAIT(trace_cond, trace_lock);
+    }
+
+    link_push(&trace_full, &buffer->node);
+    spare = (TRACE_BUFFER *)link_pop(&trace_spare);
+
+    TRACE_SIGNAL(trace_cond);
+    TRACE_UNLOCK(trace_lock);
+
+    if (!spare) {
+        return take_buffer(thread);
+    }
+
+    spare->thread = thread;
+    spare->count = 0;
+
+    return spare;
+}
+
+#if defined(WIN32)
+DWORD WINAPI trace_run(LPVOID arg)
+#else /* Linux */
+void *trace_run(void *arg)
+#endif /* WIN32 & Linux */
+{
+    TRACE_BUFFER *buffer = NULL;
+    unsigned char chunk[MEM_TRACE_CHUNK_SIZE];
+
+    (void)arg;
+
+    TRACE_LOCK(trace_lock, MEM_LOCK_PATH_OTHER);
+
+    for (;;) {
+        while (!trace_full.count && !trace_stopping) {
+            TRACE_WAIT(trace_cond, trace_lock);
+        }
+
+        if (!trace_full.count) {
+            break;
+        }
+
+        /* 先写满的先写出，文件只由写线程访问 */
+        buffer = (TRACE_BUFFER *)link_remove_force(&trace_full, trace_full.head);
+
+        TRACE_UNLOCK(trace_lock);
+
+        put_u32(chunk, buffer->thread);
+        put_u32(chunk + 4, buffer->count);
+
+        fwrite(chunk, 1, sizeof(chunk), trace_file);
+        fwrite(buffer->data, MEM_TRACE_EVENT_SIZE, buffer->count, trace_file);
+
+        TRACE_LOCK(trace_lock, MEM_LOCK_PATH_OTHER);
+
+        link_push(&trace_spare, &buffer->node);
+        TRACE_SIGNAL(trace_cond);
+    }
+
+    TRACE_UNLOCK(trace_lock);
+
+#if defined(WIN32)
+    return 0;
+#else /* Linux */
+    return NULL;
+#endif /* WIN32 & Linux */
+}
+
+void free_buffers()
+{
+    TRACE_BUFFER *buffer = NULL;
+
+    while ((buffer = (TRACE_BUFFER *)link_pop(&trace_spare)) != NULL) {
+        free(buffer);
+    }
+}
+
+int init_objects()
+{
+    int i;
+    TRACE_STRIPE *stripe = NULL;
+
+    memset(trace_stripes, 0, sizeof(trace_stripes));
+
+    for (i = 0; i < MEM_TRACE_STRIPES; i++) {
+        stripe = trace_stripes + i;
+        TRACE_STRIPE_INIT(stripe->lock);
+
+        stripe->table = (TRACE_OBJECT **)calloc(MEM_TRACE_INIT_BUCKETS, sizeof(TRACE_OBJECT *));
+        if (!stripe->table || fill_stripe(stripe) != MEM_SUCCESS) {
+            clear_objects();
+            return MEM_FAILED;
+        }
+
+        stripe->buckets = MEM_TRACE_INIT_BUCKETS;
+    }
+
+    return MEM_SUCCESS;
+}
+
+int insert_object(void *ptr, unsigned long long id)
+{
+    unsigned long long hash = TRACE_HASH(ptr);
+    TRACE_STRIPE *stripe = trace_stripes + TRACE_STRIPE_OF(hash);
+    TRACE_OBJECT *object = NULL;
+    size_t slot = 0;
+
+    TRACE_STRIPE_LOCK(stripe->lock);
+
+    /* 平均链长超过 1 时扩容 */
+    if (stripe->count >= stripe->buckets) {
+        grow_stripe(stripe);
+    }
+
+    if (!stripe->idle && fill_stripe(stripe) != MEM_SUCCESS) {
+        TRACE_STRIPE_UNLOCK(stripe->lock);
+        return MEM_FAILED;
+    }
+
+    object = stripe->idle;
+    stripe->idle = object->next;
+
+    slot = TRACE_SLOT_OF(hash, stripe->buckets);
+
+    object->ptr = ptr;
+    object->id = id;
+    object->next = stripe->table[slot];
+    stripe->table[slot] = object;
+
+    stripe->count++;
+
+    TRACE_STRIPE_UNLOCK(stripe->lock);
+    return MEM_SUCCESS;
+}
+
+unsigned long long remove_object(void *ptr)
+{
+    unsigned long long id = 0;
+    unsigned long long hash = TRACE_HASH(ptr);
+    TRACE_STRIPE *stripe = trace_stripes + TRACE_STRIPE_OF(hash);
+    TRACE_OBJECT **link = NULL;
+    TRACE_OBJECT *object = NULL;
+
+    TRACE_STRIPE_LOCK(stripe->lock);
+
+    link = stripe->table + TRACE_SLOT_OF(hash, stripe->buckets);
+
+    for (; *link; link = &(*link)->next) {
+        if ((*link)->ptr == ptr) {
+            object = *link;
+            *link = object->next;
+
+            id = object->id;
+
+            /* 节点放回分段的空闲链表 */
+            object->next = stripe->idle;
+            stripe->idle = object;
+
+            stripe->count--;
+            break;
+        }
+    }
+
+    TRACE_STRIPE_UNLOCK(stripe->lock);
+    return id;
+}
+
+void clear_objects()
+{
+    int i;
+    TRACE_SLAB *slab = NULL;
+    TRACE_STRIPE *stripe = NULL;
+
+    for (i = 0; i < MEM_TRACE_STRIPES; i++) {
+        stripe = trace_stripes + i;
+
+        while (stripe->slabs) {
+            slab = stripe->slabs;
+            stripe->slabs = slab->next;
+            free(slab);
+        }
+
+        free(stripe->table);
+        TRACE_STRIPE_DESTROY(stripe->lock);
+    }
+
+    memset(trace_stripes, 0, sizeof(trace_stripes));
+}
+
+void grow_stripe(TRACE_STRIPE *stripe)
+{
+    size_t i;
+    size_t slot = 0;
+    size_t buckets = stripe->buckets * 2;
+
+    TRACE_OBJECT *object = NULL;
+    TRACE_OBJECT **table = NULL;
+
+    /* 扩容失败时继续使用原桶数组，只是链长变长 */
+    table = (TRACE_OBJECT **)calloc(buckets, sizeof(TRACE_OBJECT *));
+    if (!table) {
+        return;
+    }
+
+    for (i = 0; i < stripe->buckets; i++) {
+        while (stripe->table[i]) {
+            object = stripe->table[i];
+            stripe->table[i] = object->next;
+
+            slot = TRACE_SLOT_OF(TRACE_HASH(object->ptr), buckets);
+            object->next = table[slot];
+            table[slot] = object;
+        }
+    }
+
+    free(stripe->table);
+    stripe->table = table;
+    stripe->buckets = buckets;
+}
+
+int fill_stripe(TRACE_STRIPE *stripe)
+{
+    int i;
+    TRACE_SLAB *slab = (TRACE_SLAB *)malloc(sizeof(TRACE_SLAB));
+
+    if (!slab) {
+        return MEM_FAILED;
+    }
+
+    slab->next = stripe->slabs;
+    stripe->slabs = slab;
+
+    for (i = MEM_TRACE_SLAB_OBJECTS - 1; i >= 0; i--) {
+        slab->objects[i].next = stripe->idle;
+        stripe->idle = slab->objects + i;
+    }
+
+    return MEM_SUCCESS;
+}
+
+void put_u32(unsigned char *cursor, unsigned long long value)
+{
+    cursor[0] = (unsigned char)(value);
+    cursor[1] = (unsigned char)(value >> 8);
+    cursor[2] = (unsigned char)(value >> 16);
+    cursor[3] = (unsigned char)(value >> 24);
+}
+
+void put_u64(unsigned char *cursor, unsigned long long value)
+{
+    put_u32(cursor, value);
+    put_u32(cursor + 4, value >> 32);
+}
+
+/*===========================================================================*/
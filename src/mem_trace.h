@@ -0,0 +1,61 @@
+#ifndef __MEM_TRACE_H__
+#define __MEM_TRACE_H__
+
+#include <stddef.h>
+
+/*===========================================================================*/
+/* 分配轨迹记录 */
+/*===========================================================================*/
+
+/*
+ * 轨迹文件以 8 字节的 MEM_TRACE_MAGIC 开头，之后是 4 字节版本号和 4 字节
+ * 保留字段；其后由若干数据块组成，每个数据块为：
+ *
+ * 4 字节线程编号 + 4 字节事件数量 + 事件 * n
+ *
+ * 每个事件固定 MEM_TRACE_EVENT_SIZE 字节：1 字节操作类型、3 字节保留、
+ * 4 字节申请尺寸、8 字节对象编号、8 字节时间戳（距开始记录的纳秒数），
+ * 所有整数均为小端序。
+ *
+ * 事件记录不持有全局锁：事件追加到线程缓冲区，时间戳取自单调时钟，
+ * 各线程之间不保证互不相同，回放时按时间戳排序恢复全局顺序，时间戳
+ * 相同的事件按所属线程内的先后排列；同一对象的分配在释放之前完成，
+ * 两者的时间戳分别在分配之后、释放之前取得，排序后次序不会颠倒。
+ *
+ * 同一线程的事件按发生顺序排列，不同线程的数据块交错写入；对象编号在
+ * malloc 时分配，从 1 开始，线程按批预留，因此编号不连续；realloc 保持
+ * 编号不变，编号不会复用，回放时跨线程的释放据此等待对应的分配完成。
+ * 开始记录之前分配的内存块没有编号，对其的 free 和 realloc 不做记录。
+ */
+
+#define MEM_TRACE_VERSION       1
+#define MEM_TRACE_MAGIC         "MMTRACE\0"
+#define MEM_TRACE_MAGIC_SIZE    8
+#define MEM_TRACE_HEADER_SIZE   16
+#define MEM_TRACE_CHUNK_SIZE    8
+#define MEM_TRACE_EVENT_SIZE    24
+
+/* 操作类型 */
+#define MEM_TRACE_MALLOC        1
+#define MEM_TRACE_FREE          2
+#define MEM_TRACE_REALLOC       3
+
+/* 是否正在记录，未开启时每次分配只多一次比较 */
+extern volatile int mem_trace_on;
+
+/* 记录一次分配，在分配成功之后调用 */
+void mem_trace_malloc(void *ptr, size_t len);
+
+/* 记录一次释放，在释放之前调用 */
+void mem_trace_free(void *ptr);
+
+/*
+ * 记录一次 realloc：begin 在 realloc 之前调用，取出原内存块的编号；
+ * end 在 realloc 之后调用，ret 为 NULL 时原内存块仍然有效
+ */
+unsigned long long mem_trace_realloc_begin(void *ptr);
+void mem_trace_realloc_end(unsigned long long id, void *ptr, void *ret, size_t len);
+
+/*===========================================================================*/
+
+#endif /* __MEM_TRACE_H__ */
@@ -0,0 +1,444 @@
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sched.h>
+#include <pthread.h>
+
+#include "mem_trace.h"
+#include "bench_util.h"
+
+/*===========================================================================*/
+/* 分配轨迹回放工具，按轨迹中的线程划分回放，跨线程的释放等待对应的分配完成 */
+/*===========================================================================*/
+
+#define REPLAY_MAX_THREADS  1024
+
+/* 解码后的事件 */
+typedef struct {
+    unsigned long long id;
+    unsigned long long time;
+    unsigned int size;
+    unsigned int seq;                   /* 本事件是所属对象的第几个事件，从 0 开始 */
+    int op;
+} REPLAY_EVENT;
+
+/* 轨迹中的一个线程 */
+typedef struct {
+    unsigned int thread;                /* 轨迹中的线程编号 */
+    REPLAY_EVENT *events;
+    size_t count;
+    size_t capacity;
+
+    const BENCH_ALLOC *alloc;           /* 回放时使用的分配器 */
+    unsigned long long ops;             /* 实际执行的操作次数 */
+} REPLAY_THREAD;
+
+/* 整个轨迹 */
+typedef struct {
+    REPLAY_THREAD threads[REPLAY_MAX_THREADS];
+    int thread_count;
+
+    REPLAY_EVENT **order;               /* 按时间戳排列的所有事件 */
+    unsigned long long events;
+    unsigned long long objects;         /* 轨迹中分配的对象数量 */
+    unsigned long long max_id;          /* 对象编号按线程分批预留，可能大于对象数量 */
+    unsigned long long duration;        /* 记录时长，单位为纳秒 */
+    int serial;                         /* 是否在单线程中按记录时间顺序回放 */
+} REPLAY;
+
+/* 对象表，以对象编号为下标，applied 为对象上已完成的事件数量 */
+static void **replay_objects = NULL;
+static volatile unsigned int *replay_applied = NULL;
+
+/*===========================================================================*/
+
+/* 读取轨迹文件 */
+static int replay_load(REPLAY *replay, const char *path);
+
+/* 按时间戳合并所有线程的事件，并给出每个事件在所属对象上的序号 */
+static int replay_order(REPLAY *replay);
+static int compare_event(const void *a, const void *b);
+
+/* 同一对象上事件的先后次序 */
+static int event_rank(const REPLAY_EVENT *event);
+
+/* 获取或登记轨迹中的线程 */
+static REPLAY_THREAD *replay_thread(REPLAY *replay, unsigned int thread);
+
+/* 回放一次，在子进程中运行 */
+static void replay_run(const BENCH_ALLOC *alloc, void *arg, BENCH_RESULT *result);
+static void *replay_entry(void *arg);
+
+/* 回放一个事件 */
+static void replay_event(const BENCH_ALLOC *alloc, const REPLAY_EVENT *event);
+
+/* 等待对象上之前的事件全部完成 */
+static void wait_turn(const REPLAY_EVENT *event);
+
+static unsigned long long get_u32(const unsigned char *cursor);
+static unsigned long long get_u64(const unsigned char *cursor);
+
+/*===========================================================================*/
+
+int main(int argc, char *argv[])
+{
+    int i;
+    int j;
+    const char *path = NULL;
+    const char *which = NULL;
+
+    REPLAY *replay = NULL;
+    BENCH_RESULT result;
+    const BENCH_ALLOC *allocs[] = { &bench_mem_alloc, &bench_sys_alloc };
+
+    replay = (REPLAY *)calloc(1, sizeof(REPLAY));
+    if (!replay) {
+        return 1;
+    }
+
+    for (i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-a") && i + 1 < argc) {
+            which = argv[++i];
+        } else if (!strcmp(argv[i], "-1")) {
+            replay->serial = 1;
+        } else if (argv[i][0] != '-') {
+            path = argv[i];
+        }
+    }
+
+    if (!path) {
+        printf("usage: %s [-a mem|glibc] [-1] <trace file>\n", argv[0]);
+        printf("  -1  replay all threads in one thread, ordered by timestamp\n");
+        return 1;
+    }
+
+    if (replay_load(replay, path) || replay_order(replay)) {
+        printf("%s is not a valid trace\n", path);
+        free(replay);
+        return 1;
+    }
+
+    printf("trace = %s, threads = %d, events = %llu, objects = %llu, duration = %.3fs\n",
+        path, replay->thread_count, replay->events, replay->objects,
+        (double)replay->duration / 1e9);
+
+    bench_print_head();
+
+    for (j = 0; j < 2; j++) {
+        if (which && strcmp(which, allocs[j]->name)) {
+            continue;
+        }
+
+        if (bench_run(replay_run, allocs[j], replay, &result)) {
+            printf("%-24s %-6s failed\n", replay->serial ? "replay_serial" : "replay",
+                allocs[j]->name);
+            continue;
+        }
+
+        bench_print(replay->serial ? "replay_serial" : "replay", allocs[j]->name, &result);
+    }
+
+    for (i = 0; i < replay->thread_count; i++) {
+        free(replay->threads[i].events);
+    }
+
+    free(replay->order);
+    free(replay);
+
+    return 0;
+}
+
+/*===========================================================================*/
+
+int replay_load(REPLAY *replay, const char *path)
+{
+    unsigned int i;
+    unsigned int count = 0;
+
+    FILE *fp = NULL;
+    REPLAY_THREAD *thread = NULL;
+    REPLAY_EVENT *event = NULL;
+
+    unsigned char header[MEM_TRACE_HEADER_SIZE];
+    unsigned char chunk[MEM_TRACE_CHUNK_SIZE];
+    unsigned char data[MEM_TRACE_EVENT_SIZE];
+
+    fp = fopen(path, "rb");
+    if (!fp) {
+        return -1;
+    }
+
+    if (fread(header, 1, sizeof(header), fp) != sizeof(header) ||
+        memcmp(header, MEM_TRACE_MAGIC, MEM_TRACE_MAGIC_SIZE) ||
+        get_u32(header + MEM_TRACE_MAGIC_SIZE) != MEM_TRACE_VERSION) {
+        fclose(fp);
+        return -1;
+    }
+
+    while (fread(chunk, 1, sizeof(chunk), fp) == sizeof(chunk)) {
+        thread = replay_thread(replay, (unsigned int)get_u32(chunk));
+        count = (unsigned int)get_u32(chunk + 4);
+
+        if (!thread) {
+            fclose(fp);
+            return -1;
+        }
+
+        for (i = 0; i < count; i++) {
+            if (fread(data, 1, sizeof(data), fp) != sizeof(data)) {
+                break;
+            }
+
+            if (thread->count == thread->capacity) {
+                thread->capacity = thread->capacity ? thread->capacity * 2 : 4096;
+                event = (REPLAY_EVENT *)realloc(thread->events,
+                    thread->capacity * sizeof(REPLAY_EVENT));
+
+                if (!event) {
+                    fclose(fp);
+                    return -1;
+                }
+
+                thread->events = event;
+            }
+
+            event = thread->events + thread->count++;
+            event->op = data[0];
+            event->size = (unsigned int)get_u32(data + 4);
+            event->id = get_u64(data + 8);
+            event->time = get_u64(data + 16);
+
+            if (event->time > replay->duration) {
+                replay->duration = event->time;
+            }
+
+            if (event->id > replay->max_id) {
+                replay->max_id = event->id;
+            }
+
+            if (event->op == MEM_TRACE_MALLOC) {
+                replay->objects++;
+            }
+
+            replay->events++;
+        }
+    }
+
+    fclose(fp);
+    return replay->thread_count ? 0 : -1;
+}
+
+int replay_order(REPLAY *replay)
+{
+    int i;
+    size_t j;
+    size_t count = 0;
+    unsigned int *seq = NULL;
+
+    replay->order = (REPLAY_EVENT **)malloc(replay->events * sizeof(REPLAY_EVENT *));
+    seq = (unsigned int *)calloc(replay->max_id + 1, sizeof(unsigned int));
+
+    if (!replay->order || !seq) {
+        free(seq);
+        return -1;
+    }
+
+    for (i = 0; i < replay->thread_count; i++) {
+        for (j = 0; j < replay->threads[i].count; j++) {
+            replay->order[count++] = replay->threads[i].events + j;
+        }
+    }
+
+    qsort(replay->order, count, sizeof(REPLAY_EVENT *), compare_event);
+
+    /*
+     * 同一对象的事件可能分布在不同线程，按全局顺序编号，回放时每个
+     * 事件等待同一对象上序号更小的事件完成
+     */
+    for (j = 0; j < count; j++) {
+        replay->order[j]->seq = seq[replay->order[j]->id]++;
+    }
+
+    free(seq);
+    return 0;
+}
+
+int compare_event(const void *a, const void *b)
+{
+    const REPLAY_EVENT *ea = *(const REPLAY_EVENT **)a;
+    const REPLAY_EVENT *eb = *(const REPLAY_EVENT **)b;
+
+    if (ea->time != eb->time) {
+        return ea->time < eb->time ? -1 : 1;
+    }
+
+    /*
+     * 时间戳相同时：同一对象按 malloc、realloc、free 的先后排列；同一
+     * 线程的事件在数组中连续存放，按地址即按记录顺序排列
+     */
+    if (ea->id == eb->id && event_rank(ea) != event_rank(eb)) {
+        return event_rank(ea) < event_rank(eb) ? -1 : 1;
+    }
+
+    if (ea != eb) {
+        return ea < eb ? -1 : 1;
+    }
+
+    return 0;
+}
+
+int event_rank(const REPLAY_EVENT *event)
+{
+    switch (event->op) {
+    case MEM_TRACE_MALLOC:
+        return 0;
+
+    case MEM_TRACE_REALLOC:
+        return 1;
+
+    default:
+        return 2;
+    }
+}
+
+REPLAY_THREAD *replay_thread(REPLAY *replay, unsigned int thread)
+{
+    int i;
+
+    for (i = 0; i < replay->thread_count; i++) {
+        if (replay->threads[i].thread == thread) {
+            return replay->threads + i;
+        }
+    }
+
+    if (replay->thread_count == REPLAY_MAX_THREADS) {
+        return NULL;
+    }
+
+    replay->threads[replay->thread_count].thread = thread;
+    return replay->threads + replay->thread_count++;
+}
+
+void replay_run(const BENCH_ALLOC *alloc, void *arg, BENCH_RESULT *result)
+{
+    int i;
+    unsigned long long id;
+    unsigned long long start = 0;
+
+    REPLAY *replay = (REPLAY *)arg;
+    pthread_t tid[REPLAY_MAX_THREADS];
+
+    replay_objects = (void **)calloc(replay->max_id + 1, sizeof(void *));
+    replay_applied = (volatile unsigned int *)calloc(replay->max_id + 1, sizeof(unsigned int));
+
+    if (!replay_objects || !replay_applied) {
+        return;
+    }
+
+    start = bench_now();
+
+    if (replay->serial) {
+        /* 单线程按全局顺序回放，不需要等待 */
+        for (id = 0; id < replay->events; id++) {
+            replay_event(alloc, replay->order[id]);
+        }
+
+        result->ops = replay->events;
+    } else {
+        for (i = 0; i < replay->thread_count; i++) {
+            replay->threads[i].alloc = alloc;
+            replay->threads[i].ops = 0;
+
+            pthread_create(tid + i, NULL, replay_entry, replay->threads + i);
+        }
+
+        for (i = 0; i < replay->thread_count; i++) {
+            pthread_join(tid[i], NULL);
+            result->ops += replay->threads[i].ops;
+        }
+    }
+
+    /* 释放轨迹结束时仍然存活的对象，不计入耗时 */
+    result->ns = bench_now() - start;
+
+    for (id = 1; id <= replay->max_id; id++) {
+        if (replay_objects[id]) {
+            alloc->release(replay_objects[id]);
+        }
+    }
+
+    free(replay_objects);
+    free((void *)replay_applied);
+}
+
+void *replay_entry(void *arg)
+{
+    size_t i;
+    REPLAY_THREAD *thread = (REPLAY_THREAD *)arg;
+
+    for (i = 0; i < thread->count; i++) {
+        replay_event(thread->alloc, thread->events + i);
+    }
+
+    thread->ops = thread->count;
+    return NULL;
+}
+
+void replay_event(const BENCH_ALLOC *alloc, const REPLAY_EVENT *event)
+{
+    void *ptr = NULL;
+
+    wait_turn(event);
+
+    switch (event->op) {
+    case MEM_TRACE_MALLOC:
+        ptr = alloc->alloc(event->size);
+        bench_touch(ptr, event->size);
+
+        replay_objects[event->id] = ptr;
+        break;
+
+    case MEM_TRACE_FREE:
+        alloc->release(replay_objects[event->id]);
+        replay_objects[event->id] = NULL;
+        break;
+
+    case MEM_TRACE_REALLOC:
+        ptr = alloc->resize(replay_objects[event->id], event->size);
+        if (ptr) {
+            bench_touch(ptr, event->size);
+            replay_objects[event->id] = ptr;
+        }
+        break;
+
+    default:
+        break;
+    }
+
+    __atomic_store_n(&replay_applied[event->id], event->seq + 1, __ATOMIC_RELEASE);
+}
+
+void wait_turn(const REPLAY_EVENT *event)
+{
+    /* 对象上之前的事件由其他线程执行，等待其完成 */
+    while (__atomic_load_n(&replay_applied[event->id], __ATOMIC_ACQUIRE) != event->seq) {
+        sched_yield();
+    }
+}
+
+unsigned long long get_u32(const unsigned char *cursor)
+{
+    return (unsigned long long)cursor[0] |
+        ((unsigned long long)cursor[1] << 8) |
+        ((unsigned long long)cursor[2] << 16) |
+        ((unsigned long long)cursor[3] << 24);
+}
+
+unsigned long long get_u64(const unsigned char *cursor)
+{
+    return get_u32(cursor) | (get_u32(cursor + 4) << 32);
+}
+
+/*===========================================================================*/